@@ -18,9 +18,47 @@ MODIFIED SAMPLE TO INCLUDE EXTENSIONS ++
 #include <zephyr/drivers/gpio.h> 
 
 #include "hci_rpmsg_module.h"
+#include "esb_rpc_tr.h"
 
 LOG_MODULE_REGISTER(main, LOG_LEVEL_INF);
 
+// Interval of the HCI throughput log, which is only printed when there is traffic
+#define HCI_STATS_INTERVAL_MS 2000
+
+static void hci_stats_log(void)
+{
+	static hci_rpmsg_stats_t last;
+	hci_rpmsg_stats_t stats;
+	uint32_t rx_bytes, tx_bytes;
+
+	hci_rpmsg_stats_get(&stats);
+	rx_bytes = (uint32_t)(stats.rx_bytes - last.rx_bytes);
+	tx_bytes = (uint32_t)(stats.ipc.bytes - last.ipc.bytes);
+
+	if (rx_bytes > 0 || tx_bytes > 0) {
+		LOG_INF("HCI host->ctlr %u kbps (%u of %u packets in place), ctlr->host %u kbps, %u IPC stalls",
+			rx_bytes * 8 / HCI_STATS_INTERVAL_MS, stats.rx_nocopy - last.rx_nocopy,
+			stats.rx_packets - last.rx_packets, tx_bytes * 8 / HCI_STATS_INTERVAL_MS,
+			stats.ipc.stalls - last.ipc.stalls);
+	}
+	last = stats;
+}
+
+/* Warn when ESB RPC messages had to wait for a TX buffer since the last check */
+static void esb_rpc_stats_log(void)
+{
+	static esb_rpc_tr_stats_t last;
+	esb_rpc_tr_stats_t stats;
+
+	esb_rpc_tr_stats_get(&stats);
+	if (stats.tx_alloc_waits != last.tx_alloc_waits) {
+		LOG_WRN("ESB RPC TX buffers ran out %u times, %u waits over %u ms, fewest free %u",
+			stats.tx_alloc_waits - last.tx_alloc_waits, stats.tx_alloc_timeouts - last.tx_alloc_timeouts,
+			ESB_RPC_TR_ALLOC_TIMEOUT_MS, stats.tx_pool_min_free);
+	}
+	last = stats;
+}
+
 int main(void)
 {
 	int err;
@@ -33,7 +71,8 @@ int main(void)
 	LOG_WRN("Change ESB_EVT_IRQ and ESB_EVT_IRQHandler in esb_peripherals.h to use SWI3 instead of SWI0!");
 
 	while (1) {
-		k_sleep(K_MSEC(2000));
-		//LOG_INF("Alive");
+		k_sleep(K_MSEC(HCI_STATS_INTERVAL_MS));
+		hci_stats_log();
+		esb_rpc_stats_log();
 	}
 }
@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2019 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/*
+ESB latency and throughput benchmark. Measures the time spent in each stage of the ESB data path, using the
+time stamps collected by esb_bench.c, and the highest packet rate app_esb can sustain. Builds for the nRF52
+series and for the nRF5340, so the single core and split builds can be compared.
+*/
+
+#include <zephyr/kernel.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/types.h>
+#include <zephyr/logging/log.h>
+
+#include "app_bt_lbs.h"
+#include "app_esb.h"
+#include "esb_bench.h"
+
+LOG_MODULE_REGISTER(bench, LOG_LEVEL_INF);
+
+// Time given to packets still in flight at the end of a run
+#define RUN_DRAIN_MS		200
+// Longest wait for a TX credit or queue slot before app_esb_send() is tried again
+#define TX_RETRY_WAIT_MS	10
+
+typedef enum {
+	METRIC_TX_TO_QUEUE,		// app_esb_send() -> payload in the app_esb TX queue (inter-core transfer on the nRF5340)
+	METRIC_TX_RADIO,		// TX queue -> ESB TX success (timeslot scheduling and airtime)
+	METRIC_TX_EVENT,		// ESB TX success -> application callback (inter-core transfer on the nRF5340)
+	METRIC_TX_TOTAL,		// app_esb_send() -> application callback
+	METRIC_RX_EVENT,		// ESB RX -> application callback
+	METRIC_COUNT
+} metric_t;
+
+static const struct {
+	const char *name;
+	esb_bench_stage_t from;
+	esb_bench_stage_t to;
+} m_metrics[METRIC_COUNT] = {
+	[METRIC_TX_TO_QUEUE]	= {"tx to queue",	ESB_BENCH_TX_APP_SEND,		ESB_BENCH_TX_QUEUED},
+	[METRIC_TX_RADIO]		= {"tx radio",		ESB_BENCH_TX_QUEUED,		ESB_BENCH_TX_RADIO_DONE},
+	[METRIC_TX_EVENT]		= {"tx event",		ESB_BENCH_TX_RADIO_DONE,	ESB_BENCH_TX_APP_DONE},
+	[METRIC_TX_TOTAL]		= {"tx total",		ESB_BENCH_TX_APP_SEND,		ESB_BENCH_TX_APP_DONE},
+	[METRIC_RX_EVENT]		= {"rx event",		ESB_BENCH_RX_RADIO,			ESB_BENCH_RX_APP},
+};
+
+static uint32_t m_samples[METRIC_COUNT][CONFIG_ESB_BENCH_SAMPLES];
+static uint32_t m_sample_count[METRIC_COUNT];
+
+static volatile uint32_t m_tx_completed;
+static volatile uint32_t m_tx_failed;
+static volatile uint32_t m_rx_received;
+static volatile uint32_t m_rx_bytes;
+
+static K_SEM_DEFINE(m_tx_sem, 0, 1);
+
+/* Turn the stamps of a completed packet into latency samples */
+static void samples_add(uint32_t seq)
+{
+	uint32_t stamps[ESB_BENCH_STAGE_COUNT];
+	uint32_t valid = esb_bench_read(seq, stamps);
+
+	for (int i = 0; i < METRIC_COUNT; i++) {
+		uint32_t needed = BIT(m_metrics[i].from) | BIT(m_metrics[i].to);
+
+		if ((valid & needed) != needed || m_sample_count[i] >= CONFIG_ESB_BENCH_SAMPLES) {
+			continue;
+		}
+		m_samples[i][m_sample_count[i]++] = k_cyc_to_us_floor32(stamps[m_metrics[i].to] - stamps[m_metrics[i].from]);
+	}
+}
+
+void on_esb_callback(app_esb_event_t *event)
+{
+	uint32_t seq;
+
+	switch(event->evt_type) {
+		case APP_ESB_EVT_TX_SUCCESS:
+			// Packets complete in the order they were sent, so the sequence number is the number of completions
+			seq = m_tx_completed++;
+			esb_bench_stamp_seq(ESB_BENCH_TX_APP_DONE, seq);
+			samples_add(seq);
+			k_sem_give(&m_tx_sem);
+			break;
+		case APP_ESB_EVT_TX_FAIL:
+			m_tx_completed++;
+			m_tx_failed++;
+			k_sem_give(&m_tx_sem);
+			break;
+		case APP_ESB_EVT_RX:
+			esb_bench_stamp(ESB_BENCH_RX_APP, event->buf, event->data_length);
+			if (event->data_length >= sizeof(seq)) {
+				memcpy(&seq, event->buf, sizeof(seq));
+				samples_add(seq);
+			}
+			m_rx_received++;
+			m_rx_bytes += event->data_length;
+			break;
+		default:
+			LOG_ERR("Unknown APP ESB event!");
+			break;
+	}
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static uint32_t percentile(const uint32_t *sorted, uint32_t count, uint32_t percent)
+{
+	return sorted[((count - 1) * percent) / 100];
+}
+
+static void samples_reset(void)
+{
+	memset(m_sample_count, 0, sizeof(m_sample_count));
+}
+
+static void samples_report(void)
+{
+	for (int i = 0; i < METRIC_COUNT; i++) {
+		uint32_t count = m_sample_count[i];
+
+		if (count == 0) {
+			continue;
+		}
+		qsort(m_samples[i], count, sizeof(uint32_t), compare_u32);
+		LOG_INF("  %-12s n %5u  p50 %6u  p90 %6u  p99 %6u  max %6u us", m_metrics[i].name, count,
+			percentile(m_samples[i], count, 50), percentile(m_samples[i], count, 90),
+			percentile(m_samples[i], count, 99), m_samples[i][count - 1]);
+	}
+}
+
+static void time_sync(void)
+{
+	uint32_t error_us;
+
+	if (esb_bench_time_sync(&error_us) == 0 && error_us > 0) {
+		LOG_INF("Inter-core stages are accurate to +-%u us", error_us);
+	}
+}
+
+#if !defined(CONFIG_ESB_BENCH_PRX)
+static void tx_run(uint32_t length)
+{
+	static app_esb_data_t data;
+	uint32_t seq = 0;
+	uint32_t rejected = 0;
+	uint32_t elapsed_ms;
+	int64_t start_us;
+	int err;
+
+	for (uint32_t i = 0; i < length; i++) {
+		data.data[i] = (uint8_t)i;
+	}
+	data.len = length;
+
+	m_tx_completed = 0;
+	m_tx_failed = 0;
+	samples_reset();
+	time_sync();
+	esb_bench_enable(true);
+	k_sem_reset(&m_tx_sem);
+
+	start_us = k_ticks_to_us_floor64(k_uptime_ticks());
+	while (k_uptime_get() - start_us / 1000 < CONFIG_ESB_BENCH_RUN_TIME_S * 1000) {
+		memcpy(data.data, &seq, sizeof(seq));
+		esb_bench_stamp_seq(ESB_BENCH_TX_APP_SEND, seq);
+		err = app_esb_send(&data);
+		if (err == -ENOMEM) {
+			// Out of credits or queue space, wait for a packet to complete
+			rejected++;
+			k_sem_take(&m_tx_sem, K_MSEC(TX_RETRY_WAIT_MS));
+			continue;
+		}
+		if (err < 0) {
+			LOG_ERR("app_esb_send failed (err %d)", err);
+			break;
+		}
+		seq++;
+
+		if (CONFIG_ESB_BENCH_RATE_PPS > 0) {
+			int64_t next_us = start_us + ((int64_t)seq * USEC_PER_SEC) / CONFIG_ESB_BENCH_RATE_PPS;
+			int64_t now_us = k_ticks_to_us_floor64(k_uptime_ticks());
+
+			if (next_us > now_us) {
+				k_sleep(K_USEC(next_us - now_us));
+			}
+		}
+	}
+	elapsed_ms = k_uptime_get() - start_us / 1000;
+
+	k_sleep(K_MSEC(RUN_DRAIN_MS));
+	esb_bench_enable(false);
+
+	LOG_INF("TX, %u byte payloads, %u pps offered", length, CONFIG_ESB_BENCH_RATE_PPS);
+	LOG_INF("  sent %u, completed %u, failed %u, rejected %u", seq, m_tx_completed, m_tx_failed, rejected);
+	LOG_INF("  %u packets/s, %u kbps", (m_tx_completed - m_tx_failed) * 1000 / elapsed_ms,
+		(m_tx_completed - m_tx_failed) * length * 8 / elapsed_ms);
+	samples_report();
+}
+#else
+static void rx_run(void)
+{
+	uint32_t elapsed_ms;
+	int64_t start_ms;
+
+	m_rx_received = 0;
+	m_rx_bytes = 0;
+	samples_reset();
+	time_sync();
+	esb_bench_enable(true);
+
+	start_ms = k_uptime_get();
+	k_sleep(K_SECONDS(CONFIG_ESB_BENCH_RUN_TIME_S));
+	esb_bench_enable(false);
+	elapsed_ms = k_uptime_get() - start_ms;
+
+	LOG_INF("RX, %u packets/s, %u kbps", m_rx_received * 1000 / elapsed_ms, m_rx_bytes * 8 / elapsed_ms);
+	samples_report();
+}
+#endif
+
+int main(void)
+{
+	int err;
+
+	LOG_INF("ESB bench, %s", IS_ENABLED(CONFIG_ESB_BENCH_PRX) ? "PRX" : "PTX");
+
+	err = app_bt_init();
+	if (err) {
+		LOG_ERR("app_bt init failed (err %d)", err);
+		return err;
+	}
+
+	err = app_esb_init(IS_ENABLED(CONFIG_ESB_BENCH_PRX) ? APP_ESB_MODE_PRX : APP_ESB_MODE_PTX, on_esb_callback);
+	if (err) {
+		LOG_ERR("app_esb init failed (err %d)", err);
+		return err;
+	}
+
+#if !defined(CONFIG_ESB_BENCH_PRX)
+	while (1) {
+		char lengths[] = CONFIG_ESB_BENCH_PAYLOAD_LENGTHS;
+		char *save;
+
+		for (char *tok = strtok_r(lengths, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+			uint32_t length = CLAMP(strtoul(tok, NULL, 10), sizeof(uint32_t), sizeof(((app_esb_data_t *)0)->data));
+
+			tx_run(length);
+		}
+	}
+#else
+	while (1) {
+		rx_run();
+	}
+#endif
+	return 0;
+}
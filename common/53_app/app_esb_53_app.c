@@ -11,26 +11,22 @@
 #include <nrf.h>
 #include "53_app/radio_regs.h"
 #include "app_esb.h"
-#include <esb_rpc_ids.h>
+#include "esb_shm.h"
+#include "esb_trace.h"
+#include "log_ratelimit.h"
+#include <esb_rpc_gen.h>
 
-#include <nrf_rpc/nrf_rpc_ipc.h>
-#include <nrf_rpc_cbor.h>
-#include <zcbor_common.h>
-#include <zcbor_decode.h>
-#include <zcbor_encode.h>
-
-#define CBOR_BUF_SIZE 16
+#include "esb_rpc_tr.h"
 
 LOG_MODULE_REGISTER(rpc_app, LOG_LEVEL_DBG);
 
-/* This defines a transport for our RPC command group.
- * Here we use the IPC transport (nrf_rpc_ipc.h):
- * - we tell it to use the IPC device `ipc0` (in the devicetree)
- * - we tell it to use an endpoint named `nrf_rpc_ept`. There can be multiple endpoints,
+/* The transport for our RPC command group is defined in esb_rpc_tr.c.
+ * It works like the IPC transport (nrf_rpc_ipc.h), but uses a static buffer pool instead of the heap:
+ * - it uses the IPC device `ipc0` (in the devicetree)
+ * - it uses an endpoint named `nrf_rpc_ept`. There can be multiple endpoints,
  *   e.g. one for HCI and one for nRF RPC. Usually it's not one ept per API, it's one ept
  *   per library (hci uses one, 802154 another, nRF RPC another, and so on).
  */
-NRF_RPC_IPC_TRANSPORT(esb_group_tr, DEVICE_DT_GET(DT_NODELABEL(ipc0)), "nrf_rpc_ept");
 
 /* This defines the group for our API.
  *
@@ -43,185 +39,91 @@ NRF_RPC_IPC_TRANSPORT(esb_group_tr, DEVICE_DT_GET(DT_NODELABEL(ipc0)), "nrf_rpc_
  * as modules making use of nRF RPC can be compiled in and out without needed to
  * edit the command IDs every time.
  */
-NRF_RPC_GROUP_DEFINE(esb_group, "esb_group_id", &esb_group_tr, NULL, NULL, NULL);
+NRF_RPC_GROUP_DEFINE(esb_group, "esb_group_id", &esb_rpc_tr, NULL, NULL, NULL);
 
 static app_esb_callback_t 	m_callback;
 static app_esb_event_t 		m_event;
-static uint8_t 				m_rx_buf[CONFIG_ESB_MAX_PAYLOAD_LENGTH];
-
-/* - Pull an error code from the RPC CBOR buffer
- * - Place it in `handler_data`, retrieved in the ESB API and passed to the application
- * - Also return it (as a convenience)
- */
-static int decode_error(const struct nrf_rpc_group *group,
-			struct nrf_rpc_cbor_ctx *ctx,
-			void *handler_data)
-{
-	int err;
-	int32_t *p_err = (int32_t *)handler_data;
+static uint8_t 				m_rx_buf[ESB_SHM_DATA_MAX_LENGTH];
 
-	if (!zcbor_int32_decode(ctx->zs, &err)) {
-		err = -EBADMSG;
-	}
-
-	if (p_err) {
-		*p_err = err;
-	}
-
-	return err;
-}
+BUILD_ASSERT(sizeof(((app_esb_data_t *)0)->data) <= ESB_SHM_DATA_MAX_LENGTH);
 
-/* Default response handler. Decodes the error returned by the ESB API (ran
- * on the other core) and frees the CBOR buffer.
+/* TX flow control. The network core grants one credit per slot in its TX queue, and returns a credit through
+ * shared memory every time a packet leaves the queue. A payload is only sent when a credit is available,
+ * so payloads are never dropped on the network core and app_esb_send() fails right away when it is full.
  */
-static void rpc_rsp_handler(const struct nrf_rpc_group *group,
-			struct nrf_rpc_cbor_ctx *ctx,
-			void *handler_data)
-{
-	int err = decode_error(group, ctx, handler_data);
-	LOG_INF("rsp_handler addr ctx %x, error %i", (uint32_t)ctx, err);
-	nrf_rpc_cbor_decoding_done(&esb_group, ctx);
-}
+static uint32_t m_tx_credits;
+static uint32_t m_tx_sent;
+
+// Protocol features agreed on with the network core during init
+static uint32_t m_features;
 
 static int rpc_esb_init(app_esb_config_t *p_config)
 {
-	int32_t err;
-	int err_rpc;
-	struct nrf_rpc_cbor_ctx ctx;
-	size_t config_len = sizeof(app_esb_config_t);
-
-	NRF_RPC_CBOR_ALLOC(&esb_group, ctx, CBOR_BUF_SIZE + config_len);
-
-	/* Serialize the `config` struct to a byte array, encode it and place it
-	 * in the CBOR buffer.
-	 *
-	 * We play fast and loose with the memory layout because we assume that
-	 * the other core's FW was compiled with the exact same toolchain and
-	 * compiler options, resulting in the same memory layout on the other
-	 * side.
-	 *
-	 * Note: a gotcha is that the `zcbor_` APIs return `true` on success,
-	 * whereas almost all zephyr (and other NCS) APIs return a `0` on success.
-	 */
-	if (!zcbor_bstr_encode_ptr(ctx.zs, (const uint8_t *)p_config, config_len)) {
-		return -EINVAL;
-	}
-
-	LOG_DBG("RPC ESB Init cmd. Err %i", err);
+	struct esb_rpc_init_cmd cmd = {
+		.version = ESB_RPC_PROTOCOL_VERSION,
+		.features = ESB_RPC_FEATURES_SUPPORTED,
+		.mode = p_config->mode,
+	};
+	struct esb_rpc_init_rsp rsp = {0};
+	int err;
 
-	err_rpc = nrf_rpc_cbor_cmd(&esb_group, RPC_COMMAND_ESB_INIT, &ctx, rpc_rsp_handler, &err);
+	LOG_DBG("RPC ESB Init cmd");
 
-	/* Return a fixed error code if the RPC transport had an error. Else,
-	 * return the result of the API called on the other core.
+	/* The marshalling code is generated from the definition in esb_rpc_ids.h. The config is sent field by field
+	 * rather than as a raw copy of the struct, so the two cores don't need to agree on the memory layout.
 	 */
-	if (err_rpc) {
-		return -EINVAL;
-	} else {
+	err = esb_rpc_init_call(&esb_group, &cmd, &rsp);
+	if (err) {
+		LOG_ERR("init failed (err %i)", err);
 		return err;
 	}
-}
+	LOG_INF("init rsp, version %i, features 0x%x, tx credits %i", rsp.version, rsp.features, rsp.tx_credits);
 
-static int rpc_esb_tx(app_esb_data_t *packet)
-{
-	int32_t err;
-	int err_rpc;
-	struct nrf_rpc_cbor_ctx ctx;
-	size_t packet_len = sizeof(app_esb_data_t);
-
-	NRF_RPC_CBOR_ALLOC(&esb_group, ctx, CBOR_BUF_SIZE + packet_len);
-
-	/* Serialize the `config` struct to a byte array, encode it and place it
-	 * in the CBOR buffer.
-	 *
-	 * We play fast and loose with the memory layout because we assume that
-	 * the other core's FW was compiled with the exact same toolchain and
-	 * compiler options, resulting in the same memory layout on the other
-	 * side.
-	 *
-	 * Note: a gotcha is that the `zcbor_` APIs return `true` on success,
-	 * whereas almost all zephyr (and other NCS) APIs return a `0` on success.
-	 */
-	if (!zcbor_bstr_encode_ptr(ctx.zs, (const uint8_t *)packet, packet_len)) {
-		return -EINVAL;
-	}
-
-	LOG_DBG("RPC ESB TX cmd: Byte 0: %x", packet->data[0]);
-
-	err_rpc = nrf_rpc_cbor_cmd(&esb_group, RPC_COMMAND_ESB_TX, &ctx, rpc_rsp_handler, &err);
-
-	/* Return a fixed error code if the RPC transport had an error. Else,
-	 * return the result of the API called on the other core.
-	 */
-	if (err_rpc) {
-		return -EINVAL;
-	} else {
-		return err;
+	// The network core answers with the version to use, which is never higher than ours
+	if (rsp.version < ESB_RPC_PROTOCOL_VERSION_MIN || rsp.version > ESB_RPC_PROTOCOL_VERSION) {
+		LOG_ERR("Protocol version %i of the net core not supported, app core supports %i to %i", rsp.version,
+			ESB_RPC_PROTOCOL_VERSION_MIN, ESB_RPC_PROTOCOL_VERSION);
+		return -EPROTO;
 	}
+	m_features = rsp.features & ESB_RPC_FEATURES_SUPPORTED;
+	// Without credits, payloads are only limited by the space in the ring to the network core
+	m_tx_credits = (m_features & ESB_RPC_FEATURE_TX_CREDITS) ? rsp.tx_credits : UINT32_MAX;
+	return 0;
 }
 
-static void rpc_esb_event_handler(const struct nrf_rpc_group *group,
-			  struct nrf_rpc_cbor_ctx *ctx,
-			  void *handler_data)
+/* Records from the network core, called from the esb_shm work queue */
+static int shm_rx_handler(const struct esb_shm_record *record)
 {
-	int err;
-	uint32_t rx_payload_length;
-	struct zcbor_string zst;
-	int evt_type;
-
-	/* Try pulling the error code. */
-	err = decode_error(group, ctx, handler_data);
-
-	if (err || !zcbor_uint32_decode(ctx->zs, &evt_type)) {
-		err = -EBADMSG;
-	}
-
-	if (err || !zcbor_uint32_decode(ctx->zs, &rx_payload_length)) {
-		err = -EBADMSG;
-	}
-
-	if (rx_payload_length > 0) {
-		// An RX payload is included in the message. Try to parse it. 
-		if (err || !zcbor_bstr_decode(ctx->zs, &zst)) {
-			err = -EBADMSG;
-		}
-
-		if (zst.len != rx_payload_length) {
-			LOG_ERR("struct size mismatch: expect %d got %d", rx_payload_length, zst.len);
-			err = -EMSGSIZE;
-		}
-
-		if (!err) {
-			memcpy(m_rx_buf, zst.value, zst.len);
-			LOG_DBG("decoding ok: rx_payload length %i", rx_payload_length);
-		} else {
-			LOG_ERR("%s: decoding error %d", __func__, err);
-		}
+	uint32_t count = 1;
+	uint32_t length = 0;
+
+	switch (record->type) {
+		case ESB_SHM_REC_EVT_TX_SUCCESS:
+		case ESB_SHM_REC_EVT_TX_FAIL:
+			// Events of the same type are counted up on the network core, pass on one event per packet
+			if ((m_features & ESB_RPC_FEATURE_EVENT_COUNTS) && record->length == sizeof(count)) {
+				memcpy(&count, record->data, sizeof(count));
+			}
+			m_event.evt_type = (record->type == ESB_SHM_REC_EVT_TX_SUCCESS) ? APP_ESB_EVT_TX_SUCCESS : APP_ESB_EVT_TX_FAIL;
+			break;
+		case ESB_SHM_REC_EVT_RX:
+			m_event.evt_type = APP_ESB_EVT_RX;
+			length = MIN(record->length, sizeof(m_rx_buf));
+			memcpy(m_rx_buf, record->data, length);
+			break;
+		default:
+			LOG_RATELIMIT_ERR(LOG_RATELIMIT_DEFAULT_MS, "Unexpected record type %i", record->type);
+			return 0;
 	}
 
-	LOG_INF("evt_type %i, p_rx_payload length %i", evt_type, rx_payload_length);
-
-	nrf_rpc_cbor_decoding_done(&esb_group, ctx);
-
-	/* Notify the app new data has been received. */
-	if (!err) {
-		LOG_DBG("decoding ok: rx_payload length %i", rx_payload_length);
-
-		// Call the event handler registered by the application 
-		m_event.evt_type = evt_type;
-		m_event.buf = m_rx_buf;
-		m_event.data_length = rx_payload_length;
+	m_event.buf = m_rx_buf;
+	m_event.data_length = length;
+	for (uint32_t i = 0; i < count; i++) {
 		m_callback(&m_event);
-	} else {
-		LOG_ERR("%s: decoding error %d", __func__, err);
 	}
-
+	return 0;
 }
 
-/* Register the RX event handler (function above). This will be sent from the
- * other side whenever we are in async mode and a packet has been received.
- */
-NRF_RPC_CBOR_EVT_DECODER(esb_group, rx_cb_handler, RPC_EVENT_ESB_CB, rpc_esb_event_handler, NULL);
-
 /* Initialize nRF RPC right after kernel boots, but before the application is
  * run.
  */
@@ -255,7 +157,17 @@ int app_esb_init(app_esb_mode_t mode, app_esb_callback_t callback)
     static app_esb_config_t config;
     config.mode = mode;
 	m_callback = callback;
-    int err = rpc_esb_init(&config);
+
+	// Set up the payload rings before the network core is told to use them
+	int err = esb_shm_init(shm_rx_handler);
+	if (err < 0) {
+		return err;
+	}
+	m_tx_credits = 0;
+	m_tx_sent = 0;
+	m_features = 0;
+
+    err = rpc_esb_init(&config);
     if (err < 0) {
         return err;
     }
@@ -264,6 +176,57 @@ int app_esb_init(app_esb_mode_t mode, app_esb_callback_t callback)
 
 int app_esb_send(app_esb_data_t *tx_packet)
 {
-    rpc_esb_tx(tx_packet);
-    return 0;
+	int err;
+	uint32_t irq_key = irq_lock();
+
+	if ((m_tx_sent - esb_shm_tx_credits_returned()) >= m_tx_credits) {
+		irq_unlock(irq_key);
+		esb_trace_send(tx_packet->len, -ENOMEM);
+		return -ENOMEM;
+	}
+
+	err = esb_shm_send(ESB_SHM_REC_TX_PAYLOAD, tx_packet->data, tx_packet->len);
+	if (err == 0) {
+		m_tx_sent++;
+	}
+	irq_unlock(irq_key);
+	esb_trace_send(tx_packet->len, err);
+	return err;
+}
+
+int app_esb_stats_get(app_esb_stats_t *stats)
+{
+	// The ESB statistics are kept by the app_esb module on the network core
+	return -ENOTSUP;
+}
+
+uint32_t app_esb_tx_backlog_get(void)
+{
+	// The network core returns a credit for every payload it is done with, whether or not credits were negotiated
+	return m_tx_sent - esb_shm_tx_credits_returned();
+}
+
+uint32_t esb_rpc_features_get(void)
+{
+	return m_features;
+}
+
+int app_esb_radio_time_get(app_esb_radio_time_t *time)
+{
+	struct esb_rpc_radio_time_cmd cmd;
+	struct esb_rpc_radio_time_rsp rsp;
+	int err;
+
+	if (!(m_features & ESB_RPC_FEATURE_RADIO_TIME)) {
+		return -ENOTSUP;
+	}
+
+	// The timeslot analytics run on the network core
+	err = esb_rpc_radio_time_call(&esb_group, &cmd, &rsp);
+	if (err) {
+		return err;
+	}
+	time->total_ms = rsp.total_ms;
+	time->esb_ms = rsp.esb_ms;
+	return 0;
 }
@@ -11,231 +11,212 @@
 #include <nrf.h>
 #include <esb.h>
 #include "app_esb.h"
-#include <esb_rpc_ids.h>
+#include "esb_shm.h"
+#include "log_ratelimit.h"
+#include <esb_rpc_gen.h>
 
-#include <nrf_rpc/nrf_rpc_ipc.h>
-#include <nrf_rpc_cbor.h>
-#include <zcbor_common.h>
-#include <zcbor_decode.h>
-#include <zcbor_encode.h>
-
-#define CBOR_BUF_SIZE 16
+#include "esb_rpc_tr.h"
 
 LOG_MODULE_REGISTER(rpc_net, LOG_LEVEL_DBG);
 
-/* See rpc_app.c (in the cpuapp/ dir) for an explanation. */
-NRF_RPC_IPC_TRANSPORT(esb_group_tr, DEVICE_DT_GET(DT_NODELABEL(ipc0)), "nrf_rpc_ept");
-NRF_RPC_GROUP_DEFINE(esb_group, "esb_group_id", &esb_group_tr, NULL, NULL, NULL);
+/* See app_esb_53_app.c for an explanation. */
+NRF_RPC_GROUP_DEFINE(esb_group, "esb_group_id", &esb_rpc_tr, NULL, NULL, NULL);
 
-static void rpc_esb_event_send(uint32_t evt_type, uint8_t  *rx_payload_buf, uint32_t rx_payload_length);
+// Retry interval for passing TX events to the application core when the ring is full
+#define TX_EVENTS_RETRY_MS 1
 
-static void work_send_evt_tx_success_func(struct k_work *item);
-static void work_send_evt_tx_fail_func(struct k_work *item);
-static void work_send_evt_rx_received_func(struct k_work *item);
+// TX events not yet passed to the application core. They are counted rather than queued, so none are lost.
+static uint32_t m_tx_success_pending;
+static uint32_t m_tx_fail_pending;
 
-K_WORK_DEFINE(m_work_send_evt_tx_success, work_send_evt_tx_success_func);
-K_WORK_DEFINE(m_work_send_evt_tx_fail, work_send_evt_tx_fail_func);
-K_WORK_DEFINE(m_work_send_evt_rx_received, work_send_evt_rx_received_func);
+// Protocol version and features agreed on with the application core during init
+static uint32_t m_version;
+static uint32_t m_features;
+static bool m_esb_initialized;
+static uint32_t m_esb_mode;
 
-static uint8_t *last_rx_buf;
-static uint32_t last_rx_length;
+static void tx_events_flush_work_func(struct k_work *item);
 
-void on_esb_callback(app_esb_event_t *event)
+static K_WORK_DELAYABLE_DEFINE(m_tx_events_flush_work, tx_events_flush_work_func);
+
+static bool tx_event_flush(enum esb_shm_record_type type, uint32_t *pending)
 {
-	switch(event->evt_type) {
-		case APP_ESB_EVT_TX_SUCCESS:
-			LOG_INF("ESB TX success");
-			k_work_submit(&m_work_send_evt_tx_success);
-			break;
-		case APP_ESB_EVT_TX_FAIL:
-			LOG_INF("ESB TX failed");
-			k_work_submit(&m_work_send_evt_tx_fail);
-			break;
-		case APP_ESB_EVT_RX:
-			LOG_INF("ESB RX: 0x%.2x-0x%.2x-0x%.2x-0x%.2x", event->buf[0], event->buf[1], event->buf[2], event->buf[3]);
-			last_rx_buf = event->buf;
-			last_rx_length = event->data_length;
-			k_work_submit(&m_work_send_evt_rx_received);
-			break;
-		default:
-			LOG_ERR("Unknown APP ESB event!");
-			break;
+	uint32_t count = *pending;
+
+	if (count == 0) {
+		return true;
+	}
+	if (!(m_features & ESB_RPC_FEATURE_EVENT_COUNTS)) {
+		// The application core expects one record per event
+		while (*pending > 0) {
+			if (esb_shm_send(type, NULL, 0) != 0) {
+				return false;
+			}
+			(*pending)--;
+		}
+		return true;
 	}
+	if (esb_shm_send(type, (uint8_t *)&count, sizeof(count)) != 0) {
+		return false;
+	}
+	*pending = 0;
+	return true;
 }
 
-static void work_send_evt_tx_success_func(struct k_work *item)
+static void tx_events_flush(void)
 {
-	rpc_esb_event_send(APP_ESB_EVT_TX_SUCCESS, 0, 0);
-}
+	uint32_t key = irq_lock();
+	bool success_sent = tx_event_flush(ESB_SHM_REC_EVT_TX_SUCCESS, &m_tx_success_pending);
+	bool fail_sent = tx_event_flush(ESB_SHM_REC_EVT_TX_FAIL, &m_tx_fail_pending);
+	irq_unlock(key);
 
-static void work_send_evt_tx_fail_func(struct k_work *item)
-{
-	rpc_esb_event_send(APP_ESB_EVT_TX_FAIL, 0, 0);
+	if (!success_sent || !fail_sent) {
+		k_work_schedule_for_queue(&esb_shm_work_q, &m_tx_events_flush_work, K_MSEC(TX_EVENTS_RETRY_MS));
+	}
 }
 
-static void work_send_evt_rx_received_func(struct k_work *item)
+static void tx_events_flush_work_func(struct k_work *item)
 {
-	rpc_esb_event_send(APP_ESB_EVT_RX, last_rx_buf, last_rx_length);
+	tx_events_flush();
 }
 
-static int decode_struct(struct nrf_rpc_cbor_ctx *ctx, void *struct_ptr, size_t expected_size)
+/* Called from the ESB interrupt. The events are put straight into the ring to the application core. */
+void on_esb_callback(app_esb_event_t *event)
 {
-	struct zcbor_string zst;
 	int err;
 
-	if (zcbor_bstr_decode(ctx->zs, &zst)) {
-		err = 0;
-	} else {
-		err = -EBADMSG;
-	}
-
-	if (expected_size != zst.len) {
-		LOG_ERR("struct size mismatch: expect %d got %d", expected_size, zst.len);
-		err = -EMSGSIZE;
-	}
-
-	if (!err) {
-		memcpy(struct_ptr, zst.value, zst.len);
-	} else {
-		LOG_ERR("decoding failed");
+	switch(event->evt_type) {
+		case APP_ESB_EVT_TX_SUCCESS:
+			LOG_RATELIMIT_DBG(LOG_RATELIMIT_DEFAULT_MS, "ESB TX success");
+			// A slot in the TX queue was freed, give the credit back to the application core
+			esb_shm_tx_credits_return(1);
+			m_tx_success_pending++;
+			tx_events_flush();
+			esb_shm_rx_resume();
+			break;
+		case APP_ESB_EVT_TX_FAIL:
+			LOG_RATELIMIT_DBG(LOG_RATELIMIT_DEFAULT_MS, "ESB TX failed");
+			m_tx_fail_pending++;
+			tx_events_flush();
+			break;
+		case APP_ESB_EVT_RX:
+			LOG_RATELIMIT_DBG(LOG_RATELIMIT_DEFAULT_MS, "ESB RX: 0x%.2x-0x%.2x-0x%.2x-0x%.2x", event->buf[0],
+					  event->buf[1], event->buf[2], event->buf[3]);
+			// The payload is copied out of the ESB buffer here, as the buffer is reused for the next packet
+			err = esb_shm_send(ESB_SHM_REC_EVT_RX, event->buf, event->data_length);
+			if (err) {
+				LOG_RATELIMIT_WRN(LOG_RATELIMIT_DEFAULT_MS, "ESB RX payload dropped (err %i)", err);
+			}
+			break;
+		default:
+			LOG_RATELIMIT_ERR(LOG_RATELIMIT_DEFAULT_MS, "Unknown APP ESB event!");
+			break;
 	}
-
-	return err;
 }
 
-/* Encode and send the return value (errcode) of `esb_simple_init`. */
-static void rpc_rsp(int32_t err)
+/* TX payloads from the application core, called from esb_shm_work_q */
+static int shm_rx_handler(const struct esb_shm_record *record)
 {
-	struct nrf_rpc_cbor_ctx ctx;
+	app_esb_data_t tx_payload;
+	int err;
 
-	NRF_RPC_CBOR_ALLOC(&esb_group, ctx, CBOR_BUF_SIZE);
+	if (record->type != ESB_SHM_REC_TX_PAYLOAD || record->length > sizeof(tx_payload.data)) {
+		LOG_RATELIMIT_ERR(LOG_RATELIMIT_DEFAULT_MS, "Invalid record, type %i, len %i", record->type, record->length);
+		return 0;
+	}
 
-	zcbor_int32_put(ctx.zs, err);
+	memcpy(tx_payload.data, record->data, record->length);
+	tx_payload.len = record->length;
 
-	nrf_rpc_cbor_rsp_no_err(&esb_group, &ctx);
+	err = app_esb_send(&tx_payload);
+	if (err == -ENOMEM) {
+		// The TX queue is full, leave the payload in the ring until a packet has been sent
+		return -EAGAIN;
+	}
+	if (err < 0) {
+		LOG_RATELIMIT_ERR(LOG_RATELIMIT_DEFAULT_MS, "app_esb_send: error %i", err);
+		// The payload will never be sent, so its credit is returned right away
+		esb_shm_tx_credits_return(1);
+	}
+	return 0;
 }
 
-/* `esb_simple_init` RPC command handler.
- *
- * This will get called when the other core sends an nRF RPC command for the
- * group `esb_group` with command ID `RPC_COMMAND_INIT`.
+/* `app_esb_init` RPC command implementation, called by the handler generated in esb_rpc_gen.h when the
+ * application core sends RPC_COMMAND_ESB_INIT. The command has already been decoded and released, so nRF RPC
+ * can process other commands while this runs.
  *
- * This command handler is registered using `NRF_RPC_CBOR_CMD_DECODER` at the
- * bottom of this file.
+ * The response carries the result of `app_esb_init`, the protocol version and negotiated features, and the
+ * number of TX credits given to the application core. There is one credit for every slot in the app_esb TX queue.
  */
-static void rpc_esb_init_handler(const struct nrf_rpc_group *group,
-				    struct nrf_rpc_cbor_ctx *ctx,
-				    void *handler_data)
+void esb_rpc_init_impl(const struct esb_rpc_init_cmd *cmd, struct esb_rpc_init_rsp *rsp)
 {
-	LOG_DBG("");
-
 	int32_t err = 0;
-	app_esb_config_t config;
 
-	if (decode_struct(ctx, &config, sizeof(config))) {
-		LOG_DBG("decoding config struct failed");
-		err = -EBADMSG;
-	}
+	LOG_DBG("");
 
-	/* Call this as soon as the data has been pulled from the RPC CBOR buffer.
-	 *
-	 * This is important because nRF RPC will not be able to process another
-	 * command (sent from the other core) until `nrf_rpc_cbor_decoding_done`
-	 * has been called.
-	 *
-	 * The underlying reason is that nRF RPC over IPC will process incoming
-	 * items in a workqueue, and an item is only marked as processed when
-	 * this function is called (freeing the workqueue for the next one).
-	 */
-	nrf_rpc_cbor_decoding_done(group, ctx);
+	m_features = 0;
+	// A newer application core goes down to our version, an older one is accepted if we still speak its version
+	m_version = MIN(cmd->version, ESB_RPC_PROTOCOL_VERSION);
+	if (m_version < ESB_RPC_PROTOCOL_VERSION_MIN) {
+		LOG_ERR("Protocol version %i of the app core not supported, net core supports %i to %i", cmd->version,
+			ESB_RPC_PROTOCOL_VERSION_MIN, ESB_RPC_PROTOCOL_VERSION);
+		err = -EPROTO;
+	}
+	if (!err) {
+		m_features = cmd->features & ESB_RPC_FEATURES_SUPPORTED;
+		LOG_INF("Protocol version %i, features 0x%x", m_version, m_features);
+	}
 
 	if (!err) {
-		LOG_DBG("app_esb_init. Mode %i", config.mode);
-		err = app_esb_init(config.mode, on_esb_callback);
+		// The application core has set up the payload rings before sending this command
+		err = esb_shm_init(shm_rx_handler);
 		if (err) {
-			LOG_ERR("app_esb init failed (err %d)", err);
+			LOG_ERR("esb_shm init failed (err %d)", err);
 		}
 	}
 
-	/* Encode the errcode and send it to the other core. */
-	rpc_rsp(err);
-}
-
-static void rpc_esb_tx_handler(const struct nrf_rpc_group *group,
-				  struct nrf_rpc_cbor_ctx *ctx,
-				  void *handler_data)
-{
-	int err = 0;
-	app_esb_data_t tx_payload;
-
-	if (decode_struct(ctx, &tx_payload, sizeof(tx_payload))) {
-		LOG_DBG("decoding app_esb_data_t struct failed");
-		err = -EBADMSG;
-	}
-
-	nrf_rpc_cbor_decoding_done(&esb_group, ctx);
-
-	if (!err) {
-		LOG_INF("Send TX packet, data 0 0x%.2x, len %i", tx_payload.data[0], tx_payload.len);
-		err = app_esb_send(&tx_payload);
-		if (err < 0) {
-			LOG_ERR("app_esb_send: error %i", err);
+	if (!err && m_esb_initialized) {
+		// The application core restarted, the ESB timeslot client is still registered from the first init
+		if (cmd->mode != m_esb_mode) {
+			LOG_ERR("app_esb already running in mode %i, can not change to %i", m_esb_mode, cmd->mode);
+			err = -EALREADY;
+		}
+	} else if (!err) {
+		LOG_DBG("app_esb_init. Mode %i", cmd->mode);
+		err = app_esb_init((app_esb_mode_t)cmd->mode, on_esb_callback);
+		if (err) {
+			LOG_ERR("app_esb init failed (err %d)", err);
+		} else {
+			m_esb_initialized = true;
+			m_esb_mode = cmd->mode;
 		}
 	}
 
-	rpc_rsp(err);
+	rsp->err = err;
+	rsp->version = m_version;
+	rsp->features = m_features;
+	rsp->tx_credits = APP_ESB_TX_QUEUE_SIZE;
 }
 
-/* This is the callback passed to the esb_simple API, which
- * then calls the RPC remote callback (sends an event).
- *
- * On the remote (app core), the rpc event will then call
- * the function stored in p_rx_cb_remote.
- */
-static void rpc_esb_event_send(uint32_t evt_type, uint8_t *rx_buf, uint32_t rx_length)
+/* Time sync for the esb_bench module on the application core */
+void esb_rpc_time_sync_impl(const struct esb_rpc_time_sync_cmd *cmd, struct esb_rpc_time_sync_rsp *rsp)
 {
-	int err = 0;
-	struct nrf_rpc_cbor_ctx ctx;
-
-	NRF_RPC_CBOR_ALLOC(&esb_group, ctx,
-			   CBOR_BUF_SIZE +
-			   sizeof(err) +
-			   sizeof(evt_type) +
-			   sizeof(uint32_t) + 
-			   rx_length);
-
-	/* Always encode the error */
-	if (!zcbor_int32_put(ctx.zs, err)) {
-		err = -EINVAL;
-	}
-
-	if (err || !zcbor_uint32_put(ctx.zs, evt_type)) {
-		err = -EINVAL;
-	}
-
-	if (err || !zcbor_uint32_put(ctx.zs, rx_length)) {
-		err = -EINVAL;
-	}
-
-	if (rx_length > 0) {
-		if (err || !zcbor_bstr_encode_ptr(ctx.zs, rx_buf, rx_length)) {
-			err = -EINVAL;
-		}
-	}
+	rsp->err = 0;
+	rsp->cycles = k_cycle_get_32();
+}
 
-	if (!err) {
-		err = nrf_rpc_cbor_evt(&esb_group, RPC_EVENT_ESB_CB, &ctx);
-	}
+/* Radio time split for app_esb_radio_time_get() on the application core */
+void esb_rpc_radio_time_impl(const struct esb_rpc_radio_time_cmd *cmd, struct esb_rpc_radio_time_rsp *rsp)
+{
+	app_esb_radio_time_t time;
 
-	if (!err) {
-		LOG_DBG("evt send ok");
-	} else {
-		LOG_DBG("evt send err %d", err);
-	}
+	rsp->err = app_esb_radio_time_get(&time);
+	rsp->total_ms = time.total_ms;
+	rsp->esb_ms = time.esb_ms;
 }
 
-NRF_RPC_CBOR_CMD_DECODER(esb_group, rpc_esb_init, RPC_COMMAND_ESB_INIT, rpc_esb_init_handler, NULL);
-NRF_RPC_CBOR_CMD_DECODER(esb_group, rpc_esb_tx,   RPC_COMMAND_ESB_TX,   rpc_esb_tx_handler,   NULL);
+// Registers the generated handlers of all the commands in esb_rpc_ids.h with the esb_group
+ESB_RPC_HANDLERS_DEFINE(esb_group)
 
 static void err_handler(const struct nrf_rpc_err_report *report)
 {
@@ -15,6 +15,7 @@
 #include <zephyr/sys/util.h>
 
 #include <zephyr/ipc/ipc_service.h>
+#include "ipc_tx_sched.h"
 
 #include <zephyr/net/buf.h>
 #include <zephyr/bluetooth/bluetooth.h>
@@ -53,39 +54,138 @@ static bool ipc_ept_ready;
 #define HCI_FATAL_ERR_MSG true
 #define HCI_REGULAR_MSG false
 
-static struct net_buf *hci_rpmsg_cmd_recv(uint8_t *data, size_t remaining)
+// Messages to the host that can be waiting in the IPC TX scheduler at the same time
+#define HCI_TX_ITEM_COUNT 8
+
+/* Regular messages to the host go through the IPC TX scheduler, so they can't hold up the ESB RPC endpoint.
+ * The net_buf is kept until the message has been copied to the IPC buffer.
+ */
+struct hci_tx_item {
+	struct ipc_tx_item item;
+	struct net_buf *buf;
+};
+
+K_MEM_SLAB_DEFINE_STATIC(hci_tx_items, sizeof(struct hci_tx_item), HCI_TX_ITEM_COUNT, 4);
+
+static hci_rpmsg_stats_t hci_stats;
+
+static void hci_tx_sent(struct ipc_tx_item *item, int err);
+
+static struct ipc_tx_client hci_tx_client = {
+	.name = "hci",
+	.ept = &hci_ept,
+	// Bulk traffic, below the ESB RPC endpoint
+	.priority = 0,
+	.weight = 1,
+	.on_sent = hci_tx_sent,
+};
+
+// Received packets that can be passed to the controller straight from the IPC buffers at the same time
+#define HCI_RX_NOCOPY_COUNT 4
+
+/* Packets from the host are handed to the controller in the IPC RX buffer when the IPC backend can hold on to
+ * its RX buffers (the RPMsg backend can, ICMsg can't). The net_buf points to the data in shared memory, and the
+ * IPC buffer is released when the controller frees the net_buf. If the backend doesn't support it, or all the
+ * buffers of this pool are in use, the packet is copied into a controller buffer as before.
+ */
+static void hci_rx_nocopy_destroy(struct net_buf *buf);
+
+NET_BUF_POOL_FIXED_DEFINE(hci_rx_nocopy_pool, HCI_RX_NOCOPY_COUNT, 0, sizeof(struct bt_buf_data),
+			  hci_rx_nocopy_destroy);
+
+// IPC buffer held by each buffer of the pool, which starts with the packet indicator
+static void *hci_rx_nocopy_msgs[HCI_RX_NOCOPY_COUNT];
+static bool hci_rx_nocopy_supported = true;
+// IPC buffer of the message being handled by hci_ept_recv()
+static void *hci_rx_msg;
+
+static void hci_rx_nocopy_destroy(struct net_buf *buf)
+{
+	void *msg = hci_rx_nocopy_msgs[net_buf_id(buf)];
+
+	net_buf_destroy(buf);
+	ipc_service_release_rx_buffer(&hci_ept, msg);
+}
+
+static struct net_buf *hci_rpmsg_nocopy_buf_get(enum bt_buf_type type, uint8_t *data, size_t len)
 {
-	struct bt_hci_cmd_hdr *hdr = (void *)data;
 	struct net_buf *buf;
+	int err;
 
-	if (remaining < sizeof(*hdr)) {
-		LOG_ERR("Not enough data for command header");
+	if (!hci_rx_nocopy_supported) {
 		return NULL;
 	}
 
-	buf = bt_buf_get_tx(BT_BUF_CMD, K_NO_WAIT, hdr, sizeof(*hdr));
-	if (buf) {
-		data += sizeof(*hdr);
-		remaining -= sizeof(*hdr);
-	} else {
-		LOG_ERR("No available command buffers!");
+	buf = net_buf_alloc_with_data(&hci_rx_nocopy_pool, data, len, K_NO_WAIT);
+	if (buf == NULL) {
 		return NULL;
 	}
 
-	if (remaining != hdr->param_len) {
-		LOG_ERR("Command payload length is not correct");
-		net_buf_unref(buf);
+	err = ipc_service_hold_rx_buffer(&hci_ept, hci_rx_msg);
+	if (err) {
+		LOG_INF("IPC backend can't hold RX buffers (err %d), packets are copied", err);
+		hci_rx_nocopy_supported = false;
+		// Freed directly, so the destroy callback doesn't release a buffer that was never held
+		net_buf_destroy(buf);
+		return NULL;
+	}
+
+	hci_rx_nocopy_msgs[net_buf_id(buf)] = hci_rx_msg;
+	bt_buf_set_type(buf, type);
+	hci_stats.rx_nocopy++;
+	return buf;
+}
+
+/* Get a buffer holding the len bytes at data, a complete packet without the packet indicator */
+static struct net_buf *hci_rpmsg_buf_get(enum bt_buf_type type, uint8_t *data, size_t len)
+{
+	struct net_buf *buf;
+
+	hci_stats.rx_packets++;
+	hci_stats.rx_bytes += len;
+
+	buf = hci_rpmsg_nocopy_buf_get(type, data, len);
+	if (buf) {
+		return buf;
+	}
+
+	buf = bt_buf_get_tx(type, K_NO_WAIT, NULL, 0);
+	if (buf == NULL) {
 		return NULL;
 	}
 
-	if (remaining > net_buf_tailroom(buf)) {
+	if (len > net_buf_tailroom(buf)) {
 		LOG_ERR("Not enough space in buffer");
 		net_buf_unref(buf);
 		return NULL;
 	}
 
+	net_buf_add_mem(buf, data, len);
+	return buf;
+}
+
+static struct net_buf *hci_rpmsg_cmd_recv(uint8_t *data, size_t remaining)
+{
+	struct bt_hci_cmd_hdr *hdr = (void *)data;
+	struct net_buf *buf;
+
+	if (remaining < sizeof(*hdr)) {
+		LOG_ERR("Not enough data for command header");
+		return NULL;
+	}
+
+	if (remaining - sizeof(*hdr) != hdr->param_len) {
+		LOG_ERR("Command payload length is not correct");
+		return NULL;
+	}
+
+	buf = hci_rpmsg_buf_get(BT_BUF_CMD, data, remaining);
+	if (buf == NULL) {
+		LOG_ERR("No available command buffers!");
+		return NULL;
+	}
+
 	LOG_DBG("len %u", hdr->param_len);
-	net_buf_add_mem(buf, data, remaining);
 
 	return buf;
 }
@@ -100,29 +200,18 @@ static struct net_buf *hci_rpmsg_acl_recv(uint8_t *data, size_t remaining)
 		return NULL;
 	}
 
-	buf = bt_buf_get_tx(BT_BUF_ACL_OUT, K_NO_WAIT, hdr, sizeof(*hdr));
-	if (buf) {
-		data += sizeof(*hdr);
-		remaining -= sizeof(*hdr);
-	} else {
-		LOG_ERR("No available ACL buffers!");
-		return NULL;
-	}
-
-	if (remaining != sys_le16_to_cpu(hdr->len)) {
+	if (remaining - sizeof(*hdr) != sys_le16_to_cpu(hdr->len)) {
 		LOG_ERR("ACL payload length is not correct");
-		net_buf_unref(buf);
 		return NULL;
 	}
 
-	if (remaining > net_buf_tailroom(buf)) {
-		LOG_ERR("Not enough space in buffer");
-		net_buf_unref(buf);
+	buf = hci_rpmsg_buf_get(BT_BUF_ACL_OUT, data, remaining);
+	if (buf == NULL) {
+		LOG_ERR("No available ACL buffers!");
 		return NULL;
 	}
 
-	LOG_DBG("len %u", remaining);
-	net_buf_add_mem(buf, data, remaining);
+	LOG_DBG("len %u", sys_le16_to_cpu(hdr->len));
 
 	return buf;
 }
@@ -137,29 +226,18 @@ static struct net_buf *hci_rpmsg_iso_recv(uint8_t *data, size_t remaining)
 		return NULL;
 	}
 
-	buf = bt_buf_get_tx(BT_BUF_ISO_OUT, K_NO_WAIT, hdr, sizeof(*hdr));
-	if (buf) {
-		data += sizeof(*hdr);
-		remaining -= sizeof(*hdr);
-	} else {
-		LOG_ERR("No available ISO buffers!");
-		return NULL;
-	}
-
-	if (remaining != bt_iso_hdr_len(sys_le16_to_cpu(hdr->len))) {
+	if (remaining - sizeof(*hdr) != bt_iso_hdr_len(sys_le16_to_cpu(hdr->len))) {
 		LOG_ERR("ISO payload length is not correct");
-		net_buf_unref(buf);
 		return NULL;
 	}
 
-	if (remaining > net_buf_tailroom(buf)) {
-		LOG_ERR("Not enough space in buffer");
-		net_buf_unref(buf);
+	buf = hci_rpmsg_buf_get(BT_BUF_ISO_OUT, data, remaining);
+	if (buf == NULL) {
+		LOG_ERR("No available ISO buffers!");
 		return NULL;
 	}
 
-	LOG_DBG("len %zu", remaining);
-	net_buf_add_mem(buf, data, remaining);
+	LOG_DBG("len %zu", remaining - sizeof(*hdr));
 
 	return buf;
 }
@@ -251,6 +329,27 @@ static void hci_rpmsg_send(struct net_buf *buf, bool is_fatal_err)
 
 	LOG_HEXDUMP_DBG(buf->data, buf->len, "Final HCI buffer:");
 
+	if (!is_fatal_err) {
+		struct hci_tx_item *tx_item;
+
+		/* Blocks the RX thread while the scheduler is holding all the items, which throttles the controller.
+		 * The thread sleeps until an item is freed, rather than retrying, so the ESB stack and MPSL get
+		 * the CPU in the meantime. Every item is freed within IPC_TX_SCHED_SEND_TIMEOUT_MS.
+		 */
+		if (k_mem_slab_alloc(&hci_tx_items, (void **)&tx_item, K_NO_WAIT) != 0) {
+			uint32_t wait_start_cyc = k_cycle_get_32();
+
+			k_mem_slab_alloc(&hci_tx_items, (void **)&tx_item, K_FOREVER);
+			hci_stats.tx_waits++;
+			hci_stats.tx_wait_time_us += k_cyc_to_us_floor32(k_cycle_get_32() - wait_start_cyc);
+		}
+		tx_item->buf = buf;
+		tx_item->item.data = buf->data;
+		tx_item->item.len = buf->len;
+		ipc_tx_sched_send(&hci_tx_client, &tx_item->item);
+		return;
+	}
+
 	do {
 		ret = ipc_service_send(&hci_ept, buf->data, buf->len);
 		if (ret < 0) {
@@ -261,20 +360,13 @@ static void hci_rpmsg_send(struct net_buf *buf, bool is_fatal_err)
 				retries = 0;
 			}
 
-			/* The function can be called by the application main thread,
-			 * bt_ctlr_assert_handle and k_sys_fatal_error_handler. In case of a call by
-			 * Bluetooth Controller assert handler or system fatal error handler the
-			 * call can be from ISR context, hence there is no thread to yield. Besides
-			 * that both handlers implement a policy to provide error information and
-			 * stop the system in an infinite loop. The goal is to prevent any other
-			 * damage to the system if one of such exeptional situations occur, hence
-			 * call to k_yield is against it.
+			/* Fatal errors are reported by bt_ctlr_assert_handle and k_sys_fatal_error_handler,
+			 * possibly from ISR context with interrupts locked, so the message is sent directly
+			 * rather than through the scheduler thread, and there is no thread to yield to.
+			 * Both handlers implement a policy to provide error information and stop the system
+			 * in an infinite loop.
 			 */
-			if (is_fatal_err) {
-				LOG_ERR("IPC service send error: %d", ret);
-			} else {
-				k_yield();
-			}
+			LOG_ERR("IPC service send error: %d", ret);
 		}
 	} while (ret < 0);
 
@@ -283,6 +375,14 @@ static void hci_rpmsg_send(struct net_buf *buf, bool is_fatal_err)
 	net_buf_unref(buf);
 }
 
+static void hci_tx_sent(struct ipc_tx_item *item, int err)
+{
+	struct hci_tx_item *tx_item = CONTAINER_OF(item, struct hci_tx_item, item);
+
+	net_buf_unref(tx_item->buf);
+	k_mem_slab_free(&hci_tx_items, tx_item);
+}
+
 /* incoming events and data from the controller */
 static K_FIFO_DEFINE(rx_queue);
 
@@ -387,7 +487,9 @@ static void hci_ept_bound(void *priv)
 
 static void hci_ept_recv(const void *data, size_t len, void *priv)
 {
+	ipc_tx_sched_rx_notify();
 	LOG_DBG("Received message of %u bytes.", len);
+	hci_rx_msg = (void *)data;
 	hci_rpmsg_rx((uint8_t *) data, len);
 }
 
@@ -435,9 +537,23 @@ int hci_rpmsg_init(void)
 		LOG_ERR("Registering endpoint failed with %d", err);
 	}
 
+	err = ipc_tx_sched_client_register(&hci_tx_client);
+	if (err) {
+		LOG_ERR("IPC TX scheduler register failed with %d", err);
+	}
+
 	return 0;
 }
 
+void hci_rpmsg_stats_get(hci_rpmsg_stats_t *stats)
+{
+	uint32_t key = irq_lock();
+
+	*stats = hci_stats;
+	ipc_tx_sched_stats_get(&hci_tx_client, &stats->ipc);
+	irq_unlock(key);
+}
+
 int hci_rpmsg_run(void)
 {
 	k_sem_take(&ipc_bound_sem, K_FOREVER);
@@ -1,6 +1,20 @@
 #ifndef __HCI_RPMSG_MODULE_H
 #define __HCI_RPMSG_MODULE_H
 
+#include <zephyr/kernel.h>
+#include "ipc_tx_sched.h"
+
+typedef struct {
+	uint32_t rx_packets;			// Commands, ACL and ISO packets from the host
+	uint64_t rx_bytes;
+	uint32_t rx_nocopy;				// Packets passed to the controller in the IPC buffer, without a copy
+	uint32_t tx_waits;				// Messages from the controller that waited for a free TX item
+	uint64_t tx_wait_time_us;		// Total time the RX thread was blocked waiting for TX items
+	ipc_tx_sched_stats_t ipc;		// Scheduler stats of the HCI endpoint, including IPC stalls and drops
+} hci_rpmsg_stats_t;
+
 int hci_rpmsg_init(void);
 
+void hci_rpmsg_stats_get(hci_rpmsg_stats_t *stats);
+
 #endif
@@ -0,0 +1,236 @@
+#include "ipc_tx_sched.h"
+#include <zephyr/irq.h>
+#include <string.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(ipc_tx_sched, LOG_LEVEL_INF);
+
+#define THREAD_STACK_SIZE	1024
+#define THREAD_PRIORITY		K_PRIO_COOP(7)
+
+static sys_slist_t m_clients = SYS_SLIST_STATIC_INIT(&m_clients);
+// Client currently being served in the round robin, and whether it has been given its quantum for this turn
+static struct ipc_tx_client *m_current;
+static bool m_current_funded;
+
+static K_SEM_DEFINE(m_pending_sem, 0, K_SEM_MAX_LIMIT);
+// Given when a message is received from the other core, while the scheduler thread waits for IPC buffer space
+static K_SEM_DEFINE(m_tx_space_sem, 0, 1);
+static K_THREAD_STACK_DEFINE(m_thread_stack, THREAD_STACK_SIZE);
+static struct k_thread m_thread;
+
+static void client_next(void)
+{
+	sys_snode_t *next = sys_slist_peek_next(&m_current->node);
+
+	m_current = next ? CONTAINER_OF(next, struct ipc_tx_client, node) :
+			   CONTAINER_OF(sys_slist_peek_head(&m_clients), struct ipc_tx_client, node);
+	m_current_funded = false;
+}
+
+/* Pick the next item to send. Must be called with interrupts locked. */
+static struct ipc_tx_item *item_pick(struct ipc_tx_client **client_out)
+{
+	struct ipc_tx_client *client;
+	struct ipc_tx_item *item;
+	int priority = -1;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&m_clients, client, node) {
+		if (!sys_slist_is_empty(&client->queue) && client->priority > priority) {
+			priority = client->priority;
+		}
+	}
+	if (priority < 0) {
+		return NULL;
+	}
+
+	// Deficit round robin among the clients with the highest priority. Ends within a few rounds,
+	// as every turn adds a quantum to the deficit of a client with data.
+	while (1) {
+		client = m_current;
+		if (client->priority == priority && !sys_slist_is_empty(&client->queue)) {
+			item = CONTAINER_OF(sys_slist_peek_head(&client->queue), struct ipc_tx_item, node);
+			if (!m_current_funded) {
+				client->deficit += client->weight * IPC_TX_SCHED_QUANTUM_BYTES;
+				m_current_funded = true;
+			}
+			if (client->deficit >= (int32_t)item->len) {
+				client->deficit -= item->len;
+				sys_slist_get_not_empty(&client->queue);
+				client->stats.queued--;
+				if (sys_slist_is_empty(&client->queue)) {
+					// An idle client doesn't save up credit
+					client->deficit = 0;
+				}
+				*client_out = client;
+				return item;
+			}
+		} else if (sys_slist_is_empty(&client->queue)) {
+			client->deficit = 0;
+		}
+		client_next();
+	}
+}
+
+/* Blocks until the message is sent, the timeout expires, or a different error occurs */
+static int item_send_wait(struct ipc_tx_client *client, struct ipc_tx_item *item)
+{
+	uint32_t backoff_ms = IPC_TX_SCHED_BACKOFF_MIN_MS;
+	uint32_t stall_start_cyc = 0;
+	bool stalled = false;
+	bool timeout_logged = false;
+	int64_t deadline = 0;
+	int err;
+
+	while (1) {
+		k_sem_reset(&m_tx_space_sem);
+		err = ipc_service_send(client->ept, item->data, item->len);
+		if (err != -ENOMEM) {
+			break;
+		}
+		if (!stalled) {
+			stalled = true;
+			stall_start_cyc = k_cycle_get_32();
+			deadline = k_uptime_get() + IPC_TX_SCHED_SEND_TIMEOUT_MS;
+		} else if (k_uptime_get() >= deadline) {
+			if (!client->reliable) {
+				err = -ETIMEDOUT;
+				break;
+			}
+			if (!timeout_logged) {
+				LOG_WRN("%s: IPC buffer full for %i ms, still waiting", client->name,
+					IPC_TX_SCHED_SEND_TIMEOUT_MS);
+				timeout_logged = true;
+			}
+		}
+		// The IPC buffer is full, sleep until the other core has read some of it
+		k_sem_take(&m_tx_space_sem, K_MSEC(backoff_ms));
+		backoff_ms = MIN(backoff_ms * 2, IPC_TX_SCHED_BACKOFF_MAX_MS);
+	}
+
+	if (stalled) {
+		uint32_t stall_us = k_cyc_to_us_floor32(k_cycle_get_32() - stall_start_cyc);
+		uint32_t key = irq_lock();
+
+		client->stats.stalls++;
+		client->stats.stall_time_us += stall_us;
+		irq_unlock(key);
+	}
+	return err;
+}
+
+static void item_send(struct ipc_tx_client *client, struct ipc_tx_item *item)
+{
+	uint32_t delay_us;
+	int err;
+
+	err = item_send_wait(client, item);
+
+	delay_us = k_cyc_to_us_floor32(k_cycle_get_32() - item->enqueued_cyc);
+
+	uint32_t key = irq_lock();
+	if (err == -ETIMEDOUT) {
+		client->stats.drops++;
+	} else if (err < 0) {
+		client->stats.send_errors++;
+	} else {
+		client->stats.messages++;
+		client->stats.bytes += item->len;
+		client->stats.delay_last_us = delay_us;
+		client->stats.delay_total_us += delay_us;
+		if (delay_us > client->stats.delay_max_us) {
+			client->stats.delay_max_us = delay_us;
+		}
+	}
+	irq_unlock(key);
+
+	if (err == -ETIMEDOUT) {
+		LOG_WRN("%s: IPC buffer full for %i ms, message dropped", client->name, IPC_TX_SCHED_SEND_TIMEOUT_MS);
+	} else if (err < 0) {
+		LOG_ERR("%s: IPC send error: %d", client->name, err);
+	}
+	client->on_sent(item, err < 0 ? err : 0);
+}
+
+static void sched_thread(void *p1, void *p2, void *p3)
+{
+	struct ipc_tx_client *client;
+	struct ipc_tx_item *item;
+
+	while (1) {
+		k_sem_take(&m_pending_sem, K_FOREVER);
+
+		uint32_t key = irq_lock();
+		item = item_pick(&client);
+		irq_unlock(key);
+
+		if (item) {
+			item_send(client, item);
+		}
+	}
+}
+
+int ipc_tx_sched_client_register(struct ipc_tx_client *client)
+{
+	bool first_client;
+	uint32_t key;
+
+	if (client == NULL || client->ept == NULL || client->on_sent == NULL) {
+		return -EINVAL;
+	}
+
+	if (client->weight == 0) {
+		client->weight = 1;
+	}
+	sys_slist_init(&client->queue);
+	client->deficit = 0;
+	memset(&client->stats, 0, sizeof(client->stats));
+
+	key = irq_lock();
+	first_client = sys_slist_is_empty(&m_clients);
+	sys_slist_append(&m_clients, &client->node);
+	if (first_client) {
+		m_current = client;
+		m_current_funded = false;
+	}
+	irq_unlock(key);
+
+	LOG_INF("IPC TX client %s registered, prio %i, weight %i", client->name, client->priority, client->weight);
+
+	if (first_client) {
+		k_thread_create(&m_thread, m_thread_stack, K_THREAD_STACK_SIZEOF(m_thread_stack), sched_thread,
+				NULL, NULL, NULL, THREAD_PRIORITY, 0, K_NO_WAIT);
+		k_thread_name_set(&m_thread, "IPC TX sched");
+	}
+	return 0;
+}
+
+int ipc_tx_sched_send(struct ipc_tx_client *client, struct ipc_tx_item *item)
+{
+	uint32_t key;
+
+	item->enqueued_cyc = k_cycle_get_32();
+
+	key = irq_lock();
+	sys_slist_append(&client->queue, &item->node);
+	client->stats.queued++;
+	if (client->stats.queued > client->stats.queued_max) {
+		client->stats.queued_max = client->stats.queued;
+	}
+	irq_unlock(key);
+
+	k_sem_give(&m_pending_sem);
+	return 0;
+}
+
+void ipc_tx_sched_rx_notify(void)
+{
+	k_sem_give(&m_tx_space_sem);
+}
+
+void ipc_tx_sched_stats_get(struct ipc_tx_client *client, ipc_tx_sched_stats_t *stats)
+{
+	uint32_t key = irq_lock();
+	*stats = client->stats;
+	irq_unlock(key);
+}
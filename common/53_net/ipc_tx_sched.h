@@ -0,0 +1,85 @@
+#ifndef __IPC_TX_SCHED_H
+#define __IPC_TX_SCHED_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/slist.h>
+#include <zephyr/ipc/ipc_service.h>
+
+/* Send side scheduler for the IPC endpoints sharing the ipc0 instance on the network core.
+ * Every endpoint is a client with its own queue, and a single thread passes the messages on to
+ * ipc_service_send(). Clients with a higher priority are always served first, and clients of the same
+ * priority share the bandwidth in bytes according to their weights (deficit round robin).
+ * This keeps short, latency critical messages, like the ESB RPC responses, from waiting behind a burst of
+ * HCI events or ACL data.
+ */
+
+// Bytes a client of weight 1 may send per round, when clients of the same priority are competing
+#define IPC_TX_SCHED_QUANTUM_BYTES	256
+
+/* When the IPC buffer is full the scheduler thread sleeps until the other core sends something, which is when
+ * the IPC backend gets its TX buffers back, or until the backoff expires. The backoff doubles up to the max.
+ * A message that can't be sent within the timeout is dropped, unless the client is reliable.
+ */
+#define IPC_TX_SCHED_BACKOFF_MIN_MS	1
+#define IPC_TX_SCHED_BACKOFF_MAX_MS	16
+#define IPC_TX_SCHED_SEND_TIMEOUT_MS	1000
+
+struct ipc_tx_item {
+	sys_snode_t node;
+	const void *data;
+	size_t len;
+	uint32_t enqueued_cyc;
+};
+
+typedef struct {
+	uint32_t messages;
+	uint64_t bytes;
+	uint32_t queued;				// Messages currently waiting in the queue
+	uint32_t queued_max;
+	uint32_t delay_last_us;			// Time from ipc_tx_sched_send() until the message was passed to the IPC service
+	uint32_t delay_max_us;
+	uint64_t delay_total_us;
+	uint32_t send_errors;
+	uint32_t stalls;				// Messages that found the IPC buffer full and had to wait
+	uint64_t stall_time_us;			// Total time spent waiting for space in the IPC buffer
+	uint32_t drops;					// Messages dropped after waiting IPC_TX_SCHED_SEND_TIMEOUT_MS
+} ipc_tx_sched_stats_t;
+
+struct ipc_tx_client {
+	const char *name;
+	struct ipc_ept *ept;
+	// Clients with a higher priority are always served first
+	uint8_t priority;
+	// Relative share of the bandwidth compared to other clients of the same priority
+	uint32_t weight;
+	// Messages of a reliable client are never dropped, the scheduler waits for IPC buffer space for as long as it
+	// takes. For request/response protocols where a lost message would leave the other core waiting forever.
+	bool reliable;
+	// Called from the scheduler thread when the item has been sent, or failed with err. The item can be reused.
+	void (*on_sent)(struct ipc_tx_item *item, int err);
+
+	// Internal scheduler state, should not be touched by the client
+	sys_snode_t node;
+	sys_slist_t queue;
+	int32_t deficit;
+	ipc_tx_sched_stats_t stats;
+};
+
+/* Register a client. The scheduler thread is started when the first client registers.
+ * The client struct must remain valid for the lifetime of the application.
+ */
+int ipc_tx_sched_client_register(struct ipc_tx_client *client);
+
+/* Queue a message for the client's endpoint. The data must stay valid until on_sent is called.
+ * Can be called from any context.
+ */
+int ipc_tx_sched_send(struct ipc_tx_client *client, struct ipc_tx_item *item);
+
+/* Tell the scheduler that a message was received on the instance, which means the other core is running and
+ * TX buffers may have been freed. Called from the received callback of every endpoint.
+ */
+void ipc_tx_sched_rx_notify(void);
+
+void ipc_tx_sched_stats_get(struct ipc_tx_client *client, ipc_tx_sched_stats_t *stats);
+
+#endif
@@ -0,0 +1,168 @@
+#include "app_bt_adv.h"
+#include "app_esb.h"
+
+#include <zephyr/bluetooth/conn.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_bt_adv, LOG_LEVEL_INF);
+
+// How often the connection state and the ESB load are checked
+#define CHECK_INTERVAL_MS		500
+// ESB is under pressure when this many TX payloads are waiting
+#define ESB_PRESSURE_BACKLOG	(APP_ESB_TX_QUEUE_SIZE / 2)
+
+static const struct bt_le_adv_param m_adv_params[] = {
+	[APP_BT_ADV_MODE_FAST] = BT_LE_ADV_PARAM_INIT(BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_ONE_TIME,
+						      BT_GAP_ADV_FAST_INT_MIN_2, BT_GAP_ADV_FAST_INT_MAX_2, NULL),
+	[APP_BT_ADV_MODE_SLOW] = BT_LE_ADV_PARAM_INIT(BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_ONE_TIME,
+						      BT_GAP_ADV_SLOW_INT_MIN, BT_GAP_ADV_SLOW_INT_MAX, NULL),
+};
+
+static const char *const m_mode_names[APP_BT_ADV_MODE_COUNT] = {"fast", "slow", "paused"};
+
+static const struct bt_data *m_ad;
+static size_t m_ad_len;
+static const struct bt_data *m_sd;
+static size_t m_sd_len;
+
+static bool m_started;
+// Advertising is running in the current mode. Cleared when the host stops it because of a connection.
+static bool m_advertising;
+static uint32_t m_conn_count;
+static int64_t m_fast_until_ms;
+static int64_t m_mode_entered_ms;
+
+static app_bt_adv_stats_t m_stats = {.mode = APP_BT_ADV_MODE_PAUSED};
+
+static void check_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(m_check_work, check_work_handler);
+
+static app_bt_adv_mode_t mode_select(bool *esb_pressure)
+{
+	*esb_pressure = app_esb_tx_backlog_get() >= ESB_PRESSURE_BACKLOG;
+
+	if (m_conn_count >= CONFIG_BT_MAX_CONN) {
+		return APP_BT_ADV_MODE_PAUSED;
+	}
+	// With a central connected there is no hurry to find the next one, and the radio is shared three ways already
+	if (m_conn_count > 0 || *esb_pressure || k_uptime_get() >= m_fast_until_ms) {
+		return APP_BT_ADV_MODE_SLOW;
+	}
+	return APP_BT_ADV_MODE_FAST;
+}
+
+static void mode_enter(app_bt_adv_mode_t mode)
+{
+	int64_t now = k_uptime_get();
+
+	m_stats.time_in_mode_ms[m_stats.mode] += now - m_mode_entered_ms;
+	m_mode_entered_ms = now;
+	if (mode != m_stats.mode) {
+		m_stats.mode_changes++;
+		LOG_INF("Advertising %s", m_mode_names[mode]);
+	}
+	m_stats.mode = mode;
+}
+
+static void check_work_handler(struct k_work *work)
+{
+	app_bt_adv_mode_t mode;
+	bool esb_pressure;
+	int err;
+
+	mode = mode_select(&esb_pressure);
+
+	if (mode != m_stats.mode || !m_advertising) {
+		if (m_advertising) {
+			bt_le_adv_stop();
+			m_advertising = false;
+		}
+		if (mode == APP_BT_ADV_MODE_SLOW && m_stats.mode == APP_BT_ADV_MODE_FAST && esb_pressure) {
+			m_stats.slow_for_esb++;
+		}
+		if (mode != APP_BT_ADV_MODE_PAUSED) {
+			// The scan response is left out in slow mode, so scan requests don't take extra radio time
+			err = bt_le_adv_start(&m_adv_params[mode], m_ad, m_ad_len,
+					      (mode == APP_BT_ADV_MODE_FAST) ? m_sd : NULL,
+					      (mode == APP_BT_ADV_MODE_FAST) ? m_sd_len : 0);
+			if (err) {
+				// Can fail right after a disconnect, until the connection object has been released
+				m_stats.start_failures++;
+				LOG_DBG("Advertising start failed (err %d)", err);
+			} else {
+				m_advertising = true;
+			}
+		}
+		mode_enter(mode);
+	}
+
+	k_work_schedule(&m_check_work, K_MSEC(CHECK_INTERVAL_MS));
+}
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+	struct bt_conn_info info;
+
+	if (err || bt_conn_get_info(conn, &info) != 0 || info.role != BT_CONN_ROLE_PERIPHERAL) {
+		return;
+	}
+	m_conn_count++;
+	// Connectable advertising stops when a central connects
+	m_advertising = false;
+	if (m_started) {
+		k_work_reschedule(&m_check_work, K_NO_WAIT);
+	}
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	struct bt_conn_info info;
+
+	if (bt_conn_get_info(conn, &info) != 0 || info.role != BT_CONN_ROLE_PERIPHERAL || m_conn_count == 0) {
+		return;
+	}
+	m_conn_count--;
+	// Give the central a fast window to reconnect
+	m_fast_until_ms = k_uptime_get() + APP_BT_ADV_FAST_WINDOW_MS;
+	if (m_started) {
+		k_work_reschedule(&m_check_work, K_NO_WAIT);
+	}
+}
+
+BT_CONN_CB_DEFINE(adv_conn_callbacks) = {
+	.connected = connected,
+	.disconnected = disconnected,
+};
+
+int app_bt_adv_start(const struct bt_data *ad, size_t ad_len, const struct bt_data *sd, size_t sd_len)
+{
+	int err;
+
+	m_ad = ad;
+	m_ad_len = ad_len;
+	m_sd = sd;
+	m_sd_len = sd_len;
+
+	// The first start is done here, so the caller gets the error
+	err = bt_le_adv_start(&m_adv_params[APP_BT_ADV_MODE_FAST], ad, ad_len, sd, sd_len);
+	if (err) {
+		return err;
+	}
+	m_advertising = true;
+	m_fast_until_ms = k_uptime_get() + APP_BT_ADV_FAST_WINDOW_MS;
+	m_mode_entered_ms = k_uptime_get();
+	mode_enter(APP_BT_ADV_MODE_FAST);
+	m_started = true;
+
+	k_work_schedule(&m_check_work, K_MSEC(CHECK_INTERVAL_MS));
+	return 0;
+}
+
+void app_bt_adv_stats_get(app_bt_adv_stats_t *stats)
+{
+	int64_t now = k_uptime_get();
+
+	*stats = m_stats;
+	stats->time_in_mode_ms[stats->mode] += now - m_mode_entered_ms;
+}
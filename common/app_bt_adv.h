@@ -0,0 +1,38 @@
+#ifndef __APP_BT_ADV_H
+#define __APP_BT_ADV_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+/* Advertising governor. Advertising events preempt ESB timeslots just like connection events, so connectable
+ * advertising is kept as light as the situation allows:
+ * - FAST: short interval and the full advertising and scan response data, for APP_BT_ADV_FAST_WINDOW_MS after
+ *   advertising starts or a connection is lost, so a central can find the device quickly
+ * - SLOW: long interval and the advertising data only, after the fast window, while at least one central is
+ *   connected, or whenever ESB TX payloads are backing up
+ * - PAUSED: no advertising while all CONFIG_BT_MAX_CONN connections are in use
+ */
+
+#define APP_BT_ADV_FAST_WINDOW_MS	30000
+
+typedef enum {
+	APP_BT_ADV_MODE_FAST,
+	APP_BT_ADV_MODE_SLOW,
+	APP_BT_ADV_MODE_PAUSED,
+	APP_BT_ADV_MODE_COUNT
+} app_bt_adv_mode_t;
+
+typedef struct {
+	app_bt_adv_mode_t mode;
+	uint32_t mode_changes;
+	uint32_t slow_for_esb;			// Switches from fast to slow because of ESB TX pressure
+	uint32_t start_failures;		// Failed attempts to start advertising, retried on the next check
+	uint64_t time_in_mode_ms[APP_BT_ADV_MODE_COUNT];
+} app_bt_adv_stats_t;
+
+/* Start advertising. The data arrays must remain valid, the slow mode only uses the advertising data. */
+int app_bt_adv_start(const struct bt_data *ad, size_t ad_len, const struct bt_data *sd, size_t sd_len);
+
+void app_bt_adv_stats_get(app_bt_adv_stats_t *stats);
+
+#endif
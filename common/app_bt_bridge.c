@@ -0,0 +1,332 @@
+#include "app_bt_bridge.h"
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/sys/ring_buffer.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_bt_bridge, LOG_LEVEL_INF);
+
+#define BT_UUID_ESB_BRIDGE			BT_UUID_DECLARE_128(BT_UUID_ESB_BRIDGE_VAL)
+#define BT_UUID_ESB_BRIDGE_RX		BT_UUID_DECLARE_128(BT_UUID_ESB_BRIDGE_RX_VAL)
+#define BT_UUID_ESB_BRIDGE_TX		BT_UUID_DECLARE_128(BT_UUID_ESB_BRIDGE_TX_VAL)
+#define BT_UUID_ESB_BRIDGE_STATS	BT_UUID_DECLARE_128(BT_UUID_ESB_BRIDGE_STATS_VAL)
+
+#define ESB_PAYLOAD_MAX_LENGTH		sizeof(((app_esb_data_t *)0)->data)
+// Largest notification, for an ATT MTU of 247
+#define NOTIFY_MAX_LENGTH			244
+// Retry interval when the Bluetooth stack is out of buffers and there is no notification in flight to wait for
+#define NOTIFY_RETRY_MS				5
+
+// Both queues hold entries of a length byte followed by the payload
+RING_BUF_DECLARE(m_rx_ring, APP_BT_BRIDGE_RX_QUEUE_SIZE);
+RING_BUF_DECLARE(m_tx_ring, APP_BT_BRIDGE_TX_QUEUE_SIZE);
+
+// Connection the ESB RX packets are notified to, the first one to subscribe
+static struct bt_conn *m_conn;
+static atomic_t m_notify_in_flight;
+
+// Notification being built, kept until the Bluetooth stack accepts it
+static uint8_t m_notify_buf[NOTIFY_MAX_LENGTH];
+static uint32_t m_notify_len;
+static uint32_t m_notify_entries;
+
+static app_bt_bridge_stats_t m_stats;
+
+static void rx_work_handler(struct k_work *work);
+static void tx_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(m_rx_work, rx_work_handler);
+static K_WORK_DEFINE(m_tx_work, tx_work_handler);
+
+static void subscriber_update(void);
+
+static void rx_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	// The value is combined for all connections, so check which ones are subscribed
+	subscriber_update();
+}
+
+static ssize_t tx_write(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf, uint16_t len,
+			uint16_t offset, uint8_t flags);
+static ssize_t stats_read(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+			  uint16_t offset);
+
+BT_GATT_SERVICE_DEFINE(esb_bridge_svc,
+	BT_GATT_PRIMARY_SERVICE(BT_UUID_ESB_BRIDGE),
+	BT_GATT_CHARACTERISTIC(BT_UUID_ESB_BRIDGE_RX, BT_GATT_CHRC_NOTIFY, BT_GATT_PERM_NONE, NULL, NULL, NULL),
+	BT_GATT_CCC(rx_ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+	BT_GATT_CHARACTERISTIC(BT_UUID_ESB_BRIDGE_TX, BT_GATT_CHRC_WRITE | BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+			       BT_GATT_PERM_WRITE, NULL, tx_write, NULL),
+	BT_GATT_CHARACTERISTIC(BT_UUID_ESB_BRIDGE_STATS, BT_GATT_CHRC_READ, BT_GATT_PERM_READ, stats_read, NULL, NULL),
+);
+
+// Value attribute of the RX characteristic, after the service and characteristic declarations
+#define RX_ATTR (&esb_bridge_svc.attrs[2])
+
+static void notify_sent(struct bt_conn *conn, void *user_data)
+{
+	// Notifications still in flight at disconnect may complete after the counter was reset
+	if (atomic_dec(&m_notify_in_flight) <= 0) {
+		atomic_set(&m_notify_in_flight, 0);
+	}
+	k_work_reschedule(&m_rx_work, K_NO_WAIT);
+}
+
+/* Move as many whole entries from the RX queue into the notification as fit in the MTU */
+static void notify_fill(void)
+{
+	uint32_t max_len = MIN(bt_gatt_get_mtu(m_conn) - 3, NOTIFY_MAX_LENGTH);
+	uint8_t len;
+
+	uint32_t key = irq_lock();
+	while (ring_buf_peek(&m_rx_ring, &len, 1) == 1) {
+		if (1 + len > max_len) {
+			// Can't be sent with the MTU of this connection
+			ring_buf_get(&m_rx_ring, NULL, 1 + len);
+			m_stats.rx_dropped++;
+			continue;
+		}
+		if (m_notify_len + 1 + len > max_len) {
+			break;
+		}
+		ring_buf_get(&m_rx_ring, &m_notify_buf[m_notify_len], 1 + len);
+		m_notify_len += 1 + len;
+		m_notify_entries++;
+	}
+	irq_unlock(key);
+}
+
+static void rx_work_handler(struct k_work *work)
+{
+	struct bt_gatt_notify_params params = {
+		.attr = RX_ATTR,
+		.data = m_notify_buf,
+		.func = notify_sent,
+	};
+	int err;
+
+	if (m_conn == NULL) {
+		return;
+	}
+
+	// Packets received while notifications are in flight are collected, and go out together in the next one
+	while (atomic_get(&m_notify_in_flight) < APP_BT_BRIDGE_NOTIFY_IN_FLIGHT) {
+		if (m_notify_len == 0) {
+			notify_fill();
+		}
+		if (m_notify_len == 0) {
+			return;
+		}
+
+		params.len = m_notify_len;
+		atomic_inc(&m_notify_in_flight);
+		err = bt_gatt_notify_cb(m_conn, &params);
+		if (err == -ENOMEM) {
+			// Out of buffers, try again when a notification has been sent
+			atomic_dec(&m_notify_in_flight);
+			if (atomic_get(&m_notify_in_flight) == 0) {
+				k_work_schedule(&m_rx_work, K_MSEC(NOTIFY_RETRY_MS));
+			}
+			return;
+		}
+		if (err) {
+			atomic_dec(&m_notify_in_flight);
+			LOG_WRN("Notification failed (err %d), %i packets dropped", err, m_notify_entries);
+			m_stats.rx_dropped += m_notify_entries;
+		} else {
+			m_stats.rx_notifications++;
+			m_stats.rx_packets += m_notify_entries;
+			m_stats.rx_bytes += m_notify_len - m_notify_entries;
+		}
+		m_notify_len = 0;
+		m_notify_entries = 0;
+	}
+}
+
+static ssize_t tx_write(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf, uint16_t len,
+			uint16_t offset, uint8_t flags)
+{
+	const uint8_t *data = buf;
+	uint32_t entries = 0;
+	uint32_t key;
+
+	if (offset != 0) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+	// Check the whole write before queuing any of it
+	for (uint32_t i = 0; i < len; i += 1 + data[i]) {
+		if (data[i] == 0 || data[i] > ESB_PAYLOAD_MAX_LENGTH || i + 1 + data[i] > len) {
+			return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+		}
+		entries++;
+	}
+
+	key = irq_lock();
+	if (ring_buf_space_get(&m_tx_ring) < len) {
+		if (flags & BT_GATT_WRITE_FLAG_CMD) {
+			m_stats.tx_dropped += entries;
+		} else {
+			m_stats.tx_rejected++;
+		}
+		irq_unlock(key);
+		return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+	}
+	ring_buf_put(&m_tx_ring, data, len);
+	irq_unlock(key);
+
+	k_work_submit(&m_tx_work);
+	return len;
+}
+
+static void tx_work_handler(struct k_work *work)
+{
+	uint8_t entry[1 + ESB_PAYLOAD_MAX_LENGTH];
+	app_esb_data_t payload;
+	uint32_t key;
+	int err;
+
+	while (1) {
+		key = irq_lock();
+		if (ring_buf_peek(&m_tx_ring, entry, 1) != 1) {
+			irq_unlock(key);
+			return;
+		}
+		ring_buf_peek(&m_tx_ring, entry, 1 + entry[0]);
+		irq_unlock(key);
+
+		memcpy(payload.data, &entry[1], entry[0]);
+		payload.len = entry[0];
+		err = app_esb_send(&payload);
+		if (err == -ENOMEM) {
+			// The ESB TX queue is full, continue when a packet has been sent
+			return;
+		}
+
+		key = irq_lock();
+		ring_buf_get(&m_tx_ring, NULL, 1 + entry[0]);
+		if (err < 0) {
+			m_stats.tx_dropped++;
+		} else {
+			m_stats.tx_packets++;
+			m_stats.tx_bytes += payload.len;
+		}
+		irq_unlock(key);
+	}
+}
+
+static ssize_t stats_read(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+			  uint16_t offset)
+{
+	app_bt_bridge_stats_t stats;
+
+	app_bt_bridge_stats_get(&stats);
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &stats, sizeof(stats));
+}
+
+void app_bt_bridge_on_esb_event(app_esb_event_t *event)
+{
+	uint8_t len;
+
+	switch (event->evt_type) {
+		case APP_ESB_EVT_TX_SUCCESS:
+		case APP_ESB_EVT_TX_FAIL:
+			// Space in the ESB TX queue may have been freed
+			k_work_submit(&m_tx_work);
+			break;
+		case APP_ESB_EVT_RX:
+			if (m_conn == NULL) {
+				break;
+			}
+			len = (uint8_t)event->data_length;
+
+			uint32_t key = irq_lock();
+			if (ring_buf_space_get(&m_rx_ring) < 1 + len) {
+				m_stats.rx_dropped++;
+				irq_unlock(key);
+				break;
+			}
+			ring_buf_put(&m_rx_ring, &len, 1);
+			ring_buf_put(&m_rx_ring, event->buf, len);
+			irq_unlock(key);
+
+			k_work_schedule(&m_rx_work, K_NO_WAIT);
+			break;
+		default:
+			break;
+	}
+}
+
+static void subscriber_find(struct bt_conn *conn, void *data)
+{
+	struct bt_conn **subscriber = data;
+
+	if (*subscriber == NULL && bt_gatt_is_subscribed(conn, RX_ATTR, BT_GATT_CCC_NOTIFY)) {
+		*subscriber = conn;
+	}
+}
+
+static void subscriber_release(void)
+{
+	uint32_t key;
+
+	k_work_cancel_delayable(&m_rx_work);
+
+	key = irq_lock();
+	ring_buf_reset(&m_rx_ring);
+	irq_unlock(key);
+
+	m_notify_len = 0;
+	m_notify_entries = 0;
+	atomic_set(&m_notify_in_flight, 0);
+
+	bt_conn_unref(m_conn);
+	m_conn = NULL;
+}
+
+/* Keep serving the current subscriber as long as it stays subscribed, otherwise move on to any other connection
+ * that has the RX notifications enabled
+ */
+static void subscriber_update(void)
+{
+	struct bt_conn *subscriber = NULL;
+
+	if (m_conn != NULL) {
+		if (bt_gatt_is_subscribed(m_conn, RX_ATTR, BT_GATT_CCC_NOTIFY)) {
+			return;
+		}
+		subscriber_release();
+		LOG_INF("ESB RX notifications disabled");
+	}
+
+	bt_conn_foreach(BT_CONN_TYPE_LE, subscriber_find, &subscriber);
+	if (subscriber != NULL) {
+		m_conn = bt_conn_ref(subscriber);
+		LOG_INF("ESB RX notifications enabled");
+	}
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	if (conn != m_conn) {
+		return;
+	}
+
+	// Payloads already written to the TX queue, by this or any other central, are still sent
+	subscriber_release();
+	subscriber_update();
+}
+
+BT_CONN_CB_DEFINE(bridge_conn_callbacks) = {
+	.disconnected = disconnected,
+};
+
+void app_bt_bridge_stats_get(app_bt_bridge_stats_t *stats)
+{
+	uint32_t key = irq_lock();
+	*stats = m_stats;
+	irq_unlock(key);
+}
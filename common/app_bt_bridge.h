@@ -0,0 +1,53 @@
+#ifndef __APP_BT_BRIDGE_H
+#define __APP_BT_BRIDGE_H
+
+#include <zephyr/kernel.h>
+#include "app_esb.h"
+
+/* GATT service bridging ESB traffic to and from a connected phone.
+ *
+ * Both directions carry a stream of entries, each a length byte followed by an ESB payload of that length.
+ * - RX characteristic (notify): ESB packets received by app_esb. Entries are packed into notifications up to
+ *   the ATT MTU of the connection. While notifications are in flight new packets are queued, so under load
+ *   every notification is filled and the per packet overhead is one byte. With several centrals connected the
+ *   packets go to the first one that enabled notifications, until it disables them or disconnects.
+ * - TX characteristic (write, write without response): one or more entries, which are queued and passed to
+ *   app_esb_send() as TX queue space becomes available. A write request that doesn't fit in the queue is
+ *   rejected with an Insufficient Resources error, which the phone should take as a signal to slow down.
+ *   A write command that doesn't fit is dropped and counted.
+ * - Stats characteristic (read): app_bt_bridge_stats_t, as little endian 32-bit values.
+ */
+
+// UUIDs of the ESB bridge service and its characteristics
+#define BT_UUID_ESB_BRIDGE_VAL \
+	BT_UUID_128_ENCODE(0x4e5a0001, 0x8c2b, 0x4d7a, 0x9f31, 0x0b6e5e5b2c10)
+#define BT_UUID_ESB_BRIDGE_RX_VAL \
+	BT_UUID_128_ENCODE(0x4e5a0002, 0x8c2b, 0x4d7a, 0x9f31, 0x0b6e5e5b2c10)
+#define BT_UUID_ESB_BRIDGE_TX_VAL \
+	BT_UUID_128_ENCODE(0x4e5a0003, 0x8c2b, 0x4d7a, 0x9f31, 0x0b6e5e5b2c10)
+#define BT_UUID_ESB_BRIDGE_STATS_VAL \
+	BT_UUID_128_ENCODE(0x4e5a0004, 0x8c2b, 0x4d7a, 0x9f31, 0x0b6e5e5b2c10)
+
+// Bytes of ESB payloads (including the length bytes) that can be queued in each direction
+#define APP_BT_BRIDGE_RX_QUEUE_SIZE		1024
+#define APP_BT_BRIDGE_TX_QUEUE_SIZE		512
+// Notifications passed to the Bluetooth stack but not yet sent
+#define APP_BT_BRIDGE_NOTIFY_IN_FLIGHT	4
+
+typedef struct {
+	uint32_t rx_packets;			// ESB packets sent to the phone
+	uint32_t rx_bytes;
+	uint32_t rx_notifications;
+	uint32_t rx_dropped;			// ESB packets dropped because the RX queue was full
+	uint32_t tx_packets;			// Payloads from the phone accepted by app_esb_send()
+	uint32_t tx_bytes;
+	uint32_t tx_rejected;			// Write requests rejected because the TX queue was full
+	uint32_t tx_dropped;			// Payloads lost to write commands that didn't fit or app_esb_send() errors
+} app_bt_bridge_stats_t;
+
+/* Must be called for every app_esb event, from the ESB callback of the application */
+void app_bt_bridge_on_esb_event(app_esb_event_t *event);
+
+void app_bt_bridge_stats_get(app_bt_bridge_stats_t *stats);
+
+#endif
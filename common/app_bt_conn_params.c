@@ -0,0 +1,481 @@
+#include "app_bt_conn_params.h"
+#include "app_esb.h"
+#if !defined(CONFIG_SOC_NRF5340_CPUAPP)
+#include "timeslot_handler.h"
+#endif
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/conn.h>
+#include <sdc_hci_vs.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_bt_conn_params, LOG_LEVEL_INF);
+
+// Delay from connecting until the first request, so the central can finish service discovery first
+#define FIRST_UPDATE_DELAY_MS		1000
+// Least time between two requests, so a varying ESB load doesn't keep the connection renegotiating
+#define UPDATE_HOLDOFF_MS			5000
+// How often the ESB demand is checked
+#define DEMAND_CHECK_INTERVAL_MS	250
+// How often the ESB share of the radio time is measured. On the nRF5340 every measurement is an RPC call to the
+// network core, so this runs much less often than the demand check.
+#define ESB_SHARE_INTERVAL_MS		2000
+// ESB is busy when this many TX payloads are waiting, and idle again after this many checks without any
+#define ESB_BUSY_BACKLOG			(APP_ESB_TX_QUEUE_SIZE / 2)
+#define ESB_IDLE_CHECKS				8
+
+// Shortest gap between connection events that makes a useful ESB timeslot, the default TIMESLOT_LENGTH_US of
+// timeslot_handler.c
+#define ESB_SLOT_MIN_US				10000
+
+#define INTERVAL_US(us)		((us) / 1250)
+#define TIMEOUT_MS(ms)		((ms) / 10)
+
+struct conn_params {
+	uint16_t interval_min;			// 1.25 ms units
+	uint16_t interval_max;
+	uint16_t latency;
+	uint16_t timeout;				// 10 ms units
+};
+
+/* The intervals leave room for at least one 10 ms ESB timeslot between connection events, except when ESB is
+ * idle in the BLE latency profile. Peripheral latency lets the controller skip connection events when there is
+ * nothing to send, which gives those events to ESB as well.
+ */
+static const struct {
+	const char *name;
+	struct conn_params esb_idle;
+	struct conn_params esb_busy;
+	uint32_t event_length_us;
+} m_profiles[APP_BT_CONN_PROFILE_COUNT] = {
+	[APP_BT_CONN_PROFILE_ESB_THROUGHPUT] = {
+		.name = "ESB throughput first",
+		.esb_idle = {INTERVAL_US(30000), INTERVAL_US(50000), 2, TIMEOUT_MS(4000)},
+		.esb_busy = {INTERVAL_US(75000), INTERVAL_US(100000), 4, TIMEOUT_MS(4000)},
+		.event_length_us = 2500,
+	},
+	[APP_BT_CONN_PROFILE_BALANCED] = {
+		.name = "balanced",
+		.esb_idle = {INTERVAL_US(15000), INTERVAL_US(30000), 0, TIMEOUT_MS(4000)},
+		.esb_busy = {INTERVAL_US(30000), INTERVAL_US(50000), 2, TIMEOUT_MS(4000)},
+		.event_length_us = 3750,
+	},
+	[APP_BT_CONN_PROFILE_BLE_LATENCY] = {
+		.name = "BLE latency first",
+		.esb_idle = {INTERVAL_US(7500), INTERVAL_US(15000), 0, TIMEOUT_MS(4000)},
+		.esb_busy = {INTERVAL_US(15000), INTERVAL_US(30000), 0, TIMEOUT_MS(4000)},
+		.event_length_us = 7500,
+	},
+};
+
+struct conn_state {
+	struct bt_conn *conn;
+	uint16_t handle;
+	bool update_pending;
+	int64_t last_update_ms;
+	// Counter of the last connection event reported by the controller
+	uint16_t event_counter;
+	bool event_counter_valid;
+};
+
+static struct conn_state m_conns[CONFIG_BT_MAX_CONN];
+static app_bt_conn_profile_t m_profile = APP_BT_CONN_PROFILE_DEFAULT;
+static bool m_esb_busy;
+static uint32_t m_idle_checks;
+static app_esb_radio_time_t m_last_radio_time;
+static bool m_last_radio_time_valid;
+static app_bt_conn_params_status_t m_status;
+
+static void check_work_handler(struct k_work *work);
+static void share_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(m_check_work, check_work_handler);
+static K_WORK_DELAYABLE_DEFINE(m_share_work, share_work_handler);
+
+static int event_length_set(uint32_t event_length_us)
+{
+	sdc_hci_cmd_vs_event_length_set_t *cmd;
+	struct net_buf *buf;
+	int err;
+
+	buf = bt_hci_cmd_create(SDC_HCI_OPCODE_CMD_VS_EVENT_LENGTH_SET, sizeof(*cmd));
+	if (buf == NULL) {
+		return -ENOBUFS;
+	}
+	cmd = net_buf_add(buf, sizeof(*cmd));
+	cmd->event_length_us = event_length_us;
+
+	err = bt_hci_cmd_send_sync(SDC_HCI_OPCODE_CMD_VS_EVENT_LENGTH_SET, buf, NULL);
+	if (err) {
+		LOG_ERR("Event length set failed (err %d)", err);
+	}
+	return err;
+}
+
+static struct conn_state *conn_state_get(struct bt_conn *conn)
+{
+	for (int i = 0; i < CONFIG_BT_MAX_CONN; i++) {
+		if (m_conns[i].conn == conn) {
+			return &m_conns[i];
+		}
+	}
+	return NULL;
+}
+
+static void ble_share_update(void)
+{
+	uint32_t total = 0;
+
+	for (int i = 0; i < CONFIG_BT_MAX_CONN; i++) {
+		app_bt_conn_status_t *conn_status = &m_status.conns[i];
+		uint32_t share = 0;
+
+		if (conn_status->connected && conn_status->interval_us > 0) {
+			share = MIN((m_status.event_length_us * 1000) / conn_status->interval_us, 1000);
+		}
+		conn_status->ble_permille = share;
+		total += share;
+	}
+	m_status.ble_permille = MIN(total, 1000);
+}
+
+/* The parameters of the profile, with the interval stretched to leave room for ESB between the events of all the
+ * connections
+ */
+static void conn_params_get(struct bt_le_conn_param *param)
+{
+	const struct conn_params *params = m_esb_busy ? &m_profiles[m_profile].esb_busy :
+							&m_profiles[m_profile].esb_idle;
+	uint32_t count = MAX(m_status.conn_count, 1);
+	uint16_t interval_min = params->interval_min;
+	uint16_t interval_max = params->interval_max;
+
+	if (count > 1) {
+		uint32_t spread_min = DIV_ROUND_UP(count * (m_profiles[m_profile].event_length_us + ESB_SLOT_MIN_US), 1250);
+
+		interval_min = MAX(interval_min, spread_min);
+		interval_max = MAX(interval_max, interval_min + (params->interval_max - params->interval_min));
+	}
+	*param = (struct bt_le_conn_param)BT_LE_CONN_PARAM_INIT(interval_min, interval_max, params->latency,
+							       params->timeout);
+	// The supervision timeout must cover at least two intervals with the latency applied
+	param->timeout = MAX(param->timeout, DIV_ROUND_UP((1 + param->latency) * interval_max * 1250 * 2, 10000) + 1);
+}
+
+static void conn_params_request(struct conn_state *state)
+{
+	struct bt_le_conn_param param;
+	int err;
+
+	conn_params_get(&param);
+	state->update_pending = false;
+	state->last_update_ms = k_uptime_get();
+
+	err = bt_conn_le_param_update(state->conn, &param);
+	if (err == -EALREADY) {
+		// Already in range
+		return;
+	}
+	if (err) {
+		LOG_WRN("Connection parameter update failed (err %d)", err);
+		return;
+	}
+	m_status.updates_requested++;
+	LOG_INF("Conn %u: requesting %s parameters for ESB %s and %u connections: interval %u-%u us, latency %u",
+		state->handle, m_profiles[m_profile].name, m_esb_busy ? "busy" : "idle", m_status.conn_count,
+		param.interval_min * 1250, param.interval_max * 1250, param.latency);
+}
+
+/* Renegotiate all the connections, for instance when the ESB demand or the number of connections changes */
+static void conn_params_update_all(void)
+{
+	for (int i = 0; i < CONFIG_BT_MAX_CONN; i++) {
+		if (m_conns[i].conn != NULL) {
+			m_conns[i].update_pending = true;
+		}
+	}
+}
+
+/* Measure the ESB share of the radio time since the last sample. The first sample after connecting only sets the
+ * baseline, so the share is never averaged over the time without a connection.
+ */
+static void share_work_handler(struct k_work *work)
+{
+	app_esb_radio_time_t time;
+	uint32_t total_ms;
+
+	if (app_esb_radio_time_get(&time) != 0) {
+		m_status.esb_permille = 0;
+		m_last_radio_time_valid = false;
+		return;
+	}
+	total_ms = time.total_ms - m_last_radio_time.total_ms;
+	if (m_last_radio_time_valid && total_ms > 0) {
+		m_status.esb_permille = ((time.esb_ms - m_last_radio_time.esb_ms) * 1000) / total_ms;
+	}
+	m_last_radio_time = time;
+	m_last_radio_time_valid = true;
+
+	k_work_schedule(&m_share_work, K_MSEC(ESB_SHARE_INTERVAL_MS));
+}
+
+static void check_work_handler(struct k_work *work)
+{
+	uint32_t backlog = app_esb_tx_backlog_get();
+	bool busy = m_esb_busy;
+	int64_t now = k_uptime_get();
+
+	if (m_status.conn_count == 0) {
+		return;
+	}
+
+	if (backlog >= ESB_BUSY_BACKLOG) {
+		busy = true;
+		m_idle_checks = 0;
+	} else if (backlog == 0) {
+		if (++m_idle_checks >= ESB_IDLE_CHECKS) {
+			busy = false;
+		}
+	} else {
+		m_idle_checks = 0;
+	}
+
+	if (busy != m_esb_busy) {
+		m_esb_busy = busy;
+		m_status.esb_busy = busy;
+		conn_params_update_all();
+	}
+	for (int i = 0; i < CONFIG_BT_MAX_CONN; i++) {
+		struct conn_state *state = &m_conns[i];
+
+		if (state->conn != NULL && state->update_pending &&
+		    (now - state->last_update_ms) >= UPDATE_HOLDOFF_MS) {
+			conn_params_request(state);
+		}
+	}
+
+	k_work_schedule(&m_check_work, K_MSEC(DEMAND_CHECK_INTERVAL_MS));
+}
+
+/* Connection event reports from the SoftDevice Controller, used for the airtime accounting */
+static bool vs_event_handler(struct net_buf_simple *buf)
+{
+	const sdc_hci_subevent_vs_qos_conn_event_report_t *report;
+	struct conn_state *state = NULL;
+	app_bt_conn_status_t *conn_status = NULL;
+	struct bt_conn_info info;
+	uint32_t packet_us;
+	uint32_t missed = 0;
+	bool phy_2m;
+	uint8_t code;
+
+	if (buf->len < 1 + sizeof(*report)) {
+		return false;
+	}
+	code = net_buf_simple_pull_u8(buf);
+	if (code != SDC_HCI_SUBEVENT_VS_QOS_CONN_EVENT_REPORT) {
+		return false;
+	}
+	report = (const void *)buf->data;
+
+	for (int i = 0; i < CONFIG_BT_MAX_CONN; i++) {
+		if (m_conns[i].conn != NULL && m_conns[i].handle == report->conn_handle) {
+			state = &m_conns[i];
+			conn_status = &m_status.conns[i];
+			if (bt_conn_get_info(m_conns[i].conn, &info) != 0) {
+				return true;
+			}
+			break;
+		}
+	}
+	if (conn_status == NULL) {
+		return true;
+	}
+
+	// Preamble, access address, header, payload, MIC and CRC, plus the inter frame space
+	phy_2m = (info.le.phy->tx_phy == BT_GAP_LE_PHY_2M);
+	packet_us = ((phy_2m ? 2 : 1) + 4 + 2 + info.le.data_len->tx_max_len + 4 + 3) * (phy_2m ? 4 : 8) + 150;
+
+	// Reports only come for the events that took place. Peripheral latency allows skipping up to latency events
+	// in a row, anything beyond that was lost to other radio activity, like ESB timeslots.
+	if (state->event_counter_valid) {
+		uint16_t gap = report->event_counter - state->event_counter - 1;
+
+		missed = (gap > conn_status->latency) ? gap - conn_status->latency : 0;
+	}
+	state->event_counter = report->event_counter;
+	state->event_counter_valid = true;
+#if !defined(CONFIG_SOC_NRF5340_CPUAPP)
+	// On the nRF5340 the timeslot handler runs on the network core, and only the connection status has the count
+	timeslot_handler_ble_events_report(1 + missed, missed);
+#endif
+
+	conn_status->events++;
+	conn_status->events_missed += missed;
+	conn_status->tx_packets += report->tx_packet_count;
+	conn_status->rx_packets += report->rx_packet_count;
+	conn_status->crc_errors += report->rx_crc_error_count;
+	conn_status->airtime_us += (report->tx_packet_count + report->rx_packet_count) * packet_us;
+	return true;
+}
+
+static int conn_event_reports_enable(void)
+{
+	sdc_hci_cmd_vs_qos_conn_event_report_enable_t *cmd;
+	struct net_buf *buf;
+	int err;
+
+	err = bt_hci_register_vnd_evt_cb(vs_event_handler);
+	if (err) {
+		return err;
+	}
+
+	buf = bt_hci_cmd_create(SDC_HCI_OPCODE_CMD_VS_QOS_CONN_EVENT_REPORT_ENABLE, sizeof(*cmd));
+	if (buf == NULL) {
+		return -ENOBUFS;
+	}
+	cmd = net_buf_add(buf, sizeof(*cmd));
+	cmd->enable = 1;
+
+	return bt_hci_cmd_send_sync(SDC_HCI_OPCODE_CMD_VS_QOS_CONN_EVENT_REPORT_ENABLE, buf, NULL);
+}
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+	struct conn_state *state;
+	app_bt_conn_status_t *conn_status;
+	struct bt_conn_info info;
+
+	if (err || bt_conn_get_info(conn, &info) != 0 || info.role != BT_CONN_ROLE_PERIPHERAL) {
+		return;
+	}
+	state = conn_state_get(NULL);
+	if (state == NULL) {
+		return;
+	}
+	state->conn = bt_conn_ref(conn);
+	state->event_counter_valid = false;
+	bt_hci_get_conn_handle(conn, &state->handle);
+
+	conn_status = &m_status.conns[state - m_conns];
+	*conn_status = (app_bt_conn_status_t){
+		.connected = true,
+		.interval_us = info.le.interval * 1250,
+		.latency = info.le.latency,
+		.timeout_ms = info.le.timeout * 10,
+	};
+	m_status.conn_count++;
+	ble_share_update();
+	LOG_INF("Conn %u: connected with interval %u us, latency %u, %u connections", state->handle,
+		conn_status->interval_us, conn_status->latency, m_status.conn_count);
+
+	// The other connections need longer intervals now. The new one is asked once it is up and running.
+	conn_params_update_all();
+	state->last_update_ms = k_uptime_get() - UPDATE_HOLDOFF_MS + FIRST_UPDATE_DELAY_MS;
+	m_idle_checks = 0;
+	k_work_schedule(&m_check_work, K_MSEC(DEMAND_CHECK_INTERVAL_MS));
+	if (m_status.conn_count == 1) {
+		m_last_radio_time_valid = false;
+		m_status.esb_permille = 0;
+		k_work_schedule(&m_share_work, K_NO_WAIT);
+	}
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	struct conn_state *state = conn_state_get(conn);
+
+	if (state == NULL) {
+		return;
+	}
+	LOG_INF("Conn %u: disconnected (reason %u), %u connection events, %u missed", state->handle, reason,
+		m_status.conns[state - m_conns].events, m_status.conns[state - m_conns].events_missed);
+	bt_conn_unref(state->conn);
+	state->conn = NULL;
+	state->update_pending = false;
+	m_status.conns[state - m_conns].connected = false;
+	m_status.conn_count--;
+	ble_share_update();
+
+	if (m_status.conn_count == 0) {
+		k_work_cancel_delayable(&m_check_work);
+		k_work_cancel_delayable(&m_share_work);
+	} else {
+		// The remaining connections can go back to shorter intervals
+		conn_params_update_all();
+	}
+}
+
+static void le_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency, uint16_t timeout)
+{
+	struct conn_state *state = conn_state_get(conn);
+	app_bt_conn_status_t *conn_status;
+
+	if (state == NULL) {
+		return;
+	}
+	conn_status = &m_status.conns[state - m_conns];
+	conn_status->interval_us = interval * 1250;
+	conn_status->latency = latency;
+	conn_status->timeout_ms = timeout * 10;
+	m_status.updates_applied++;
+	ble_share_update();
+
+	LOG_INF("Conn %u: interval %u us, latency %u, BLE up to %u.%u%% (all connections %u.%u%%), "
+		"ESB %u.%u%% of the radio time", state->handle, conn_status->interval_us, latency,
+		conn_status->ble_permille / 10, conn_status->ble_permille % 10,
+		m_status.ble_permille / 10, m_status.ble_permille % 10,
+		m_status.esb_permille / 10, m_status.esb_permille % 10);
+}
+
+BT_CONN_CB_DEFINE(conn_params_callbacks) = {
+	.connected = connected,
+	.disconnected = disconnected,
+	.le_param_updated = le_param_updated,
+};
+
+int app_bt_conn_params_profile_set(app_bt_conn_profile_t profile)
+{
+	int err;
+
+	if (profile >= APP_BT_CONN_PROFILE_COUNT) {
+		return -EINVAL;
+	}
+
+	err = event_length_set(m_profiles[profile].event_length_us);
+	if (err) {
+		return err;
+	}
+	m_profile = profile;
+	m_status.profile = profile;
+	m_status.event_length_us = m_profiles[profile].event_length_us;
+	ble_share_update();
+	LOG_INF("Connection parameter profile: %s", m_profiles[profile].name);
+
+	for (int i = 0; i < CONFIG_BT_MAX_CONN; i++) {
+		if (m_conns[i].conn != NULL) {
+			conn_params_request(&m_conns[i]);
+		}
+	}
+	return 0;
+}
+
+int app_bt_conn_params_init(app_bt_conn_profile_t profile)
+{
+	int err;
+
+	if (IS_ENABLED(CONFIG_APP_BT_CONN_EVENT_REPORTS)) {
+		err = conn_event_reports_enable();
+		if (err) {
+			// Only the airtime accounting is lost
+			LOG_WRN("Connection event reports not available (err %d)", err);
+		}
+	}
+	return app_bt_conn_params_profile_set(profile);
+}
+
+void app_bt_conn_params_status_get(app_bt_conn_params_status_t *status)
+{
+	*status = m_status;
+}
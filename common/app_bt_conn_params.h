@@ -0,0 +1,71 @@
+#ifndef __APP_BT_CONN_PARAMS_H
+#define __APP_BT_CONN_PARAMS_H
+
+#include <zephyr/kernel.h>
+
+/* Connection parameters chosen to share the radio between BLE and ESB.
+ *
+ * The timeslots used by ESB can only be placed between BLE connection events, so a central that picks a short
+ * connection interval leaves little room for ESB. The peripheral requests its own connection interval, latency
+ * and supervision timeout shortly after connecting, from the selected profile, and limits the length of the
+ * connection events through the controller.
+ *
+ * Each profile has one set of parameters for when ESB is idle and one for when ESB has TX payloads backing up,
+ * and the peripheral negotiates again when the ESB demand changes. The event length only applies to connections
+ * made after it is set, so a profile change is only fully in effect from the next connection.
+ *
+ * Up to CONFIG_BT_MAX_CONN centrals can be connected at the same time. The anchor points of the connections are
+ * picked by the centrals and drift relative to each other, so the peripheral can't line them up. Instead the
+ * interval of every connection is stretched with the number of connections, to at least
+ * connections * (event length + ESB_SLOT_MIN_US). However the connection events end up placed, the gaps between
+ * them then add up to room for one ESB timeslot per connection, and the longest gap always fits one.
+ */
+
+typedef enum {
+	APP_BT_CONN_PROFILE_ESB_THROUGHPUT,	// Long intervals and short events, most of the radio time goes to ESB
+	APP_BT_CONN_PROFILE_BALANCED,
+	APP_BT_CONN_PROFILE_BLE_LATENCY,		// Short intervals, ESB gets what is left between the events
+	APP_BT_CONN_PROFILE_COUNT
+} app_bt_conn_profile_t;
+
+#define APP_BT_CONN_PROFILE_DEFAULT	APP_BT_CONN_PROFILE_BALANCED
+
+typedef struct {
+	bool connected;
+	// Parameters in use on the connection
+	uint32_t interval_us;
+	uint16_t latency;
+	uint16_t timeout_ms;
+	// Most of the radio time the connection events can take
+	uint16_t ble_permille;
+	// Airtime accounting, from the connection event reports of the controller, with CONFIG_APP_BT_CONN_EVENT_REPORTS
+	uint32_t events;
+	uint32_t events_missed;			// Events that didn't take place, beyond those skipped through peripheral latency
+	uint32_t tx_packets;
+	uint32_t rx_packets;
+	uint32_t crc_errors;
+	uint64_t airtime_us;			// Estimated, counting every packet at the full data length of the link
+} app_bt_conn_status_t;
+
+typedef struct {
+	app_bt_conn_profile_t profile;
+	bool esb_busy;					// ESB demand as seen by the last check
+	uint32_t event_length_us;		// Requested limit of the connection event length
+	uint32_t conn_count;
+	// Radio time split. BLE is the most all the connection events can use, ESB is measured by the timeslot analytics.
+	uint16_t ble_permille;
+	uint16_t esb_permille;			// Over the last 2 s measurement while connected, 0 if not available
+	uint32_t updates_requested;
+	uint32_t updates_applied;
+	app_bt_conn_status_t conns[CONFIG_BT_MAX_CONN];
+} app_bt_conn_params_status_t;
+
+/* Must be called after bt_enable() */
+int app_bt_conn_params_init(app_bt_conn_profile_t profile);
+
+/* Select a different profile. The connections, if any, are updated right away. */
+int app_bt_conn_params_profile_set(app_bt_conn_profile_t profile);
+
+void app_bt_conn_params_status_get(app_bt_conn_params_status_t *status);
+
+#endif
@@ -1,4 +1,6 @@
 #include "app_bt_lbs.h"
+#include "app_bt_conn_params.h"
+#include "app_bt_adv.h"
 
 
 #include <zephyr/bluetooth/bluetooth.h>
@@ -26,6 +28,19 @@
 
 static bool app_button_state;
 
+struct conn_slot {
+	struct bt_conn *conn;
+	bool setup_pending;
+	struct bt_gatt_exchange_params mtu_exchange_params;
+};
+
+static struct conn_slot m_conns[CONFIG_BT_MAX_CONN];
+static uint32_t m_conn_count;
+
+static void conn_setup_work_handler(struct k_work *work);
+
+static K_WORK_DEFINE(m_conn_setup_work, conn_setup_work_handler);
+
 static const struct bt_data ad[] = {
 	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
 	BT_DATA(BT_DATA_NAME_COMPLETE, DEVICE_NAME, DEVICE_NAME_LEN),
@@ -35,23 +50,137 @@ static const struct bt_data sd[] = {
 	BT_DATA_BYTES(BT_DATA_UUID128_ALL, BT_UUID_LBS_VAL),
 };
 
+/* Time on air per payload byte of a connection event carrying one full data packet and an empty
+ * acknowledgment, including the two inter frame spaces. Packets are preamble, access address, header,
+ * payload and CRC, sent at 8 us per byte on the 1M PHY and 4 us per byte on the 2M PHY.
+ */
+static uint32_t airtime_ns_per_byte(uint8_t phy, uint16_t payload_len)
+{
+	uint32_t preamble = (phy == BT_GAP_LE_PHY_2M) ? 2 : 1;
+	uint32_t ns_per_byte = (phy == BT_GAP_LE_PHY_2M) ? 4000 : 8000;
+	uint32_t data_ns = (preamble + 4 + 2 + payload_len + 3) * ns_per_byte;
+	uint32_t ack_ns = (preamble + 4 + 2 + 3) * ns_per_byte;
+
+	return (data_ns + ack_ns + 2 * 150000) / MAX(payload_len, 1);
+}
+
+static void conn_params_log(struct bt_conn *conn)
+{
+	struct bt_conn_info info;
+	uint32_t airtime_ns;
+
+	if (bt_conn_get_info(conn, &info) != 0) {
+		return;
+	}
+	airtime_ns = airtime_ns_per_byte(info.le.phy->tx_phy, info.le.data_len->tx_max_len);
+	printk("Connection: %s PHY, LL payload TX %u RX %u bytes, ATT MTU %u, %u.%02u us airtime per byte\n",
+	       (info.le.phy->tx_phy == BT_GAP_LE_PHY_2M) ? "2M" : "1M", info.le.data_len->tx_max_len,
+	       info.le.data_len->rx_max_len, bt_gatt_get_mtu(conn), airtime_ns / 1000, (airtime_ns % 1000) / 10);
+}
+
+static void mtu_exchanged(struct bt_conn *conn, uint8_t err, struct bt_gatt_exchange_params *params)
+{
+	if (err) {
+		printk("MTU exchange failed (err %u)\n", err);
+		return;
+	}
+	conn_params_log(conn);
+}
+
+/* Ask for the fastest link the central supports, so BLE data takes as little radio time as possible
+ * and more is left for the ESB timeslots. The connection event length is capped by app_bt_conn_params.c.
+ */
+static void conn_setup_work_handler(struct k_work *work)
+{
+	struct conn_slot *slot;
+	int err;
+
+	for (int i = 0; i < CONFIG_BT_MAX_CONN; i++) {
+		slot = &m_conns[i];
+		if (slot->conn == NULL || !slot->setup_pending) {
+			continue;
+		}
+		slot->setup_pending = false;
+
+		err = bt_conn_le_phy_update(slot->conn, BT_CONN_LE_PHY_PARAM_2M);
+		if (err) {
+			printk("PHY update failed (err %d)\n", err);
+		}
+
+		err = bt_conn_le_data_len_update(slot->conn, BT_LE_DATA_LEN_PARAM_MAX);
+		if (err) {
+			printk("Data length update failed (err %d)\n", err);
+		}
+
+		slot->mtu_exchange_params.func = mtu_exchanged;
+		err = bt_gatt_exchange_mtu(slot->conn, &slot->mtu_exchange_params);
+		if (err) {
+			printk("MTU exchange failed (err %d)\n", err);
+		}
+	}
+}
+
+static struct conn_slot *conn_slot_get(struct bt_conn *conn)
+{
+	for (int i = 0; i < CONFIG_BT_MAX_CONN; i++) {
+		if (m_conns[i].conn == conn) {
+			return &m_conns[i];
+		}
+	}
+	return NULL;
+}
+
 static void connected(struct bt_conn *conn, uint8_t err)
 {
+	struct conn_slot *slot;
+
 	if (err) {
 		printk("Connection failed (err %u)\n", err);
 		return;
 	}
 
-	printk("Connected\n");
+	slot = conn_slot_get(NULL);
+	if (slot == NULL) {
+		return;
+	}
+	slot->conn = bt_conn_ref(conn);
+	slot->setup_pending = true;
+	m_conn_count++;
+
+	printk("Connected (%u of %u)\n", m_conn_count, CONFIG_BT_MAX_CONN);
 
 	dk_set_led_on(CON_STATUS_LED);
+
+	k_work_submit(&m_conn_setup_work);
 }
 
 static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
+	struct conn_slot *slot = conn_slot_get(conn);
+
 	printk("Disconnected (reason %u)\n", reason);
 
-	dk_set_led_off(CON_STATUS_LED);
+	if (slot == NULL) {
+		return;
+	}
+	bt_conn_unref(slot->conn);
+	slot->conn = NULL;
+	slot->setup_pending = false;
+	m_conn_count--;
+
+	if (m_conn_count == 0) {
+		dk_set_led_off(CON_STATUS_LED);
+	}
+}
+
+static void le_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
+{
+	conn_params_log(conn);
+}
+
+static void le_data_len_updated(struct bt_conn *conn, struct bt_conn_le_data_len_info *info)
+{
+	conn_params_log(conn);
 }
 
 #ifdef CONFIG_BT_LBS_SECURITY_ENABLED
@@ -74,6 +203,8 @@ static void security_changed(struct bt_conn *conn, bt_security_t level,
 BT_CONN_CB_DEFINE(conn_callbacks) = {
 	.connected        = connected,
 	.disconnected     = disconnected,
+	.le_phy_updated   = le_phy_updated,
+	.le_data_len_updated = le_data_len_updated,
 #ifdef CONFIG_BT_LBS_SECURITY_ENABLED
 	.security_changed = security_changed,
 #endif
@@ -199,6 +330,13 @@ int app_bt_init(void)
 
 	printk("Bluetooth initialized\n");
 
+	// Ask centrals for connection parameters that leave room for ESB
+	err = app_bt_conn_params_init(APP_BT_CONN_PROFILE_DEFAULT);
+	if (err) {
+		printk("Connection parameter init failed (err %d)\n", err);
+		return err;
+	}
+
 	if (IS_ENABLED(CONFIG_SETTINGS)) {
 		settings_load();
 	}
@@ -209,7 +347,8 @@ int app_bt_init(void)
 		return err;
 	}
 
-	err = bt_le_adv_start(BT_LE_ADV_CONN, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+	// Advertising is adapted to the connection state and the ESB load by the governor in app_bt_adv.c
+	err = app_bt_adv_start(ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
 	if (err) {
 		printk("Advertising failed to start (err %d)\n", err);
 		return err;
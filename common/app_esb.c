@@ -1,5 +1,8 @@
 #include "app_esb.h"
 #include "timeslot_handler.h"
+#include "timeslot_analytics.h"
+#include "esb_bench.h"
+#include "esb_trace.h"
 #include <zephyr/drivers/clock_control.h>
 #include <zephyr/drivers/clock_control/nrf_clock_control.h>
 #include <esb.h>
@@ -11,28 +14,119 @@ static app_esb_callback_t m_callback;
 
 static app_esb_event_t 	  m_event;
 
+#define ESB_BITRATE				ESB_BITRATE_2MBPS
+#define ESB_RETRANSMIT_DELAY_US	600
+#define ESB_RETRANSMIT_COUNT	1
+
+// Airtime model parameters, used to check that a transaction can complete before the timeslot ends
+#define RADIO_RAMP_UP_US		140
+#define ESB_ADDR_LENGTH			5
+#define ESB_CRC_LENGTH			2
+#define ESB_PCF_BITS			9
+#define TX_ADMISSION_MARGIN_US	100
+
+/* HF clock policy, selected with CONFIG_APP_ESB_HFCLK_POLICY
+ * ALWAYS_ON: The HF crystal oscillator is started at init and never released. Lowest latency, highest idle current.
+ * PER_SLOT:  MPSL guarantees that the HF crystal oscillator is running for every timeslot, and stops it in between.
+ * ON_DEMAND: The HF crystal oscillator is started when TX packets are queued, and released when the queue is empty.
+ *            In PRX mode the radio is listening in every timeslot, so PER_SLOT is used instead.
+ */
+#define HFCLK_POLICY_ALWAYS_ON	0
+#define HFCLK_POLICY_PER_SLOT	1
+#define HFCLK_POLICY_ON_DEMAND	2
+
+#if defined(CONFIG_APP_ESB_HFCLK_POLICY_ON_DEMAND)
+#define HFCLK_POLICY			HFCLK_POLICY_ON_DEMAND
+#elif defined(CONFIG_APP_ESB_HFCLK_POLICY_PER_SLOT)
+#define HFCLK_POLICY			HFCLK_POLICY_PER_SLOT
+#else
+#define HFCLK_POLICY			HFCLK_POLICY_ALWAYS_ON
+#endif
+
+#if defined(CONFIG_MPSL_HFCLK_LATENCY)
+#define HFXO_RAMP_UP_US			CONFIG_MPSL_HFCLK_LATENCY
+#else
+#define HFXO_RAMP_UP_US			1400
+#endif
+
+// TX queue item, time stamped so the timeslot handler can escalate when packets get old
+struct app_esb_tx_item {
+	struct esb_payload payload;
+	uint32_t enqueued_cyc;
+};
+
 // Define a buffer of payloads (8 items by default) to store TX payloads in between timeslots
-K_MSGQ_DEFINE(m_msgq_tx_payloads, sizeof(struct esb_payload), 8, 4);
+K_MSGQ_DEFINE(m_msgq_tx_payloads, sizeof(struct app_esb_tx_item), APP_ESB_TX_QUEUE_SIZE, 4);
 
 static struct esb_payload rx_payload;
 
 static app_esb_mode_t m_mode;
 static bool m_active = false;
+static volatile bool m_tx_in_progress = false;
+
+static app_esb_stats_t m_stats;
+
+static int m_hfclk_policy;
+static struct onoff_manager *m_clk_mgr;
+static struct onoff_client m_clk_cli;
+static volatile bool m_hfxo_requested;
+static volatile bool m_hfxo_running;
+static uint32_t m_hfxo_on_cyc;
+static uint32_t m_hfxo_request_cyc;
 
 static int pull_packet_from_tx_msgq(void);
+static void hfxo_release_work_handler(struct k_work *work);
+
+static K_WORK_DEFINE(m_hfxo_release_work, hfxo_release_work_handler);
+
+static void on_timeslot_start(void);
+static void on_timeslot_stop(void);
+static void on_timeslot_extended(void);
+
+// Declare the RADIO IRQ handler to supress warning
+void RADIO_IRQHandler(void);
+
+static struct timeslot_client m_ts_client = {
+	.name = "esb",
+	.priority = 0,
+	.weight = 1,
+	.on_start = on_timeslot_start,
+	.on_stop = on_timeslot_stop,
+	// The RADIO signal from MPSL has to be forwarded manually to the ESB radio handler
+	.on_radio_irq = RADIO_IRQHandler,
+	.on_extended = on_timeslot_extended,
+};
+
+/* Let the timeslot handler know how full the TX queue is, and how long the oldest packet has waited */
+static void tx_backlog_report(void)
+{
+	struct app_esb_tx_item oldest;
+	uint32_t queued = k_msgq_num_used_get(&m_msgq_tx_payloads);
 
-static void on_timeslot_start_stop(timeslot_callback_type_t type);
+	if (queued == 0 || k_msgq_peek(&m_msgq_tx_payloads, &oldest) != 0) {
+		timeslot_handler_backlog_update(&m_ts_client, 0, APP_ESB_TX_QUEUE_SIZE, 0);
+		return;
+	}
+	timeslot_handler_backlog_update(&m_ts_client, queued, APP_ESB_TX_QUEUE_SIZE, oldest.enqueued_cyc);
+}
 
 static void event_handler(struct esb_evt const *event)
 {
-	static struct esb_payload tmp_payload;
+	static struct app_esb_tx_item tmp_item;
 	switch (event->evt_id) {
 		case ESB_EVENT_TX_SUCCESS:
 			LOG_DBG("TX SUCCESS EVENT");
+			m_tx_in_progress = false;
 
 			// Remove the oldest item in the TX queue
-			k_msgq_get(&m_msgq_tx_payloads, &tmp_payload, K_NO_WAIT);
-			
+			k_msgq_get(&m_msgq_tx_payloads, &tmp_item, K_NO_WAIT);
+			esb_bench_stamp(ESB_BENCH_TX_RADIO_DONE, tmp_item.payload.data, tmp_item.payload.length);
+			tx_backlog_report();
+			if (m_hfclk_policy == HFCLK_POLICY_ON_DEMAND && k_msgq_num_used_get(&m_msgq_tx_payloads) == 0) {
+				// The clock is released through the onoff manager, which is not done from the radio interrupt
+				k_work_submit(&m_hfxo_release_work);
+			}
+
 			// Forward an event to the application 
 			m_event.evt_type = APP_ESB_EVT_TX_SUCCESS;
 			m_event.data_length = 0;
@@ -46,6 +140,7 @@ static void event_handler(struct esb_evt const *event)
 
 		case ESB_EVENT_TX_FAILED:
 			LOG_DBG("TX FAILED EVENT");
+			m_tx_in_progress = false;
 
 			// Ignore this event for now, since the payload is retained in the queue and will be retransmitted at a later point
 			
@@ -64,6 +159,7 @@ static void event_handler(struct esb_evt const *event)
 		case ESB_EVENT_RX_RECEIVED:
 			while (esb_read_rx_payload(&rx_payload) == 0) {
 				LOG_DBG("Packet received, len %d : ", rx_payload.length);
+				esb_bench_stamp(ESB_BENCH_RX_RADIO, rx_payload.data, rx_payload.length);
 
 				m_event.evt_type = APP_ESB_EVT_RX;
 				m_event.buf = rx_payload.data;
@@ -74,6 +170,93 @@ static void event_handler(struct esb_evt const *event)
 	}
 }
 
+static void hfxo_on_time_update(void)
+{
+	uint32_t now = k_cycle_get_32();
+
+	if (m_hfxo_running) {
+		m_stats.hfxo_on_us += k_cyc_to_us_floor32(now - m_hfxo_on_cyc);
+	}
+	m_hfxo_on_cyc = now;
+}
+
+static void hfxo_started_callback(struct onoff_manager *mgr, struct onoff_client *cli, uint32_t state, int res)
+{
+	uint32_t irq_key;
+
+	if (res < 0) {
+		LOG_ERR("HF clock could not be started: %d", res);
+		return;
+	}
+
+	irq_key = irq_lock();
+	m_hfxo_on_cyc = k_cycle_get_32();
+	m_hfxo_running = true;
+	m_stats.hfxo_starts++;
+	// The radio is usable now, start any packets that were held back waiting for the clock
+	if (m_active && m_mode == APP_ESB_MODE_PTX) {
+		pull_packet_from_tx_msgq();
+	}
+	irq_unlock(irq_key);
+}
+
+/* Start the HF crystal oscillator without waiting for it, used by the ON_DEMAND policy */
+static void hfxo_request(void)
+{
+	int err;
+
+	if (m_hfxo_requested) {
+		return;
+	}
+	m_hfxo_requested = true;
+	m_hfxo_request_cyc = k_cycle_get_32();
+
+	sys_notify_init_callback(&m_clk_cli.notify, hfxo_started_callback);
+	err = onoff_request(m_clk_mgr, &m_clk_cli);
+	if (err < 0) {
+		LOG_ERR("Clock request failed: %d", err);
+		m_hfxo_requested = false;
+	}
+}
+
+static void hfxo_release(void)
+{
+	if (!m_hfxo_requested) {
+		return;
+	}
+
+	hfxo_on_time_update();
+	m_hfxo_running = false;
+	m_hfxo_requested = false;
+	onoff_cancel_or_release(m_clk_mgr, &m_clk_cli);
+}
+
+static void hfxo_release_work_handler(struct k_work *work)
+{
+	uint32_t irq_key = irq_lock();
+
+	// A packet may have been queued since the work was submitted, in which case the clock is still needed
+	if (k_msgq_num_used_get(&m_msgq_tx_payloads) == 0) {
+		hfxo_release();
+	}
+	irq_unlock(irq_key);
+}
+
+/* Time until the HF crystal oscillator can be used by the radio, 0 if it is running */
+static uint32_t hfxo_wait_us(void)
+{
+	uint32_t elapsed_us;
+
+	if (m_hfclk_policy != HFCLK_POLICY_ON_DEMAND || m_hfxo_running) {
+		return 0;
+	}
+	if (!m_hfxo_requested) {
+		return HFXO_RAMP_UP_US;
+	}
+	elapsed_us = k_cyc_to_us_floor32(k_cycle_get_32() - m_hfxo_request_cyc);
+	return (elapsed_us < HFXO_RAMP_UP_US) ? (HFXO_RAMP_UP_US - elapsed_us) : 0;
+}
+
 static int clocks_start(void)
 {
 	int err;
@@ -121,9 +304,9 @@ static int esb_initialize(app_esb_mode_t mode)
 	struct esb_config config = ESB_DEFAULT_CONFIG;
 
 	config.protocol = ESB_PROTOCOL_ESB_DPL;
-	config.retransmit_delay = 600;
-	config.retransmit_count = 1;
-	config.bitrate = ESB_BITRATE_2MBPS;
+	config.retransmit_delay = ESB_RETRANSMIT_DELAY_US;
+	config.retransmit_count = ESB_RETRANSMIT_COUNT;
+	config.bitrate = ESB_BITRATE;
 	config.event_handler = event_handler;
 	config.mode = (mode == APP_ESB_MODE_PTX) ? ESB_MODE_PTX : ESB_MODE_PRX;
 	config.tx_mode = ESB_TXMODE_MANUAL_START;
@@ -159,13 +342,60 @@ static int esb_initialize(app_esb_mode_t mode)
 	return 0;
 }
 
+/* On air time of a single ESB packet, in microseconds */
+static uint32_t esb_packet_airtime_us(uint32_t payload_length)
+{
+	uint32_t bits_per_ms;
+	uint32_t preamble_length;
+
+	switch (ESB_BITRATE) {
+		case ESB_BITRATE_1MBPS:
+			bits_per_ms = 1000;
+			preamble_length = 1;
+			break;
+		case ESB_BITRATE_2MBPS:
+		default:
+			bits_per_ms = 2000;
+			preamble_length = 2;
+			break;
+	}
+
+	uint32_t bits = (preamble_length + ESB_ADDR_LENGTH + payload_length + ESB_CRC_LENGTH) * 8 + ESB_PCF_BITS;
+	return DIV_ROUND_UP(bits * 1000, bits_per_ms);
+}
+
+/* Worst case time needed to complete a PTX transaction, including the ACK and all retransmits */
+static uint32_t esb_transaction_airtime_us(uint32_t payload_length)
+{
+	uint32_t attempt_us = RADIO_RAMP_UP_US + esb_packet_airtime_us(payload_length) +
+						  RADIO_RAMP_UP_US + esb_packet_airtime_us(0);
+
+	return attempt_us + ESB_RETRANSMIT_COUNT * MAX(attempt_us, ESB_RETRANSMIT_DELAY_US) + TX_ADMISSION_MARGIN_US;
+}
+
 static int pull_packet_from_tx_msgq(void)
 {
 	int ret;
-	static struct esb_payload tx_payload;
-	if (k_msgq_peek(&m_msgq_tx_payloads, &tx_payload) == 0) {
-		ret = esb_write_payload(&tx_payload);
+	static struct app_esb_tx_item tx_item;
+	if (m_tx_in_progress) {
+		return -EBUSY;
+	}
+	if (k_msgq_peek(&m_msgq_tx_payloads, &tx_item) == 0) {
+		// Don't start a transaction that can't complete before the radio is lost, wait for the next timeslot instead.
+		// While the HF crystal is starting up the transaction can't begin until it is running.
+		if (hfxo_wait_us() + esb_transaction_airtime_us(tx_item.payload.length) > timeslot_handler_remaining_us()) {
+			m_stats.tx_deferred++;
+			return -EAGAIN;
+		}
+
+		// Without the HF crystal running the radio can't be used yet. The HF clock callback will try again.
+		if (m_hfclk_policy == HFCLK_POLICY_ON_DEMAND && !m_hfxo_running) {
+			return -EAGAIN;
+		}
+
+		ret = esb_write_payload(&tx_item.payload);
 		if (ret < 0) return ret;
+		m_tx_in_progress = true;
 		esb_start_tx();		
 
 		return 0;
@@ -185,13 +415,39 @@ int app_esb_init(app_esb_mode_t mode, app_esb_callback_t callback)
 	NRF_P0->DIRSET = BIT(28) | BIT(29) | BIT(30) | BIT(31) | BIT(4);
 	NRF_P0->OUTCLR = BIT(28) | BIT(29) | BIT(30) | BIT(31);
 
-	ret = clocks_start();
-	if (ret < 0) {
-		return ret;
+	m_hfclk_policy = HFCLK_POLICY;
+	if (m_hfclk_policy == HFCLK_POLICY_ON_DEMAND && mode == APP_ESB_MODE_PRX) {
+		m_hfclk_policy = HFCLK_POLICY_PER_SLOT;
+	}
+
+	switch (m_hfclk_policy) {
+		case HFCLK_POLICY_ALWAYS_ON:
+			ret = clocks_start();
+			if (ret < 0) {
+				return ret;
+			}
+			m_hfxo_on_cyc = k_cycle_get_32();
+			m_hfxo_running = true;
+			m_stats.hfxo_starts++;
+			break;
+		case HFCLK_POLICY_PER_SLOT:
+			m_ts_client.hfxo_guaranteed = true;
+			break;
+		case HFCLK_POLICY_ON_DEMAND:
+			m_clk_mgr = z_nrf_clock_control_get_onoff(CLOCK_CONTROL_NRF_SUBSYS_HF);
+			if (!m_clk_mgr) {
+				LOG_ERR("Unable to get the Clock manager");
+				return -ENXIO;
+			}
+			break;
 	}
 	
+
 	LOG_INF("Timeslothandler init");
-	timeslot_handler_init(on_timeslot_start_stop);
+	ret = timeslot_handler_client_register(&m_ts_client);
+	if (ret < 0) {
+		return ret;
+	}
 
 	return 0;
 }
@@ -199,26 +455,70 @@ int app_esb_init(app_esb_mode_t mode, app_esb_callback_t callback)
 int app_esb_send(app_esb_data_t *tx_packet)
 {
 	int ret = 0;
-	static struct esb_payload tx_payload;
-	tx_payload.pipe = 0;
-	tx_payload.noack = false;
-	memcpy(tx_payload.data, tx_packet->data, tx_packet->len);
-	tx_payload.length = tx_packet->len;
-	ret = k_msgq_put(&m_msgq_tx_payloads, &tx_payload, K_NO_WAIT);
+	// On the stack, the function is called from several threads and the system workqueue
+	struct app_esb_tx_item tx_item;
+	tx_item.payload.pipe = 0;
+	tx_item.payload.noack = false;
+	memcpy(tx_item.payload.data, tx_packet->data, tx_packet->len);
+	tx_item.payload.length = tx_packet->len;
+	tx_item.enqueued_cyc = k_cycle_get_32();
+	ret = k_msgq_put(&m_msgq_tx_payloads, &tx_item, K_NO_WAIT);
 	if (ret == 0) {
+		esb_bench_stamp(ESB_BENCH_TX_QUEUED, tx_packet->data, tx_packet->len);
+		tx_backlog_report();
+		uint32_t irq_key = irq_lock();
+		if (m_hfclk_policy == HFCLK_POLICY_ON_DEMAND) {
+			hfxo_request();
+		}
 		if (m_active) {
 			pull_packet_from_tx_msgq();
 		}
+		irq_unlock(irq_key);
 	}
 	else {
-		return -ENOMEM;
+		ret = -ENOMEM;
 	}
+#if !defined(CONFIG_SOC_NRF5340_CPUNET)
+	// On the nRF5340 the application calls are captured on the application core
+	esb_trace_send(tx_packet->len, ret);
+#endif
+	return ret;
+}
+
+int app_esb_stats_get(app_esb_stats_t *stats)
+{
+	uint32_t irq_key = irq_lock();
+	if (m_hfclk_policy != HFCLK_POLICY_PER_SLOT) {
+		hfxo_on_time_update();
+	}
+	*stats = m_stats;
+	irq_unlock(irq_key);
+	return 0;
+}
+
+uint32_t app_esb_tx_backlog_get(void)
+{
+	return k_msgq_num_used_get(&m_msgq_tx_payloads);
+}
+
+int app_esb_radio_time_get(app_esb_radio_time_t *time)
+{
+	timeslot_analytics_t analytics;
+
+	timeslot_analytics_get(&analytics);
+	time->total_ms = (uint32_t)(analytics.total_us / 1000);
+	time->esb_ms = (uint32_t)(analytics.granted_us / 1000);
 	return 0;
 }
 
 static int app_esb_suspend(void)
 {
 	m_active = false;
+	if (m_tx_in_progress) {
+		// The transaction will be aborted, and the packet sent again in the next timeslot
+		m_stats.tx_aborted_slot_end++;
+		m_tx_in_progress = false;
+	}
 	NRF_P0->OUTSET = BIT(29);
 	if(m_mode == APP_ESB_MODE_PTX) {
 		uint32_t irq_key = irq_lock();
@@ -269,17 +569,34 @@ static int app_esb_resume(void)
 	}
 }
 
-/* Callback function signalling that a timeslot is started or stopped */
-static void on_timeslot_start_stop(timeslot_callback_type_t type)
+/* Callback functions signalling that ESB has been given the radio, or lost it */
+static void on_timeslot_start(void)
 {
-	switch (type) {
-		case APP_TS_STARTED:
-			NRF_P0->OUTSET = BIT(31);
-			app_esb_resume();
-			break;
-		case APP_TS_STOPPED:
-			NRF_P0->OUTCLR = BIT(31);
-			app_esb_suspend();
-			break;
+	NRF_P0->OUTSET = BIT(31);
+	if (m_hfclk_policy == HFCLK_POLICY_PER_SLOT) {
+		// MPSL started the HF crystal ahead of the timeslot, include the ramp up in the on time
+		m_hfxo_on_cyc = k_cycle_get_32();
+		m_hfxo_running = true;
+		m_stats.hfxo_starts++;
+		m_stats.hfxo_on_us += HFXO_RAMP_UP_US;
+	}
+	app_esb_resume();
+}
+
+static void on_timeslot_stop(void)
+{
+	NRF_P0->OUTCLR = BIT(31);
+	app_esb_suspend();
+	if (m_hfclk_policy == HFCLK_POLICY_PER_SLOT) {
+		hfxo_on_time_update();
+		m_hfxo_running = false;
+	}
+}
+
+/* The timeslot got longer, so a packet held back at the end of the timeslot might fit now */
+static void on_timeslot_extended(void)
+{
+	if (m_active && m_mode == APP_ESB_MODE_PTX) {
+		pull_packet_from_tx_msgq();
 	}
 }
@@ -3,6 +3,9 @@
 
 #include <zephyr/kernel.h>
 
+// Number of TX payloads that can be queued in app_esb while waiting for a timeslot
+#define APP_ESB_TX_QUEUE_SIZE 8
+
 typedef enum {APP_ESB_EVT_TX_SUCCESS, APP_ESB_EVT_TX_FAIL, APP_ESB_EVT_RX} app_esb_event_type_t;
 typedef enum {APP_ESB_MODE_PTX, APP_ESB_MODE_PRX} app_esb_mode_t;
 
@@ -21,6 +24,18 @@ typedef struct {
 	app_esb_mode_t mode;
 } app_esb_config_t;
 
+typedef struct {
+	uint32_t tx_deferred;			// TX transactions held back because they would not complete before the timeslot ends
+	uint32_t tx_aborted_slot_end;	// TX transactions cut off by the end of the timeslot, and sent again later
+	uint32_t hfxo_starts;			// Times the HF crystal oscillator was started for ESB
+	uint64_t hfxo_on_us;			// Time the HF crystal oscillator has been kept running for ESB
+} app_esb_stats_t;
+
+typedef struct {
+	uint32_t total_ms;				// Wall time covered by the timeslot analytics
+	uint32_t esb_ms;				// Time the radio was given to ESB, the rest was left to Bluetooth
+} app_esb_radio_time_t;
+
 typedef void (*app_esb_callback_t)(app_esb_event_t *event);
 
 struct esb_simple_addr {
@@ -33,4 +48,11 @@ int app_esb_init(app_esb_mode_t mode, app_esb_callback_t callback);
 
 int app_esb_send(app_esb_data_t *tx_packet);
 
+int app_esb_stats_get(app_esb_stats_t *stats);
+
+// Number of TX payloads accepted by app_esb_send() that have not been sent or failed yet
+uint32_t app_esb_tx_backlog_get(void);
+
+int app_esb_radio_time_get(app_esb_radio_time_t *time);
+
 #endif
\ No newline at end of file
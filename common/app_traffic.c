@@ -0,0 +1,634 @@
+#include "app_traffic.h"
+#include "esb_trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/sys/printk.h>
+
+#if defined(CONFIG_SHELL)
+#include <zephyr/shell/shell.h>
+#endif
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_traffic, LOG_LEVEL_INF);
+
+// Longest wait for a TX queue slot before app_esb_send() is tried again
+#define TX_RETRY_WAIT_MS		10
+// Time given to payloads still in flight at the end of a run
+#define TX_DRAIN_MS				500
+// Send times of the payloads in flight, indexed by completion order. Also limits the payloads in flight.
+#define TX_STAMP_RING_SIZE		64
+// Sequence numbers behind the highest one received that are checked for duplicates
+#define RX_WINDOW_SIZE			256
+// Offset added to the RX delays, so payloads a bit faster than the first one of the run still give a positive value
+#define RX_DELAY_BIAS_US		1000000
+
+#define TX_THREAD_STACK_SIZE	2048
+#define TX_THREAD_PRIORITY		7
+
+/* Latency samples. When the buffer is full every other sample is dropped and only every second new one is kept,
+ * so the samples stay spread evenly over runs of any length.
+ */
+struct samples {
+	uint32_t values[APP_TRAFFIC_SAMPLES];
+	uint32_t count;
+	uint32_t stride;
+	uint32_t skip;
+};
+
+static app_esb_mode_t m_mode;
+static uint8_t m_run;
+
+static app_traffic_tx_config_t m_tx_config;
+static uint32_t m_tx_replay_loops;
+static volatile bool m_tx_running;
+static volatile bool m_tx_stop;
+static atomic_t m_tx_in_flight;
+static uint32_t m_tx_acked;
+static uint32_t m_tx_failed;
+static uint32_t m_tx_bytes;
+static uint64_t m_tx_backlog_total;
+static uint32_t m_tx_stamps[TX_STAMP_RING_SIZE];
+static app_traffic_tx_summary_t m_tx_summary;
+static bool m_tx_summary_valid;
+static struct samples m_tx_samples;
+
+static struct {
+	bool active;
+	volatile bool summarizing;
+	uint8_t run;
+	uint32_t first_ms;
+	uint32_t last_ms;
+	uint32_t received;
+	uint32_t unique;
+	uint32_t bytes;
+	uint32_t highest;
+	uint32_t duplicates;
+	uint32_t reordered;
+	uint32_t window[RX_WINDOW_SIZE / 32];
+	int32_t delay_base;
+	uint32_t delay_min;
+} m_rx;
+static app_traffic_rx_summary_t m_rx_summary;
+static bool m_rx_summary_valid;
+static struct samples m_rx_samples;
+
+static K_SEM_DEFINE(m_tx_start_sem, 0, 1);
+static K_SEM_DEFINE(m_tx_sem, 0, 1);
+
+static void rx_idle_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(m_rx_idle_work, rx_idle_work_handler);
+
+static uint32_t now_us(void)
+{
+	return (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static void samples_reset(struct samples *samples)
+{
+	samples->count = 0;
+	samples->stride = 1;
+	samples->skip = 0;
+}
+
+static void samples_add(struct samples *samples, uint32_t value)
+{
+	if (++samples->skip < samples->stride) {
+		return;
+	}
+	samples->skip = 0;
+	if (samples->count == APP_TRAFFIC_SAMPLES) {
+		for (uint32_t i = 0; i < APP_TRAFFIC_SAMPLES / 2; i++) {
+			samples->values[i] = samples->values[2 * i];
+		}
+		samples->count = APP_TRAFFIC_SAMPLES / 2;
+		samples->stride *= 2;
+	}
+	samples->values[samples->count++] = value;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Sort the samples and get the percentiles, with offset subtracted from all of them */
+static void samples_percentiles(struct samples *samples, uint32_t offset, uint32_t *p50, uint32_t *p90,
+				uint32_t *p99, uint32_t *max)
+{
+	uint32_t count = samples->count;
+
+	if (count == 0) {
+		*p50 = *p90 = *p99 = *max = 0;
+		return;
+	}
+	qsort(samples->values, count, sizeof(uint32_t), compare_u32);
+	*p50 = samples->values[((count - 1) * 50) / 100] - offset;
+	*p90 = samples->values[((count - 1) * 90) / 100] - offset;
+	*p99 = samples->values[((count - 1) * 99) / 100] - offset;
+	*max = samples->values[count - 1] - offset;
+}
+
+static void tx_summary_print(const app_traffic_tx_summary_t *s)
+{
+	uint32_t elapsed_ms = MAX(s->elapsed_ms, 1);
+
+	if (s->replay) {
+		printk("TRAFFIC_TX run=%u mode=replay records=%u loops=%u late_max_us=%u ", s->run, s->records,
+		       m_tx_replay_loops, s->late_max_us);
+	} else {
+		printk("TRAFFIC_TX run=%u mode=synthetic size=%u rate_pps=%u burst_len=%u burst_gap_ms=%u ", s->run,
+		       m_tx_config.payload_len, m_tx_config.rate_pps, m_tx_config.burst_len, m_tx_config.burst_gap_ms);
+	}
+	printk("elapsed_ms=%u offered=%u rejected=%u sent=%u acked=%u failed=%u pps=%u kbps=%u backlog_avg=%u "
+	       "backlog_max=%u lat_p50_us=%u lat_p90_us=%u lat_p99_us=%u lat_max_us=%u\n",
+	       s->elapsed_ms, s->offered, s->rejected, s->offered - s->rejected, s->acked, s->failed,
+	       (uint32_t)(((uint64_t)s->acked * 1000) / elapsed_ms), (uint32_t)(((uint64_t)m_tx_bytes * 8) / elapsed_ms),
+	       s->backlog_avg, s->backlog_max, s->latency_p50_us, s->latency_p90_us, s->latency_p99_us,
+	       s->latency_max_us);
+}
+
+static void rx_summary_print(const app_traffic_rx_summary_t *s)
+{
+	uint32_t elapsed_ms = MAX(s->elapsed_ms, 1);
+
+	printk("TRAFFIC_RX run=%u elapsed_ms=%u received=%u bytes=%u expected=%u lost=%u duplicates=%u reordered=%u "
+	       "pps=%u kbps=%u lat_p50_us=%u lat_p90_us=%u lat_p99_us=%u lat_max_us=%u\n",
+	       s->run, s->elapsed_ms, s->received, s->bytes, s->expected, s->lost, s->duplicates, s->reordered,
+	       (uint32_t)(((uint64_t)s->received * 1000) / elapsed_ms), (uint32_t)(((uint64_t)s->bytes * 8) / elapsed_ms),
+	       s->latency_p50_us, s->latency_p90_us, s->latency_p99_us, s->latency_max_us);
+}
+
+static void tx_begin(app_esb_data_t *data, app_traffic_tx_summary_t *summary)
+{
+	for (uint32_t i = sizeof(app_traffic_hdr_t); i < sizeof(data->data); i++) {
+		data->data[i] = (uint8_t)i;
+	}
+	*summary = (app_traffic_tx_summary_t){.run = ++m_run};
+
+	m_tx_acked = 0;
+	m_tx_failed = 0;
+	m_tx_bytes = 0;
+	m_tx_backlog_total = 0;
+	atomic_set(&m_tx_in_flight, 0);
+	samples_reset(&m_tx_samples);
+	k_sem_reset(&m_tx_sem);
+}
+
+/* Send one payload with the header for seq. Returns the app_esb_send() error, -ENOMEM if the TX queue is full. */
+static int tx_send(app_esb_data_t *data, uint32_t seq, app_traffic_tx_summary_t *summary)
+{
+	app_traffic_hdr_t hdr = {.seq = seq, .magic = APP_TRAFFIC_MAGIC, .run = summary->run};
+	uint32_t backlog;
+	int err;
+
+	while (atomic_get(&m_tx_in_flight) >= TX_STAMP_RING_SIZE) {
+		k_sem_take(&m_tx_sem, K_MSEC(TX_RETRY_WAIT_MS));
+	}
+
+	hdr.timestamp_us = now_us();
+	memcpy(data->data, &hdr, sizeof(hdr));
+	m_tx_stamps[seq % TX_STAMP_RING_SIZE] = k_cycle_get_32();
+	// Counted before the send, the TX success can come before app_esb_send() returns
+	atomic_inc(&m_tx_in_flight);
+	summary->offered++;
+	err = app_esb_send(data);
+	if (err < 0) {
+		atomic_dec(&m_tx_in_flight);
+		if (err == -ENOMEM) {
+			summary->rejected++;
+		} else {
+			LOG_ERR("app_esb_send failed (err %d)", err);
+		}
+		return err;
+	}
+
+	backlog = app_esb_tx_backlog_get();
+	m_tx_backlog_total += backlog;
+	summary->backlog_max = MAX(summary->backlog_max, backlog);
+	return 0;
+}
+
+static void tx_end(app_traffic_tx_summary_t *summary, int64_t start_ms)
+{
+	uint32_t sent = summary->offered - summary->rejected;
+
+	summary->elapsed_ms = k_uptime_get() - start_ms;
+
+	for (int i = 0; i < TX_DRAIN_MS / TX_RETRY_WAIT_MS && atomic_get(&m_tx_in_flight) > 0; i++) {
+		k_sleep(K_MSEC(TX_RETRY_WAIT_MS));
+	}
+
+	summary->acked = m_tx_acked;
+	summary->failed = m_tx_failed;
+	summary->backlog_avg = sent ? (uint32_t)(m_tx_backlog_total / sent) : 0;
+	samples_percentiles(&m_tx_samples, 0, &summary->latency_p50_us, &summary->latency_p90_us,
+			    &summary->latency_p99_us, &summary->latency_max_us);
+	m_tx_summary = *summary;
+	m_tx_summary_valid = true;
+	tx_summary_print(&m_tx_summary);
+}
+
+static void tx_run(const app_traffic_tx_config_t *config)
+{
+	static app_esb_data_t data;
+	app_traffic_tx_summary_t summary;
+	int64_t start_ms = k_uptime_get();
+	int64_t sched_start_us;
+	uint32_t sched_seq = 0;
+	uint32_t seq = 0;
+	int err;
+
+	tx_begin(&data, &summary);
+	data.len = config->payload_len;
+	sched_start_us = k_ticks_to_us_floor64(k_uptime_ticks());
+
+	while (!m_tx_stop && k_uptime_get() - start_ms < config->duration_ms) {
+		err = tx_send(&data, seq, &summary);
+		if (err == -ENOMEM) {
+			// TX queue full, wait for a payload to complete
+			k_sem_take(&m_tx_sem, K_MSEC(TX_RETRY_WAIT_MS));
+			continue;
+		}
+		if (err < 0) {
+			break;
+		}
+		m_tx_bytes += data.len;
+		seq++;
+
+		if (config->burst_len > 0 && (seq % config->burst_len) == 0) {
+			k_sleep(K_MSEC(config->burst_gap_ms));
+			// The rate applies within the bursts
+			sched_start_us = k_ticks_to_us_floor64(k_uptime_ticks());
+			sched_seq = seq;
+		} else if (config->rate_pps > 0) {
+			int64_t next_us = sched_start_us + ((int64_t)(seq - sched_seq) * USEC_PER_SEC) / config->rate_pps;
+			int64_t now = k_ticks_to_us_floor64(k_uptime_ticks());
+
+			if (next_us > now) {
+				k_sleep(K_USEC(next_us - now));
+			}
+		}
+	}
+	tx_end(&summary, start_ms);
+}
+
+/* Replay the captured app_esb_send() calls with their recorded timing. Calls rejected because the TX queue is
+ * full are not retried, as the application that was traced didn't get its payload through either.
+ */
+static void replay_run(uint32_t loops)
+{
+	static app_esb_data_t data;
+	app_traffic_tx_summary_t summary;
+	esb_trace_record_t record;
+	uint32_t count = esb_trace_count(NULL);
+	int64_t start_ms = k_uptime_get();
+	int64_t due_us = k_ticks_to_us_floor64(k_uptime_ticks());
+	uint32_t seq = 0;
+	int err = 0;
+
+	tx_begin(&data, &summary);
+	summary.replay = true;
+
+	for (uint32_t loop = 0; loop < loops && !m_tx_stop && (err == 0 || err == -ENOMEM); loop++) {
+		for (uint32_t i = 0; i < count && !m_tx_stop; i++) {
+			int64_t now;
+
+			if (esb_trace_get(i, &record) != 0) {
+				break;
+			}
+			due_us += record.delta_us;
+			now = k_ticks_to_us_floor64(k_uptime_ticks());
+			if (due_us > now) {
+				k_sleep(K_USEC(due_us - now));
+			} else {
+				summary.late_max_us = MAX(summary.late_max_us, (uint32_t)(now - due_us));
+			}
+
+			// Shorter payloads are padded to fit the header
+			data.len = MAX(record.length, sizeof(app_traffic_hdr_t));
+			summary.records++;
+			err = tx_send(&data, seq, &summary);
+			if (err == 0) {
+				m_tx_bytes += data.len;
+				seq++;
+			} else if (err != -ENOMEM) {
+				break;
+			}
+		}
+	}
+	tx_end(&summary, start_ms);
+}
+
+static void tx_thread(void *p1, void *p2, void *p3)
+{
+	while (1) {
+		k_sem_take(&m_tx_start_sem, K_FOREVER);
+		if (m_tx_replay_loops > 0) {
+			replay_run(m_tx_replay_loops);
+		} else {
+			tx_run(&m_tx_config);
+		}
+		// Leave the PRX time to close the run, before the next one can start
+		k_sleep(K_MSEC(APP_TRAFFIC_RX_IDLE_MS));
+		m_tx_running = false;
+	}
+}
+
+K_THREAD_DEFINE(app_traffic_tx_thread, TX_THREAD_STACK_SIZE, tx_thread, NULL, NULL, NULL, TX_THREAD_PRIORITY, 0, 0);
+
+static bool on_tx_done(bool success)
+{
+	uint32_t index;
+
+	if (atomic_get(&m_tx_in_flight) <= 0) {
+		return false;
+	}
+	// Payloads complete in the order they were sent
+	index = m_tx_acked + m_tx_failed;
+	if (success) {
+		samples_add(&m_tx_samples, k_cyc_to_us_floor32(k_cycle_get_32() - m_tx_stamps[index % TX_STAMP_RING_SIZE]));
+		m_tx_acked++;
+	} else {
+		m_tx_failed++;
+	}
+	atomic_dec(&m_tx_in_flight);
+	k_sem_give(&m_tx_sem);
+	return true;
+}
+
+static void rx_start(uint8_t run)
+{
+	memset(&m_rx, 0, sizeof(m_rx));
+	m_rx.active = true;
+	m_rx.run = run;
+	m_rx.first_ms = k_uptime_get_32();
+	m_rx.delay_min = UINT32_MAX;
+	samples_reset(&m_rx_samples);
+}
+
+static bool rx_window_test_and_set(uint32_t seq)
+{
+	uint32_t *word = &m_rx.window[(seq / 32) % ARRAY_SIZE(m_rx.window)];
+	uint32_t bit = BIT(seq % 32);
+	bool was_set = (*word & bit) != 0;
+
+	*word |= bit;
+	return was_set;
+}
+
+static void rx_window_clear(uint32_t seq)
+{
+	m_rx.window[(seq / 32) % ARRAY_SIZE(m_rx.window)] &= ~BIT(seq % 32);
+}
+
+static bool on_rx(app_esb_event_t *event)
+{
+	app_traffic_hdr_t hdr;
+	uint32_t delay;
+
+	if (event->data_length < sizeof(hdr)) {
+		return false;
+	}
+	memcpy(&hdr, event->buf, sizeof(hdr));
+	if (hdr.magic != APP_TRAFFIC_MAGIC) {
+		return false;
+	}
+	if (m_rx.summarizing) {
+		// The previous run is being closed, started again too soon
+		return true;
+	}
+	if (!m_rx.active || hdr.run != m_rx.run) {
+		rx_start(hdr.run);
+	}
+
+	m_rx.received++;
+	if (m_rx.unique == 0) {
+		m_rx.highest = hdr.seq;
+		rx_window_test_and_set(hdr.seq);
+		m_rx.delay_base = (int32_t)(now_us() - hdr.timestamp_us) - RX_DELAY_BIAS_US;
+	} else if (hdr.seq > m_rx.highest) {
+		if (hdr.seq - m_rx.highest >= RX_WINDOW_SIZE) {
+			memset(m_rx.window, 0, sizeof(m_rx.window));
+		} else {
+			for (uint32_t seq = m_rx.highest + 1; seq < hdr.seq; seq++) {
+				rx_window_clear(seq);
+			}
+		}
+		rx_window_clear(hdr.seq);
+		rx_window_test_and_set(hdr.seq);
+		m_rx.highest = hdr.seq;
+	} else if (m_rx.highest - hdr.seq >= RX_WINDOW_SIZE) {
+		// Too old to check for a duplicate, taken as a late payload
+		m_rx.reordered++;
+	} else if (rx_window_test_and_set(hdr.seq)) {
+		m_rx.duplicates++;
+		k_work_reschedule(&m_rx_idle_work, K_MSEC(APP_TRAFFIC_RX_IDLE_MS));
+		return true;
+	} else {
+		m_rx.reordered++;
+	}
+	m_rx.unique++;
+	m_rx.bytes += event->data_length;
+	m_rx.last_ms = k_uptime_get_32();
+
+	delay = (uint32_t)((int32_t)(now_us() - hdr.timestamp_us) - m_rx.delay_base);
+	m_rx.delay_min = MIN(m_rx.delay_min, delay);
+	samples_add(&m_rx_samples, delay);
+
+	k_work_reschedule(&m_rx_idle_work, K_MSEC(APP_TRAFFIC_RX_IDLE_MS));
+	return true;
+}
+
+static void rx_idle_work_handler(struct k_work *work)
+{
+	app_traffic_rx_summary_t summary;
+
+	if (!m_rx.active) {
+		return;
+	}
+	m_rx.summarizing = true;
+
+	summary = (app_traffic_rx_summary_t){
+		.run = m_rx.run,
+		.elapsed_ms = m_rx.last_ms - m_rx.first_ms,
+		.received = m_rx.received,
+		.bytes = m_rx.bytes,
+		.expected = m_rx.highest + 1,
+		.lost = (m_rx.highest + 1 > m_rx.unique) ? m_rx.highest + 1 - m_rx.unique : 0,
+		.duplicates = m_rx.duplicates,
+		.reordered = m_rx.reordered,
+	};
+	samples_percentiles(&m_rx_samples, m_rx.delay_min, &summary.latency_p50_us, &summary.latency_p90_us,
+			    &summary.latency_p99_us, &summary.latency_max_us);
+	m_rx_summary = summary;
+	m_rx_summary_valid = true;
+	rx_summary_print(&summary);
+
+	m_rx.active = false;
+	m_rx.summarizing = false;
+}
+
+int app_traffic_init(app_esb_mode_t mode)
+{
+	m_mode = mode;
+	return 0;
+}
+
+int app_traffic_tx_start(const app_traffic_tx_config_t *config)
+{
+	if (m_mode != APP_ESB_MODE_PTX) {
+		return -ENOTSUP;
+	}
+	if (config->payload_len < sizeof(app_traffic_hdr_t) || config->payload_len > APP_TRAFFIC_PAYLOAD_MAX ||
+	    config->duration_ms == 0) {
+		return -EINVAL;
+	}
+	if (m_tx_running) {
+		return -EBUSY;
+	}
+	m_tx_config = *config;
+	m_tx_replay_loops = 0;
+	m_tx_stop = false;
+	m_tx_running = true;
+	k_sem_give(&m_tx_start_sem);
+	return 0;
+}
+
+int app_traffic_replay_start(uint32_t loops)
+{
+	if (m_mode != APP_ESB_MODE_PTX) {
+		return -ENOTSUP;
+	}
+	if (loops == 0) {
+		return -EINVAL;
+	}
+	if (esb_trace_count(NULL) == 0) {
+		return -ENODATA;
+	}
+	if (m_tx_running || esb_trace_enabled()) {
+		// The replay would be captured on top of the trace it is replaying
+		return -EBUSY;
+	}
+	m_tx_replay_loops = loops;
+	m_tx_stop = false;
+	m_tx_running = true;
+	k_sem_give(&m_tx_start_sem);
+	return 0;
+}
+
+void app_traffic_tx_stop(void)
+{
+	m_tx_stop = true;
+}
+
+bool app_traffic_tx_running(void)
+{
+	return m_tx_running;
+}
+
+int app_traffic_tx_summary_get(app_traffic_tx_summary_t *summary)
+{
+	if (!m_tx_summary_valid) {
+		return -ENODATA;
+	}
+	*summary = m_tx_summary;
+	return 0;
+}
+
+int app_traffic_rx_summary_get(app_traffic_rx_summary_t *summary)
+{
+	if (!m_rx_summary_valid) {
+		return -ENODATA;
+	}
+	*summary = m_rx_summary;
+	return 0;
+}
+
+bool app_traffic_on_esb_event(app_esb_event_t *event)
+{
+	switch (event->evt_type) {
+		case APP_ESB_EVT_TX_SUCCESS:
+			return on_tx_done(true);
+		case APP_ESB_EVT_TX_FAIL:
+			return on_tx_done(false);
+		case APP_ESB_EVT_RX:
+			return on_rx(event);
+		default:
+			return false;
+	}
+}
+
+#if defined(CONFIG_SHELL)
+static int cmd_traffic_tx(const struct shell *sh, size_t argc, char **argv)
+{
+	app_traffic_tx_config_t config = {
+		.payload_len = strtoul(argv[1], NULL, 10),
+		.rate_pps = strtoul(argv[2], NULL, 10),
+		.duration_ms = strtoul(argv[3], NULL, 10) * 1000,
+		.burst_len = (argc > 4) ? strtoul(argv[4], NULL, 10) : 0,
+		.burst_gap_ms = (argc > 5) ? strtoul(argv[5], NULL, 10) : 0,
+	};
+	int err;
+
+	err = app_traffic_tx_start(&config);
+	if (err) {
+		shell_error(sh, "Run not started (err %d)", err);
+		return err;
+	}
+	shell_print(sh, "Run %u started", (uint8_t)(m_run + 1));
+	return 0;
+}
+
+static int cmd_traffic_replay(const struct shell *sh, size_t argc, char **argv)
+{
+	uint32_t loops = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1;
+	int err;
+
+	err = app_traffic_replay_start(loops);
+	if (err) {
+		shell_error(sh, "Replay not started (err %d)", err);
+		return err;
+	}
+	shell_print(sh, "Run %u started, replaying %u records %u times", (uint8_t)(m_run + 1), esb_trace_count(NULL),
+		    loops);
+	return 0;
+}
+
+static int cmd_traffic_stop(const struct shell *sh, size_t argc, char **argv)
+{
+	app_traffic_tx_stop();
+	return 0;
+}
+
+static int cmd_traffic_status(const struct shell *sh, size_t argc, char **argv)
+{
+	if (m_mode == APP_ESB_MODE_PTX) {
+		shell_print(sh, "TX run %s", m_tx_running ? "in progress" : "idle");
+		if (m_tx_summary_valid) {
+			tx_summary_print(&m_tx_summary);
+		}
+	} else {
+		shell_print(sh, "RX run %s", m_rx.active ? "in progress" : "idle");
+		if (m_rx_summary_valid) {
+			rx_summary_print(&m_rx_summary);
+		}
+	}
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_traffic,
+	SHELL_CMD_ARG(tx, NULL, "Start a run: <size> <rate_pps, 0 to saturate> <duration_s> [<burst_len> <burst_gap_ms>]",
+		      cmd_traffic_tx, 4, 2),
+	SHELL_CMD_ARG(replay, NULL, "Replay the esb_trace records with their recorded timing: [<loops>]",
+		      cmd_traffic_replay, 1, 1),
+	SHELL_CMD(stop, NULL, "Stop the run in progress", cmd_traffic_stop),
+	SHELL_CMD(status, NULL, "Print the state and the summary of the last run", cmd_traffic_status),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(traffic, &sub_traffic, "Traffic generator and analyzer", NULL);
+#endif
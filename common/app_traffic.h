@@ -0,0 +1,112 @@
+#ifndef __APP_TRAFFIC_H
+#define __APP_TRAFFIC_H
+
+#include <zephyr/kernel.h>
+#include "app_esb.h"
+
+/* Traffic generator and analyzer for throughput and latency runs between the ptx and prx samples.
+ *
+ * The PTX side sends payloads of a given size, either at a fixed rate or as fast as app_esb accepts them
+ * (saturate), optionally in bursts separated by a pause, for a given duration. Every payload starts with an
+ * app_traffic_hdr_t holding a sequence number, the send time and the run number, and the rest is filled with a
+ * known pattern. The PTX measures the time from app_esb_send() to the ESB TX success, which includes queueing,
+ * timeslot scheduling and retransmissions.
+ *
+ * The PRX side counts lost, duplicate and reordered payloads from the sequence numbers, and measures the one way
+ * latency from the embedded send times. The clocks of the two devices aren't synchronized, so the latency is given
+ * relative to the fastest payload of the run: it shows the delay added by queueing and by BLE taking the radio,
+ * not the absolute time on air. A run ends on the PRX when no payload has arrived for APP_TRAFFIC_RX_IDLE_MS, and
+ * payloads lost at the very end of a run can't be told from a shorter run.
+ *
+ * At the end of a run both sides print a single line summary, starting with "TRAFFIC_TX" or "TRAFFIC_RX"
+ * followed by key=value pairs, for scripts to pick up from the console. Latency percentiles are computed from up
+ * to APP_TRAFFIC_SAMPLES samples, spread evenly over the run.
+ *
+ * Instead of synthetic traffic the PTX can also replay a trace of app_esb_send() calls, see esb_trace.h, to
+ * reproduce the burstiness of traffic recorded in the field. TX summaries include the TX backlog seen after each
+ * accepted payload.
+ *
+ * With CONFIG_SHELL enabled (see overlay-traffic.conf in the ptx and prx projects) the runs are controlled with the
+ * 'traffic' shell command.
+ */
+
+#define APP_TRAFFIC_MAGIC			0xA5
+#define APP_TRAFFIC_SAMPLES			1024
+#define APP_TRAFFIC_RX_IDLE_MS		1000
+#define APP_TRAFFIC_PAYLOAD_MAX		sizeof(((app_esb_data_t *)0)->data)
+
+typedef struct __packed {
+	uint32_t seq;
+	uint32_t timestamp_us;			// Sender uptime when the payload was passed to app_esb_send()
+	uint8_t magic;
+	uint8_t run;
+} app_traffic_hdr_t;
+
+typedef struct {
+	uint32_t payload_len;			// sizeof(app_traffic_hdr_t) to APP_TRAFFIC_PAYLOAD_MAX
+	uint32_t rate_pps;				// 0 to saturate
+	uint32_t duration_ms;
+	uint32_t burst_len;				// Payloads per burst, 0 for continuous traffic
+	uint32_t burst_gap_ms;			// Pause after each burst
+} app_traffic_tx_config_t;
+
+typedef struct {
+	uint32_t run;
+	bool replay;
+	uint32_t records;				// Trace records replayed
+	uint32_t late_max_us;			// Most a replayed call was behind its recorded time
+	uint32_t elapsed_ms;
+	uint32_t offered;				// Calls to app_esb_send()
+	uint32_t rejected;				// Calls refused because the TX queue was full
+	uint32_t acked;
+	uint32_t failed;
+	uint32_t backlog_avg;			// TX payloads waiting after each accepted call
+	uint32_t backlog_max;
+	uint32_t latency_p50_us;		// app_esb_send() -> TX success
+	uint32_t latency_p90_us;
+	uint32_t latency_p99_us;
+	uint32_t latency_max_us;
+} app_traffic_tx_summary_t;
+
+typedef struct {
+	uint32_t run;
+	uint32_t elapsed_ms;			// First to last payload
+	uint32_t received;
+	uint32_t bytes;
+	uint32_t expected;				// Highest sequence number seen + 1
+	uint32_t lost;
+	uint32_t duplicates;
+	uint32_t reordered;
+	uint32_t latency_p50_us;		// Relative to the fastest payload of the run
+	uint32_t latency_p90_us;
+	uint32_t latency_p99_us;
+	uint32_t latency_max_us;
+} app_traffic_rx_summary_t;
+
+/* Must be called after app_esb_init(), with the same mode */
+int app_traffic_init(app_esb_mode_t mode);
+
+/* Start a run on the PTX. Returns -EBUSY if a run is in progress. */
+int app_traffic_tx_start(const app_traffic_tx_config_t *config);
+
+/* Replay the app_esb_send() calls captured by esb_trace.c on the PTX, loops times, with the recorded times
+ * between the calls and the recorded payload lengths. Payloads shorter than the header are padded. The summary
+ * adds how far behind the recorded timing the replay fell.
+ */
+int app_traffic_replay_start(uint32_t loops);
+
+/* Stop the run in progress, the summary is printed as for a run that ran to the end */
+void app_traffic_tx_stop(void);
+
+bool app_traffic_tx_running(void);
+
+/* Summary of the last complete run. Returns -ENODATA if no run has completed. */
+int app_traffic_tx_summary_get(app_traffic_tx_summary_t *summary);
+int app_traffic_rx_summary_get(app_traffic_rx_summary_t *summary);
+
+/* To be called from the app_esb callback. Returns true if the event belongs to a run, and should be ignored by
+ * the application.
+ */
+bool app_traffic_on_esb_event(app_esb_event_t *event);
+
+#endif
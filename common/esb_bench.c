@@ -0,0 +1,122 @@
+#include "esb_bench.h"
+#include <string.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(esb_bench, LOG_LEVEL_INF);
+
+// Number of time sync exchanges, the one with the shortest round trip is used
+#define TIME_SYNC_ROUNDS	8
+
+#if defined(CONFIG_SOC_NRF5340_CPUAPP) || defined(CONFIG_SOC_NRF5340_CPUNET)
+#include "esb_shm.h"
+#define TABLE (esb_shm_bench_table())
+#else
+static struct esb_bench_table m_table;
+#define TABLE (&m_table)
+#endif
+
+#if defined(CONFIG_SOC_NRF5340_CPUAPP)
+#include <esb_rpc_gen.h>
+
+NRF_RPC_GROUP_DECLARE(esb_group);
+
+// Stages stamped by app_esb on the network core, which need the offset to get to the application core timebase
+#define NET_STAGES (BIT(ESB_BENCH_TX_QUEUED) | BIT(ESB_BENCH_TX_RADIO_DONE) | BIT(ESB_BENCH_RX_RADIO))
+
+static uint32_t m_net_offset;
+#endif
+
+void esb_bench_stamp(esb_bench_stage_t stage, const uint8_t *payload, uint32_t length)
+{
+	uint32_t seq;
+
+	if (!TABLE->enabled || length < sizeof(seq)) {
+		return;
+	}
+	memcpy(&seq, payload, sizeof(seq));
+	esb_bench_stamp_seq(stage, seq);
+}
+
+void esb_bench_stamp_seq(esb_bench_stage_t stage, uint32_t seq)
+{
+	struct esb_bench_row *row;
+	uint32_t now = k_cycle_get_32();
+
+	if (!TABLE->enabled) {
+		return;
+	}
+	row = &TABLE->rows[seq % ESB_BENCH_ROWS];
+	if (stage == ESB_BENCH_TX_APP_SEND || stage == ESB_BENCH_RX_RADIO) {
+		row->valid = 0;
+		row->seq = seq;
+	} else if (row->seq != seq) {
+		return;
+	}
+	row->stamps[stage] = now;
+	row->valid |= BIT(stage);
+}
+
+void esb_bench_enable(bool enable)
+{
+	if (enable) {
+		memset((void *)TABLE->rows, 0, sizeof(TABLE->rows));
+	}
+	TABLE->enabled = enable;
+}
+
+int esb_bench_time_sync(uint32_t *error_us)
+{
+#if defined(CONFIG_SOC_NRF5340_CPUAPP)
+	struct esb_rpc_time_sync_cmd cmd;
+	struct esb_rpc_time_sync_rsp rsp;
+	uint32_t best_rtt = UINT32_MAX;
+	int err;
+
+	if (!(esb_rpc_features_get() & ESB_RPC_FEATURE_TIME_SYNC)) {
+		LOG_WRN("No time sync on the network core, stages stamped on different cores can't be compared");
+		return -ENOTSUP;
+	}
+
+	for (int i = 0; i < TIME_SYNC_ROUNDS; i++) {
+		uint32_t t0 = k_cycle_get_32();
+
+		err = esb_rpc_time_sync_call(&esb_group, &cmd, &rsp);
+		if (err) {
+			LOG_ERR("Time sync failed (err %d)", err);
+			return err;
+		}
+
+		uint32_t rtt = k_cycle_get_32() - t0;
+
+		// Assume the network core read its counter half way through the round trip
+		if (rtt < best_rtt) {
+			best_rtt = rtt;
+			m_net_offset = (t0 + rtt / 2) - rsp.cycles;
+		}
+	}
+	*error_us = k_cyc_to_us_ceil32(best_rtt / 2 + 1);
+	LOG_INF("Network core offset %u cycles, +-%u us", m_net_offset, *error_us);
+#else
+	*error_us = 0;
+#endif
+	return 0;
+}
+
+uint32_t esb_bench_read(uint32_t seq, uint32_t stamps[ESB_BENCH_STAGE_COUNT])
+{
+	struct esb_bench_row *row = &TABLE->rows[seq % ESB_BENCH_ROWS];
+	uint32_t valid = row->valid;
+
+	if (row->seq != seq) {
+		return 0;
+	}
+	for (int i = 0; i < ESB_BENCH_STAGE_COUNT; i++) {
+		stamps[i] = row->stamps[i];
+#if defined(CONFIG_SOC_NRF5340_CPUAPP)
+		if (NET_STAGES & BIT(i)) {
+			stamps[i] += m_net_offset;
+		}
+#endif
+	}
+	return valid;
+}
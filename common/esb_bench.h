@@ -0,0 +1,61 @@
+#ifndef __ESB_BENCH_H
+#define __ESB_BENCH_H
+
+#include <zephyr/kernel.h>
+
+/* Per packet time stamps along the ESB data path, used by the bench application.
+ *
+ * Every payload sent by the bench starts with a 32 bit sequence number. Each stage of the path stamps the time it
+ * handled the payload into a table row selected by the sequence number, and the bench reads the rows back when
+ * the packet has completed. On the nRF5340 the table is in the esb_shm region, so the network core stages are
+ * stamped directly, and esb_bench_time_sync() measures the offset between the two cores' cycle counters so all
+ * the stamps can be given in the application core timebase.
+ *
+ * The time stamps are k_cycle_get_32() values. Stamping costs a single check of the enabled flag when the
+ * bench is not running.
+ */
+
+#define ESB_BENCH_ROWS	64
+
+typedef enum {
+	ESB_BENCH_TX_APP_SEND,		// app_esb_send() called by the application
+	ESB_BENCH_TX_QUEUED,		// Payload put in the app_esb TX queue, on the network core for the nRF5340
+	ESB_BENCH_TX_RADIO_DONE,	// ESB TX success
+	ESB_BENCH_TX_APP_DONE,		// TX success passed to the application
+	ESB_BENCH_RX_RADIO,			// Payload received by ESB
+	ESB_BENCH_RX_APP,			// RX event passed to the application
+	ESB_BENCH_STAGE_COUNT
+} esb_bench_stage_t;
+
+struct esb_bench_row {
+	volatile uint32_t seq;
+	volatile uint32_t valid;	// Bit mask of the stages stamped for seq
+	volatile uint32_t stamps[ESB_BENCH_STAGE_COUNT];
+};
+
+struct esb_bench_table {
+	volatile uint32_t enabled;
+	struct esb_bench_row rows[ESB_BENCH_ROWS];
+};
+
+/* Stamp a stage for the payload, if the bench is enabled. Payloads shorter than the sequence number are ignored.
+ * The first stage in each direction (TX_APP_SEND and RX_RADIO) starts a new row. Can be called from any context.
+ */
+void esb_bench_stamp(esb_bench_stage_t stage, const uint8_t *payload, uint32_t length);
+
+void esb_bench_stamp_seq(esb_bench_stage_t stage, uint32_t seq);
+
+/* Must be called after app_esb_init(), as the table is reset when the inter-core rings are set up */
+void esb_bench_enable(bool enable);
+
+/* Measure the offset between the network core and application core cycle counters. error_us is set to the
+ * largest possible error of the offset. Does nothing on single core builds.
+ */
+int esb_bench_time_sync(uint32_t *error_us);
+
+/* Read the stamps of a packet, converted to the local timebase. Returns the bit mask of the stages stamped,
+ * or 0 if the row has been reused by a newer packet.
+ */
+uint32_t esb_bench_read(uint32_t seq, uint32_t stamps[ESB_BENCH_STAGE_COUNT]);
+
+#endif
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2022 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef __ESB_RPC_GEN_H
+#define __ESB_RPC_GEN_H
+
+/* Generates the nRF RPC marshalling code for the commands listed in esb_rpc_ids.h. For a command with name
+ * <name> and ID <ID> this gives:
+ *
+ * - RPC_COMMAND_<ID>, the command ID
+ * - struct esb_rpc_<name>_cmd and struct esb_rpc_<name>_rsp, holding the fields of the lists
+ * - ESB_RPC_<ID>_CMD_SIZE and ESB_RPC_<ID>_RSP_SIZE, the largest possible CBOR encoding of each message
+ * - ESB_RPC_MSG_SIZE_MAX, the largest of these over all the commands
+ * - esb_rpc_<name>_call(), the application core stub. Sends the command and waits for the response.
+ * - esb_rpc_<name>_handler(), the network core handler. Decodes the command, calls esb_rpc_<name>_impl(),
+ *   which is implemented by the network core, and sends the response.
+ *
+ * The CBOR buffers are allocated with the computed sizes, so they never need to be guessed or grown.
+ * ESB_RPC_HANDLERS_DEFINE(group) registers the network core handlers with nRF RPC.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <esb_rpc_ids.h>
+
+#include <nrf_rpc_cbor.h>
+#include <zcbor_common.h>
+#include <zcbor_decode.h>
+#include <zcbor_encode.h>
+
+// Largest CBOR encoding of each field kind. Byte strings have a header of up to 3 bytes below 64 kB.
+#define ESB_RPC_SIZE_U32(max)		5
+#define ESB_RPC_SIZE_I32(max)		5
+#define ESB_RPC_SIZE_BYTES(max)		(3 + (max))
+
+#define ESB_RPC_FIELD_DECL_U32(name, max)	uint32_t name;
+#define ESB_RPC_FIELD_DECL_I32(name, max)	int32_t name;
+#define ESB_RPC_FIELD_DECL_BYTES(name, max)	struct { uint32_t len; uint8_t data[max]; } name;
+
+#define ESB_RPC_FIELD_ENC_U32(name, max)	zcbor_uint32_put(zs, msg->name)
+#define ESB_RPC_FIELD_ENC_I32(name, max)	zcbor_int32_put(zs, msg->name)
+#define ESB_RPC_FIELD_ENC_BYTES(name, max) \
+	(msg->name.len <= (max) && zcbor_bstr_encode_ptr(zs, msg->name.data, msg->name.len))
+
+#define ESB_RPC_FIELD_DEC_U32(name, max)	zcbor_uint32_decode(zs, &msg->name)
+#define ESB_RPC_FIELD_DEC_I32(name, max)	zcbor_int32_decode(zs, &msg->name)
+#define ESB_RPC_FIELD_DEC_BYTES(name, max)	esb_rpc_bytes_decode(zs, msg->name.data, &msg->name.len, (max))
+
+#define ESB_RPC_FIELD_DECL(kind, name, max)	ESB_RPC_FIELD_DECL_##kind(name, max)
+#define ESB_RPC_FIELD_SIZE(kind, name, max)	+ ESB_RPC_SIZE_##kind(max)
+#define ESB_RPC_FIELD_ENC(kind, name, max)	&& ESB_RPC_FIELD_ENC_##kind(name, max)
+#define ESB_RPC_FIELD_DEC(kind, name, max)	&& ESB_RPC_FIELD_DEC_##kind(name, max)
+
+static inline bool esb_rpc_bytes_decode(zcbor_state_t *zs, uint8_t *data, uint32_t *len, uint32_t max)
+{
+	struct zcbor_string zst;
+
+	if (!zcbor_bstr_decode(zs, &zst) || zst.len > max) {
+		return false;
+	}
+	memcpy(data, zst.value, zst.len);
+	*len = zst.len;
+	return true;
+}
+
+#define ESB_RPC_GEN_ID(arg, ID, value, name) RPC_COMMAND_##ID = value,
+
+enum rpc_command {
+	ESB_RPC_COMMANDS(ESB_RPC_GEN_ID, _)
+};
+
+#define ESB_RPC_GEN_TYPES(arg, ID, value, name)												\
+	struct esb_rpc_##name##_cmd {															\
+		ESB_RPC_##name##_CMD(ESB_RPC_FIELD_DECL)											\
+	};																						\
+	struct esb_rpc_##name##_rsp {															\
+		int32_t err;																		\
+		ESB_RPC_##name##_RSP(ESB_RPC_FIELD_DECL)											\
+	};																						\
+	enum {																					\
+		ESB_RPC_##ID##_CMD_SIZE = 0 ESB_RPC_##name##_CMD(ESB_RPC_FIELD_SIZE),				\
+		ESB_RPC_##ID##_RSP_SIZE = ESB_RPC_SIZE_I32(0) ESB_RPC_##name##_RSP(ESB_RPC_FIELD_SIZE),	\
+	};																						\
+	static inline bool esb_rpc_##name##_cmd_encode(zcbor_state_t *zs,						\
+						       const struct esb_rpc_##name##_cmd *msg)						\
+	{																						\
+		return true ESB_RPC_##name##_CMD(ESB_RPC_FIELD_ENC);								\
+	}																						\
+	static inline bool esb_rpc_##name##_cmd_decode(zcbor_state_t *zs,						\
+						       struct esb_rpc_##name##_cmd *msg)							\
+	{																						\
+		return true ESB_RPC_##name##_CMD(ESB_RPC_FIELD_DEC);								\
+	}																						\
+	static inline bool esb_rpc_##name##_rsp_encode(zcbor_state_t *zs,						\
+						       const struct esb_rpc_##name##_rsp *msg)						\
+	{																						\
+		return zcbor_int32_put(zs, msg->err) ESB_RPC_##name##_RSP(ESB_RPC_FIELD_ENC);		\
+	}																						\
+	/* A response with a valid err but missing fields comes from an older image, reported as -EPROTO */	\
+	static inline bool esb_rpc_##name##_rsp_decode(zcbor_state_t *zs,						\
+						       struct esb_rpc_##name##_rsp *msg)							\
+	{																						\
+		if (!zcbor_int32_decode(zs, &msg->err)) {											\
+			msg->err = -EBADMSG;															\
+			return false;																	\
+		}																					\
+		if (!(true ESB_RPC_##name##_RSP(ESB_RPC_FIELD_DEC))) {								\
+			if (!msg->err) {																\
+				msg->err = -EPROTO;															\
+			}																				\
+			return false;																	\
+		}																					\
+		return true;																		\
+	}
+
+ESB_RPC_COMMANDS(ESB_RPC_GEN_TYPES, _)
+
+#define ESB_RPC_GEN_SIZES(arg, ID, value, name)												\
+	uint8_t name##_cmd[ESB_RPC_##ID##_CMD_SIZE];											\
+	uint8_t name##_rsp[ESB_RPC_##ID##_RSP_SIZE];
+
+// Only used to find the largest message size at compile time
+union esb_rpc_msg_sizes {
+	ESB_RPC_COMMANDS(ESB_RPC_GEN_SIZES, _)
+};
+
+#define ESB_RPC_MSG_SIZE_MAX sizeof(union esb_rpc_msg_sizes)
+
+/* Application core stubs. Return the err field of the response, or -EINVAL if the command could not be sent. */
+#define ESB_RPC_GEN_CALL(arg, ID, value, name)												\
+	static inline void esb_rpc_##name##_rsp_handler(const struct nrf_rpc_group *group,		\
+							struct nrf_rpc_cbor_ctx *ctx, void *handler_data)				\
+	{																						\
+		esb_rpc_##name##_rsp_decode(ctx->zs, (struct esb_rpc_##name##_rsp *)handler_data);	\
+		nrf_rpc_cbor_decoding_done(group, ctx);												\
+	}																						\
+	static inline int esb_rpc_##name##_call(const struct nrf_rpc_group *group,				\
+						const struct esb_rpc_##name##_cmd *cmd,								\
+						struct esb_rpc_##name##_rsp *rsp)									\
+	{																						\
+		struct nrf_rpc_cbor_ctx ctx;														\
+		int err;																			\
+																							\
+		NRF_RPC_CBOR_ALLOC(group, ctx, ESB_RPC_##ID##_CMD_SIZE);							\
+		if (!esb_rpc_##name##_cmd_encode(ctx.zs, cmd)) {									\
+			NRF_RPC_CBOR_DISCARD(group, ctx);												\
+			return -EINVAL;																	\
+		}																					\
+		rsp->err = -EBADMSG;																\
+		err = nrf_rpc_cbor_cmd(group, RPC_COMMAND_##ID, &ctx,								\
+				       esb_rpc_##name##_rsp_handler, rsp);									\
+		if (err) {																			\
+			return -EINVAL;																	\
+		}																					\
+		return rsp->err;																	\
+	}
+
+ESB_RPC_COMMANDS(ESB_RPC_GEN_CALL, _)
+
+/* Network core handlers. The command is decoded and released before the implementation runs, so nRF RPC can
+ * take the next command in the meantime. The implementation fills in the response, including err.
+ */
+#define ESB_RPC_GEN_HANDLER(arg, ID, value, name)											\
+	void esb_rpc_##name##_impl(const struct esb_rpc_##name##_cmd *cmd,						\
+				   struct esb_rpc_##name##_rsp *rsp);										\
+	static inline void esb_rpc_##name##_handler(const struct nrf_rpc_group *group,			\
+						    struct nrf_rpc_cbor_ctx *ctx, void *handler_data)				\
+	{																						\
+		struct esb_rpc_##name##_cmd cmd;													\
+		struct esb_rpc_##name##_rsp rsp = {0};												\
+		struct nrf_rpc_cbor_ctx rsp_ctx;													\
+		bool decoded = esb_rpc_##name##_cmd_decode(ctx->zs, &cmd);							\
+																							\
+		nrf_rpc_cbor_decoding_done(group, ctx);												\
+		if (decoded) {																		\
+			esb_rpc_##name##_impl(&cmd, &rsp);												\
+		} else {																			\
+			rsp.err = -EBADMSG;																\
+		}																					\
+		NRF_RPC_CBOR_ALLOC(group, rsp_ctx, ESB_RPC_##ID##_RSP_SIZE);						\
+		esb_rpc_##name##_rsp_encode(rsp_ctx.zs, &rsp);										\
+		nrf_rpc_cbor_rsp_no_err(group, &rsp_ctx);											\
+	}
+
+ESB_RPC_COMMANDS(ESB_RPC_GEN_HANDLER, _)
+
+#define ESB_RPC_GEN_DECODER(group, ID, value, name)											\
+	NRF_RPC_CBOR_CMD_DECODER(group, esb_rpc_##name, RPC_COMMAND_##ID, esb_rpc_##name##_handler, NULL);
+
+#define ESB_RPC_HANDLERS_DEFINE(group) ESB_RPC_COMMANDS(ESB_RPC_GEN_DECODER, group)
+
+#endif
@@ -7,15 +7,97 @@
 #ifndef __ESB_RPC_IDS_H
 #define __ESB_RPC_IDS_H
 
-/* The command and event IDs need to be the same for both RPC sides. */
+#include <zephyr/sys/util.h>
 
-enum rpc_command {
-	RPC_COMMAND_ESB_INIT = 0x01,
-	RPC_COMMAND_ESB_TX = 0x02,
-};
+/* Interface definition of the ESB API between the nRF5340 cores. This is the only place the commands, their
+ * arguments and the esb_shm record types are listed. esb_rpc_gen.h turns the lists into the command IDs,
+ * message structs, CBOR encoders and decoders with compile time buffer sizes, the application core call stubs
+ * and the network core command handlers, so both sides are always built from the same definition.
+ *
+ * Only control calls go through nRF RPC, ESB payloads and events use the rings in esb_shm.h.
+ *
+ * To add a call:
+ * - Add a line to ESB_RPC_COMMANDS with a new ID
+ * - Define the argument and response field lists, ESB_RPC_<name>_CMD and ESB_RPC_<name>_RSP
+ * - Call esb_rpc_<name>_call() on the application core, and implement esb_rpc_<name>_impl() on the network core
+ * - Bump ESB_RPC_PROTOCOL_VERSION, or add a feature bit if older images can do without the call
+ */
+
+/* Version of the inter-core protocol, i.e. the commands and the esb_shm record formats.
+ * Must be changed whenever either changes in a way the other side can't handle.
+ *
+ * Each side speaks every version from ESB_RPC_PROTOCOL_VERSION_MIN up to ESB_RPC_PROTOCOL_VERSION. The application
+ * core offers its version in the init command, and the network core answers with the lower of the two versions,
+ * which both sides then use. Init fails with -EPROTO if either side can't go down to the version of the other.
+ * Raise ESB_RPC_PROTOCOL_VERSION_MIN when support for an old version is dropped.
+ */
+#define ESB_RPC_PROTOCOL_VERSION		1
+#define ESB_RPC_PROTOCOL_VERSION_MIN	1
+
+/* Optional features, offered by the application core in the init command. The network core answers with the
+ * subset it supports, and only the negotiated features are used by either side.
+ */
+#define ESB_RPC_FEATURE_TX_CREDITS		BIT(0)	// TX flow control through credits returned in shared memory
+#define ESB_RPC_FEATURE_EVENT_COUNTS	BIT(1)	// TX_SUCCESS and TX_FAIL records carry a count of events
+#define ESB_RPC_FEATURE_RADIO_TIME		BIT(2)	// The network core handles RPC_COMMAND_ESB_RADIO_TIME
+#define ESB_RPC_FEATURE_TIME_SYNC		BIT(3)	// The network core handles RPC_COMMAND_ESB_TIME_SYNC
+
+#define ESB_RPC_FEATURES_SUPPORTED	(ESB_RPC_FEATURE_TX_CREDITS | ESB_RPC_FEATURE_EVENT_COUNTS | \
+					 ESB_RPC_FEATURE_RADIO_TIME | ESB_RPC_FEATURE_TIME_SYNC)
+
+/* Features negotiated with the network core during init, for the application core modules calling the optional
+ * commands. 0 before init has completed.
+ */
+uint32_t esb_rpc_features_get(void);
 
-enum rpc_event {
-	RPC_EVENT_ESB_CB = 0x01,
-};
+/* Commands, as CMD(arg, ID, name). ID gives RPC_COMMAND_<ID>, name the struct and function names. */
+#define ESB_RPC_COMMANDS(CMD, arg) \
+	CMD(arg, ESB_INIT, 0x01, init) \
+	CMD(arg, ESB_TIME_SYNC, 0x02, time_sync) \
+	CMD(arg, ESB_RADIO_TIME, 0x03, radio_time)
+
+/* Field lists, as F(kind, name, max). kind is U32, I32 or BYTES, and max is the largest number of bytes
+ * for BYTES fields (ignored for the others). Every response also starts with an I32 err field, which is added
+ * by the generator and holds the result of the call on the network core.
+ */
+
+// The protocol version and offered features of the application core, and the ESB mode
+#define ESB_RPC_init_CMD(F) \
+	F(U32, version, 0) \
+	F(U32, features, 0) \
+	F(U32, mode, 0)
+
+// The protocol version and negotiated features of the network core, and the number of TX credits granted
+#define ESB_RPC_init_RSP(F) \
+	F(U32, version, 0) \
+	F(U32, features, 0) \
+	F(U32, tx_credits, 0)
+
+// No arguments
+#define ESB_RPC_time_sync_CMD(F)
+
+// The network core k_cycle_get_32() value, read when the command was handled. Used by esb_bench.c.
+#define ESB_RPC_time_sync_RSP(F) \
+	F(U32, cycles, 0)
+
+// No arguments
+#define ESB_RPC_radio_time_CMD(F)
+
+// Wall time covered by the timeslot analytics on the network core, and the time spent in ESB timeslots
+#define ESB_RPC_radio_time_RSP(F) \
+	F(U32, total_ms, 0) \
+	F(U32, esb_ms, 0)
+
+/* esb_shm record types, as R(name). Gives ESB_SHM_REC_<name> in esb_shm.h.
+ * TX_PAYLOAD goes from the application core to the network core and carries an ESB payload to send.
+ * The others go from the network core to the application core and carry the app_esb events. TX_SUCCESS and
+ * TX_FAIL carry the number of events as a uint32_t when ESB_RPC_FEATURE_EVENT_COUNTS is negotiated, and are
+ * empty otherwise. RX carries the received payload.
+ */
+#define ESB_SHM_RECORD_TYPES(R) \
+	R(TX_PAYLOAD) \
+	R(EVT_TX_SUCCESS) \
+	R(EVT_TX_FAIL) \
+	R(EVT_RX)
 
-#endif
\ No newline at end of file
+#endif
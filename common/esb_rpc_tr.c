@@ -0,0 +1,221 @@
+#include "esb_rpc_tr.h"
+#include <zephyr/device.h>
+#include <zephyr/ipc/ipc_service.h>
+#include <esb_rpc_gen.h>
+
+#if defined(CONFIG_SOC_NRF5340_CPUNET)
+#include "53_net/ipc_tx_sched.h"
+#endif
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(esb_rpc_tr, LOG_LEVEL_INF);
+
+// Room for the nRF RPC packet header in front of the CBOR data
+#define NRF_RPC_HEADER_MAX		8
+// Room for the packets nRF RPC sends on its own, such as the group init packet with the group name
+#define NRF_RPC_INTERNAL_MAX	48
+
+#define TX_BUF_SIZE				ROUND_UP(MAX(NRF_RPC_INTERNAL_MAX, ESB_RPC_MSG_SIZE_MAX + NRF_RPC_HEADER_MAX), 4)
+// One buffer for every thread that can send at the same time, and one for the response sent from the RX path
+#define TX_BUF_COUNT			(CONFIG_NRF_RPC_THREAD_POOL_SIZE + 2)
+
+/* A TX buffer. On the network core the messages go through the IPC TX scheduler, which needs an item per message. */
+struct tx_buf {
+#if defined(CONFIG_SOC_NRF5340_CPUNET)
+	struct ipc_tx_item item;
+#endif
+	uint8_t data[TX_BUF_SIZE] __aligned(4);
+};
+
+K_MEM_SLAB_DEFINE_STATIC(m_tx_slab, sizeof(struct tx_buf), TX_BUF_COUNT, 4);
+
+static const struct device *const m_ipc = DEVICE_DT_GET(DT_NODELABEL(ipc0));
+static struct ipc_ept m_ept;
+static K_SEM_DEFINE(m_bound_sem, 0, 1);
+
+static nrf_rpc_tr_receive_handler_t m_receive_cb;
+static void *m_receive_ctx;
+static bool m_initialized;
+
+static esb_rpc_tr_stats_t m_stats = {.tx_pool_min_free = TX_BUF_COUNT};
+
+#if defined(CONFIG_SOC_NRF5340_CPUNET)
+static void tx_sent(struct ipc_tx_item *item, int err);
+
+static struct ipc_tx_client m_tx_client = {
+	.name = "esb_rpc",
+	.ept = &m_ept,
+	// Control traffic for ESB, served ahead of the HCI endpoint
+	.priority = 1,
+	.weight = 1,
+	// The application core blocks on every RPC response, none of them can be dropped
+	.reliable = true,
+	.on_sent = tx_sent,
+};
+#endif
+
+static void ept_bound(void *priv)
+{
+	k_sem_give(&m_bound_sem);
+}
+
+static void ept_received(const void *data, size_t len, void *priv)
+{
+#if defined(CONFIG_SOC_NRF5340_CPUNET)
+	ipc_tx_sched_rx_notify();
+#endif
+	if (m_receive_cb) {
+		m_receive_cb(&esb_rpc_tr, data, len, m_receive_ctx);
+	}
+}
+
+static struct ipc_ept_cfg m_ept_cfg = {
+	.name = "nrf_rpc_ept",
+	.cb = {
+		.bound = ept_bound,
+		.received = ept_received,
+	},
+};
+
+static int tr_init(const struct nrf_rpc_tr *transport, nrf_rpc_tr_receive_handler_t receive_cb, void *context)
+{
+	int err;
+
+	// nRF RPC initializes the transport once for every group using it
+	if (m_initialized) {
+		return 0;
+	}
+	m_receive_cb = receive_cb;
+	m_receive_ctx = context;
+
+	err = ipc_service_open_instance(m_ipc);
+	if (err && err != -EALREADY) {
+		LOG_ERR("IPC instance open error: %d", err);
+		return err;
+	}
+
+	err = ipc_service_register_endpoint(m_ipc, &m_ept, &m_ept_cfg);
+	if (err) {
+		LOG_ERR("IPC endpoint register error: %d", err);
+		return err;
+	}
+
+	k_sem_take(&m_bound_sem, K_FOREVER);
+
+#if defined(CONFIG_SOC_NRF5340_CPUNET)
+	err = ipc_tx_sched_client_register(&m_tx_client);
+	if (err) {
+		LOG_ERR("IPC TX scheduler register error: %d", err);
+		return err;
+	}
+#endif
+	m_initialized = true;
+
+	LOG_INF("%i TX buffers of %i bytes", TX_BUF_COUNT, (int)TX_BUF_SIZE);
+	return 0;
+}
+
+static void *tr_tx_buf_alloc(const struct nrf_rpc_tr *transport, size_t *size)
+{
+	struct tx_buf *buf;
+	uint32_t num_free;
+	int err;
+
+	if (*size > TX_BUF_SIZE) {
+		// No amount of waiting helps, TX_BUF_SIZE doesn't cover a message nRF RPC sends
+		LOG_ERR("TX buffer of %i bytes requested, the buffers are %i bytes", (int)*size, (int)TX_BUF_SIZE);
+		k_oops();
+	}
+
+	err = k_mem_slab_alloc(&m_tx_slab, (void **)&buf, K_NO_WAIT);
+	if (err) {
+		m_stats.tx_alloc_waits++;
+		if (k_is_in_isr()) {
+			LOG_ERR("No free TX buffer in interrupt context");
+			k_oops();
+		}
+		// nRF RPC can't handle a failed allocation, so wait for one of the sends in progress to free a buffer
+		while (k_mem_slab_alloc(&m_tx_slab, (void **)&buf, K_MSEC(ESB_RPC_TR_ALLOC_TIMEOUT_MS)) != 0) {
+			m_stats.tx_alloc_timeouts++;
+			LOG_WRN("No free TX buffer for %i ms, still waiting", ESB_RPC_TR_ALLOC_TIMEOUT_MS);
+		}
+	}
+
+	m_stats.tx_allocs++;
+	num_free = k_mem_slab_num_free_get(&m_tx_slab);
+	if (num_free < m_stats.tx_pool_min_free) {
+		m_stats.tx_pool_min_free = num_free;
+	}
+	*size = TX_BUF_SIZE;
+	return buf->data;
+}
+
+static void tr_tx_buf_free(const struct nrf_rpc_tr *transport, void *buf)
+{
+	k_mem_slab_free(&m_tx_slab, CONTAINER_OF(buf, struct tx_buf, data));
+}
+
+#if defined(CONFIG_SOC_NRF5340_CPUNET)
+static void tx_sent(struct ipc_tx_item *item, int err)
+{
+	if (err < 0) {
+		m_stats.send_failures++;
+	}
+	k_mem_slab_free(&m_tx_slab, CONTAINER_OF(item, struct tx_buf, item));
+}
+
+/* Takes ownership of the buffer, which is returned to the pool when the scheduler has sent it */
+static int tr_send(const struct nrf_rpc_tr *transport, const uint8_t *data, size_t length)
+{
+	struct tx_buf *buf = CONTAINER_OF(data, struct tx_buf, data);
+
+	buf->item.data = data;
+	buf->item.len = length;
+	return ipc_tx_sched_send(&m_tx_client, &buf->item);
+}
+#else
+/* Takes ownership of the buffer, which is returned to the pool once the data has been copied to the IPC buffer */
+static int tr_send(const struct nrf_rpc_tr *transport, const uint8_t *data, size_t length)
+{
+	int64_t deadline = k_uptime_get() + ESB_RPC_TR_SEND_TIMEOUT_MS;
+	int err;
+
+	while (1) {
+		err = ipc_service_send(&m_ept, data, length);
+		if (err != -ENOMEM || k_is_in_isr() || k_uptime_get() >= deadline) {
+			break;
+		}
+		// The other core hasn't read the IPC buffer yet
+		m_stats.send_retries++;
+		k_sleep(K_MSEC(1));
+	}
+
+	tr_tx_buf_free(transport, (void *)data);
+
+	if (err < 0) {
+		LOG_ERR("IPC send error: %d", err);
+		m_stats.send_failures++;
+		return err;
+	}
+	return 0;
+}
+#endif
+
+static const struct nrf_rpc_tr_api m_tr_api = {
+	.init = tr_init,
+	.send = tr_send,
+	.tx_buf_alloc = tr_tx_buf_alloc,
+	.tx_buf_free = tr_tx_buf_free,
+};
+
+const struct nrf_rpc_tr esb_rpc_tr = {
+	.api = &m_tr_api,
+	.ctx = NULL,
+};
+
+void esb_rpc_tr_stats_get(esb_rpc_tr_stats_t *stats)
+{
+	uint32_t key = irq_lock();
+	*stats = m_stats;
+	irq_unlock(key);
+}
@@ -0,0 +1,38 @@
+#ifndef __ESB_RPC_TR_H
+#define __ESB_RPC_TR_H
+
+#include <zephyr/kernel.h>
+#include <nrf_rpc_tr.h>
+
+/* nRF RPC transport for the ESB group on the nRF5340.
+ *
+ * Works like the nRF RPC IPC transport, on the nrf_rpc_ept endpoint of the ipc0 instance, but the TX buffers
+ * come from a fixed pool of fixed size buffers instead of the heap. The buffer size is computed from the
+ * largest message in esb_rpc_ids.h, so every command fits without guessing.
+ *
+ * If the pool is empty, an allocation waits for a buffer to be freed. nRF RPC has no way to handle a failed
+ * allocation, so the wait has no limit, but a warning is logged and tx_alloc_timeouts counted every
+ * ESB_RPC_TR_ALLOC_TIMEOUT_MS. Only an allocation in interrupt context, which can't wait, is a fatal error.
+ *
+ * On the network core the messages are sent through the IPC TX scheduler (53_net/ipc_tx_sched.h), at a
+ * higher priority than the HCI endpoint on the same instance.
+ */
+
+// Time a thread waits for a free TX buffer before a warning, and longest wait for space in the IPC buffer
+#define ESB_RPC_TR_ALLOC_TIMEOUT_MS	100
+#define ESB_RPC_TR_SEND_TIMEOUT_MS	100
+
+typedef struct {
+	uint32_t tx_allocs;
+	uint32_t tx_alloc_waits;		// Allocations that found the pool empty and had to wait
+	uint32_t tx_alloc_timeouts;		// Times an allocation waited ESB_RPC_TR_ALLOC_TIMEOUT_MS, and kept waiting
+	uint32_t tx_pool_min_free;		// Fewest free buffers seen after an allocation
+	uint32_t send_retries;			// Times the IPC buffer was full and a send was retried
+	uint32_t send_failures;
+} esb_rpc_tr_stats_t;
+
+extern const struct nrf_rpc_tr esb_rpc_tr;
+
+void esb_rpc_tr_stats_get(esb_rpc_tr_stats_t *stats);
+
+#endif
@@ -0,0 +1,301 @@
+#include "esb_shm.h"
+#include <zephyr/irq.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/mbox.h>
+#include <zephyr/sys/barrier.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(esb_shm, LOG_LEVEL_INF);
+
+// Identifies the layout of the shared region. Must be changed whenever the layout or the record format changes.
+#define ESB_SHM_MAGIC	0x45534233
+
+// Max records handled per RX work run, before the work queue is given to other items
+#define RX_BATCH_MAX			8
+#define WORKQ_STACK_SIZE		2048
+#define WORKQ_PRIORITY			K_PRIO_PREEMPT(1)
+
+// Record type used to fill the end of the ring when the next record doesn't fit, the consumer skips to the start
+#define REC_TYPE_PAD	0xFFFF
+#define RECORD_SIZE(length) ROUND_UP(sizeof(struct esb_shm_record) + (length), 4)
+
+BUILD_ASSERT((ESB_SHM_RING_SIZE & (ESB_SHM_RING_SIZE - 1)) == 0, "ESB_SHM_RING_SIZE must be a power of two");
+
+/* The head and tail are byte offsets that run freely, and are only masked when a record is accessed.
+ * Records are always 4 byte aligned and never wrap around the end of the ring.
+ */
+struct esb_shm_ring {
+	// Written by the producer only
+	volatile uint32_t head;
+	// Written by the consumer only
+	volatile uint32_t tail;
+	// Set by the consumer when the ring is empty and it wants a doorbell, cleared by the producer when ringing it
+	volatile uint32_t doorbell_armed;
+	uint8_t data[ESB_SHM_RING_SIZE] __aligned(4);
+};
+
+struct esb_shm_area {
+	volatile uint32_t magic;
+	// Written by the network core only. Free running, only the difference to the number of payloads sent is used
+	volatile uint32_t tx_credits_returned;
+	struct esb_shm_ring app_to_net;
+	struct esb_shm_ring net_to_app;
+	struct esb_bench_table bench;
+};
+
+#define ESB_SHM_NODE	DT_NODELABEL(esb_shm)
+#define DOORBELL_NODE	DT_PATH(zephyr_user)
+
+BUILD_ASSERT(sizeof(struct esb_shm_area) <= DT_REG_SIZE(ESB_SHM_NODE), "The esb_shm region is too small");
+
+static struct esb_shm_area *const m_area = (struct esb_shm_area *)DT_REG_ADDR(ESB_SHM_NODE);
+
+#if defined(CONFIG_SOC_NRF5340_CPUAPP)
+#define TX_RING (&m_area->app_to_net)
+#define RX_RING (&m_area->net_to_app)
+#else
+#define TX_RING (&m_area->net_to_app)
+#define RX_RING (&m_area->app_to_net)
+#endif
+
+static const struct mbox_channel m_doorbell_tx = MBOX_DT_CHANNEL_GET(DOORBELL_NODE, esb_tx);
+static const struct mbox_channel m_doorbell_rx = MBOX_DT_CHANNEL_GET(DOORBELL_NODE, esb_rx);
+
+K_THREAD_STACK_DEFINE(m_workq_stack, WORKQ_STACK_SIZE);
+struct k_work_q esb_shm_work_q;
+
+static esb_shm_rx_handler_t m_rx_handler;
+static volatile bool m_rx_stalled;
+static bool m_initialized;
+
+static esb_shm_stats_t m_stats;
+
+static void rx_work_handler(struct k_work *work);
+
+static K_WORK_DEFINE(m_rx_work, rx_work_handler);
+
+static void rx_batch_record(uint32_t count)
+{
+	if (count > 0) {
+		m_stats.batches++;
+		m_stats.records_received += count;
+		if (count > m_stats.batch_max) {
+			m_stats.batch_max = count;
+		}
+	}
+}
+
+static void rx_work_handler(struct k_work *work)
+{
+	struct esb_shm_ring *ring = RX_RING;
+	uint32_t tail = ring->tail;
+	uint32_t count = 0;
+
+	while (1) {
+		while (tail != ring->head) {
+			const struct esb_shm_record *record;
+			uint32_t offset = tail & (ESB_SHM_RING_SIZE - 1);
+
+			if (count == RX_BATCH_MAX) {
+				// Let other work run, and continue with the rest of the ring after it
+				rx_batch_record(count);
+				k_work_submit_to_queue(&esb_shm_work_q, &m_rx_work);
+				return;
+			}
+
+			// Make sure the record is read after the head index that covers it
+			barrier_dmem_fence_full();
+			record = (const struct esb_shm_record *)&ring->data[offset];
+
+			if (record->type == REC_TYPE_PAD) {
+				tail += ESB_SHM_RING_SIZE - offset;
+				ring->tail = tail;
+				continue;
+			}
+			if (record->length > ESB_SHM_DATA_MAX_LENGTH) {
+				// Can only happen if the other core uses a different format, drop everything in the ring
+				LOG_ERR("Invalid record length %i, ring reset", record->length);
+				tail = ring->head;
+				ring->tail = tail;
+				break;
+			}
+
+			// Set before the handler runs, so an esb_shm_rx_resume() while it decides to stall is not lost
+			m_rx_stalled = true;
+			if (m_rx_handler(record) == -EAGAIN) {
+				rx_batch_record(count);
+				return;
+			}
+			m_rx_stalled = false;
+
+			// Don't hand the space back to the producer until the record has been read
+			barrier_dmem_fence_full();
+			tail += RECORD_SIZE(record->length);
+			ring->tail = tail;
+			count++;
+		}
+
+		// Ask for a doorbell, then check again in case a record was added before the producer could see the request
+		ring->doorbell_armed = 1;
+		barrier_dmem_fence_full();
+		if (tail == ring->head) {
+			break;
+		}
+		ring->doorbell_armed = 0;
+	}
+	rx_batch_record(count);
+}
+
+static void doorbell_callback(const struct device *dev, uint32_t channel, void *user_data, struct mbox_msg *data)
+{
+	m_stats.doorbells_received++;
+	k_work_submit_to_queue(&esb_shm_work_q, &m_rx_work);
+}
+
+int esb_shm_init(esb_shm_rx_handler_t rx_handler)
+{
+	int err;
+
+	if (rx_handler == NULL) {
+		return -EINVAL;
+	}
+	m_rx_handler = rx_handler;
+
+	if (m_initialized) {
+		return 0;
+	}
+
+#if defined(CONFIG_SOC_NRF5340_CPUAPP)
+	memset((void *)m_area, 0, sizeof(*m_area));
+	barrier_dmem_fence_full();
+	m_area->magic = ESB_SHM_MAGIC;
+	barrier_dmem_fence_full();
+#else
+	if (m_area->magic != ESB_SHM_MAGIC) {
+		LOG_ERR("Shared memory not initialized by the application core");
+		return -ENODEV;
+	}
+#endif
+
+	k_work_queue_start(&esb_shm_work_q, m_workq_stack, K_THREAD_STACK_SIZEOF(m_workq_stack),
+			   WORKQ_PRIORITY, NULL);
+	k_thread_name_set(&esb_shm_work_q.thread, "esb_shm");
+
+	err = mbox_register_callback(&m_doorbell_rx, doorbell_callback, NULL);
+	if (err) {
+		LOG_ERR("Doorbell callback register error: %d", err);
+		return err;
+	}
+
+	err = mbox_set_enabled(&m_doorbell_rx, true);
+	if (err) {
+		LOG_ERR("Doorbell enable error: %d", err);
+		return err;
+	}
+
+	m_initialized = true;
+
+	// Pick up anything that was put in the ring before the doorbell was enabled, and arm the doorbell
+	k_work_submit_to_queue(&esb_shm_work_q, &m_rx_work);
+
+	LOG_INF("ESB shared memory rings ready at 0x%x", (uint32_t)m_area);
+	return 0;
+}
+
+int esb_shm_send(enum esb_shm_record_type type, const uint8_t *data, uint32_t length)
+{
+	struct esb_shm_ring *ring = TX_RING;
+	struct esb_shm_record *record;
+	bool ring_doorbell = false;
+	uint32_t size = RECORD_SIZE(length);
+	uint32_t head;
+	uint32_t offset;
+	uint32_t to_end;
+	uint32_t needed;
+	uint32_t key;
+
+	if (!m_initialized) {
+		return -EACCES;
+	}
+	if (length > ESB_SHM_DATA_MAX_LENGTH) {
+		return -EINVAL;
+	}
+
+	key = irq_lock();
+	head = ring->head;
+	offset = head & (ESB_SHM_RING_SIZE - 1);
+	to_end = ESB_SHM_RING_SIZE - offset;
+
+	// A record that doesn't fit before the end of the ring goes at the start, after a pad record
+	needed = (to_end < size) ? (to_end + size) : size;
+	if ((ESB_SHM_RING_SIZE - (head - ring->tail)) < needed) {
+		m_stats.send_ring_full++;
+		irq_unlock(key);
+		return -ENOMEM;
+	}
+
+	if (to_end < size) {
+		record = (struct esb_shm_record *)&ring->data[offset];
+		record->type = REC_TYPE_PAD;
+		record->length = 0;
+		head += to_end;
+		offset = 0;
+	}
+
+	record = (struct esb_shm_record *)&ring->data[offset];
+	record->type = type;
+	record->length = length;
+	if (length > 0) {
+		memcpy(record->data, data, length);
+	}
+
+	// Publish the record before the new head, and read the doorbell request after it
+	barrier_dmem_fence_full();
+	ring->head = head + size;
+	barrier_dmem_fence_full();
+
+	m_stats.records_sent++;
+	if (ring->doorbell_armed) {
+		ring->doorbell_armed = 0;
+		ring_doorbell = true;
+		m_stats.doorbells_sent++;
+	}
+	irq_unlock(key);
+
+	if (ring_doorbell) {
+		mbox_send(&m_doorbell_tx, NULL);
+	}
+	return 0;
+}
+
+void esb_shm_tx_credits_return(uint32_t count)
+{
+	uint32_t key = irq_lock();
+	m_area->tx_credits_returned += count;
+	irq_unlock(key);
+}
+
+uint32_t esb_shm_tx_credits_returned(void)
+{
+	return m_area->tx_credits_returned;
+}
+
+void esb_shm_rx_resume(void)
+{
+	if (m_rx_stalled) {
+		m_rx_stalled = false;
+		k_work_submit_to_queue(&esb_shm_work_q, &m_rx_work);
+	}
+}
+
+void esb_shm_stats_get(esb_shm_stats_t *stats)
+{
+	uint32_t key = irq_lock();
+	*stats = m_stats;
+	irq_unlock(key);
+}
+
+struct esb_bench_table *esb_shm_bench_table(void)
+{
+	return &m_area->bench;
+}
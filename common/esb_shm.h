@@ -0,0 +1,79 @@
+#ifndef __ESB_SHM_H
+#define __ESB_SHM_H
+
+#include <zephyr/kernel.h>
+#include <esb_rpc_ids.h>
+#include "esb_bench.h"
+
+/* ESB data path between the nRF5340 application and network cores.
+ *
+ * TX payloads and ESB events are passed through a pair of single producer, single consumer rings placed in a
+ * dedicated region of the shared SRAM (the esb_shm node in the devicetree), one ring in each direction.
+ * The producer signals the other core through an mbox doorbell, but only if the consumer has run out of
+ * records and is waiting for more, so under load many records are handed over per interrupt.
+ * nRF RPC is only used for control calls, such as app_esb_init.
+ *
+ * The application core owns the shared region and resets it in esb_shm_init(). The network core attaches to
+ * the region when the application core asks it to initialize ESB, at which point the region is set up.
+ */
+
+// Size of each ring in bytes. Records are variable length, so the number of records that fit depends on the payloads.
+#define ESB_SHM_RING_SIZE		4096
+#define ESB_SHM_DATA_MAX_LENGTH	32
+
+#define ESB_SHM_REC_ENUM(name) ESB_SHM_REC_##name,
+
+// The record types and their contents are defined in esb_rpc_ids.h
+enum esb_shm_record_type {
+	ESB_SHM_RECORD_TYPES(ESB_SHM_REC_ENUM)
+};
+
+/* A record in the ring is a 4 byte header followed by the used payload bytes only, padded to 4 bytes */
+struct esb_shm_record {
+	uint16_t type;
+	uint16_t length;
+	uint8_t data[];
+};
+
+typedef struct {
+	uint32_t records_sent;
+	uint32_t records_received;
+	uint32_t send_ring_full;		// esb_shm_send() calls that failed because the ring to the other core was full
+	uint32_t doorbells_sent;
+	uint32_t doorbells_received;
+	uint32_t batches;				// RX work runs that processed at least one record
+	uint32_t batch_max;				// Most records processed in one RX work run
+} esb_shm_stats_t;
+
+/* Work queue reading the ring from the other core. Work related to the rings can be put on it as well. */
+extern struct k_work_q esb_shm_work_q;
+
+/* Called from esb_shm_work_q for every record received from the other core.
+ * Return 0 when the record has been consumed, or -EAGAIN to leave it in the ring and stop reading until
+ * esb_shm_rx_resume() is called.
+ */
+typedef int (*esb_shm_rx_handler_t)(const struct esb_shm_record *record);
+
+int esb_shm_init(esb_shm_rx_handler_t rx_handler);
+
+/* Put a record in the ring to the other core. Returns -ENOMEM if the ring is full.
+ * Can be called from any context, but only from one core.
+ */
+int esb_shm_send(enum esb_shm_record_type type, const uint8_t *data, uint32_t length);
+
+/* TX credits. The network core returns a credit for every TX payload it is done with, and the application core
+ * compares the number of credits returned with the number of payloads it has sent. The count is kept in the
+ * shared region rather than sent as records, so credits can't be lost when the event ring is full.
+ */
+void esb_shm_tx_credits_return(uint32_t count);
+uint32_t esb_shm_tx_credits_returned(void);
+
+/* Restart reading records after the RX handler returned -EAGAIN */
+void esb_shm_rx_resume(void);
+
+void esb_shm_stats_get(esb_shm_stats_t *stats);
+
+/* The esb_bench time stamp table, kept in the shared region so both cores can stamp packets */
+struct esb_bench_table *esb_shm_bench_table(void);
+
+#endif
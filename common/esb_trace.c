@@ -0,0 +1,225 @@
+#include "esb_trace.h"
+#include "app_esb.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(CONFIG_SHELL)
+#include <zephyr/shell/shell.h>
+#endif
+
+static esb_trace_record_t m_records[ESB_TRACE_RECORDS];
+static uint32_t m_head;			// Index of the oldest record
+static uint32_t m_count;
+static uint32_t m_overwritten;
+static uint32_t m_last_cyc;
+static volatile bool m_enabled;
+
+static void record_append(const esb_trace_record_t *record)
+{
+	if (m_count == ESB_TRACE_RECORDS) {
+		m_head = (m_head + 1) % ESB_TRACE_RECORDS;
+		m_count--;
+		m_overwritten++;
+	}
+	m_records[(m_head + m_count) % ESB_TRACE_RECORDS] = *record;
+	m_count++;
+}
+
+void esb_trace_send(uint32_t length, int result)
+{
+	esb_trace_record_t record;
+	uint32_t now;
+	uint32_t key;
+
+	if (!m_enabled) {
+		return;
+	}
+
+	key = irq_lock();
+	now = k_cycle_get_32();
+	record = (esb_trace_record_t){
+		.delta_us = (m_count + m_overwritten > 0) ? k_cyc_to_us_floor32(now - m_last_cyc) : 0,
+		.length = (uint8_t)length,
+		.result = (result == 0) ? 0 : 1,
+		.backlog = (uint16_t)MIN(app_esb_tx_backlog_get(), UINT16_MAX),
+	};
+	m_last_cyc = now;
+	record_append(&record);
+	irq_unlock(key);
+}
+
+void esb_trace_enable(bool enable)
+{
+	if (enable && !m_enabled) {
+		esb_trace_clear();
+	}
+	m_enabled = enable;
+}
+
+bool esb_trace_enabled(void)
+{
+	return m_enabled;
+}
+
+void esb_trace_clear(void)
+{
+	uint32_t key = irq_lock();
+
+	m_head = 0;
+	m_count = 0;
+	m_overwritten = 0;
+	irq_unlock(key);
+}
+
+uint32_t esb_trace_count(uint32_t *overwritten)
+{
+	if (overwritten != NULL) {
+		*overwritten = m_overwritten;
+	}
+	return m_count;
+}
+
+int esb_trace_get(uint32_t index, esb_trace_record_t *record)
+{
+	uint32_t key = irq_lock();
+
+	if (index >= m_count) {
+		irq_unlock(key);
+		return -EINVAL;
+	}
+	*record = m_records[(m_head + index) % ESB_TRACE_RECORDS];
+	irq_unlock(key);
+	return 0;
+}
+
+int esb_trace_put(const esb_trace_record_t *record)
+{
+	if (m_enabled) {
+		return -EBUSY;
+	}
+	if (m_count == ESB_TRACE_RECORDS) {
+		return -ENOMEM;
+	}
+	record_append(record);
+	return 0;
+}
+
+int esb_trace_format(const esb_trace_record_t *record, char *buf, size_t size)
+{
+	return snprintf(buf, size, "%u,%u,%u,%u", record->delta_us, record->length, record->result, record->backlog);
+}
+
+int esb_trace_parse(const char *line, esb_trace_record_t *record)
+{
+	unsigned long fields[4] = {0};
+	const char *p = line;
+	char *end;
+	int count = 0;
+
+	while (*p == ' ' || *p == '\t') {
+		p++;
+	}
+	if (*p == '\0' || *p == '\n' || *p == '\r' || *p == '#') {
+		return -ENODATA;
+	}
+
+	while (count < ARRAY_SIZE(fields)) {
+		fields[count++] = strtoul(p, &end, 10);
+		if (end == p) {
+			return -EINVAL;
+		}
+		p = end;
+		if (*p != ',') {
+			break;
+		}
+		p++;
+	}
+	if (count < 2 || fields[1] == 0 || fields[1] > sizeof(((app_esb_data_t *)0)->data)) {
+		return -EINVAL;
+	}
+
+	*record = (esb_trace_record_t){
+		.delta_us = fields[0],
+		.length = fields[1],
+		.result = fields[2] ? 1 : 0,
+		.backlog = MIN(fields[3], UINT16_MAX),
+	};
+	return 0;
+}
+
+#if defined(CONFIG_SHELL)
+static int cmd_esb_trace_start(const struct shell *sh, size_t argc, char **argv)
+{
+	esb_trace_enable(true);
+	shell_print(sh, "Capture started, %u records", ESB_TRACE_RECORDS);
+	return 0;
+}
+
+static int cmd_esb_trace_stop(const struct shell *sh, size_t argc, char **argv)
+{
+	esb_trace_enable(false);
+	shell_print(sh, "Capture stopped, %u records", esb_trace_count(NULL));
+	return 0;
+}
+
+static int cmd_esb_trace_status(const struct shell *sh, size_t argc, char **argv)
+{
+	uint32_t overwritten;
+	uint32_t count = esb_trace_count(&overwritten);
+
+	shell_print(sh, "Capture %s, %u records, %u overwritten", m_enabled ? "running" : "stopped", count,
+		    overwritten);
+	return 0;
+}
+
+static int cmd_esb_trace_dump(const struct shell *sh, size_t argc, char **argv)
+{
+	esb_trace_record_t record;
+	char line[ESB_TRACE_LINE_MAX];
+
+	shell_print(sh, ESB_TRACE_HEADER);
+	for (uint32_t i = 0; esb_trace_get(i, &record) == 0; i++) {
+		esb_trace_format(&record, line, sizeof(line));
+		shell_print(sh, "%s", line);
+	}
+	return 0;
+}
+
+static int cmd_esb_trace_clear(const struct shell *sh, size_t argc, char **argv)
+{
+	esb_trace_clear();
+	return 0;
+}
+
+/* Load records from the host, several per command to keep the number of commands down */
+static int cmd_esb_trace_put(const struct shell *sh, size_t argc, char **argv)
+{
+	esb_trace_record_t record;
+	int err;
+
+	for (size_t i = 1; i < argc; i++) {
+		err = esb_trace_parse(argv[i], &record);
+		if (err == 0) {
+			err = esb_trace_put(&record);
+		}
+		if (err) {
+			shell_error(sh, "Record '%s' not added (err %d)", argv[i], err);
+			return err;
+		}
+	}
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_esb_trace,
+	SHELL_CMD(start, NULL, "Clear the records and start capturing app_esb_send() calls", cmd_esb_trace_start),
+	SHELL_CMD(stop, NULL, "Stop capturing", cmd_esb_trace_stop),
+	SHELL_CMD(status, NULL, "Print the capture state and number of records", cmd_esb_trace_status),
+	SHELL_CMD(dump, NULL, "Print the records, oldest first", cmd_esb_trace_dump),
+	SHELL_CMD(clear, NULL, "Remove all records", cmd_esb_trace_clear),
+	SHELL_CMD_ARG(put, NULL, "Append records: <delta_us,length[,result,backlog]>...", cmd_esb_trace_put, 2, 15),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(esb_trace, &sub_esb_trace, "ESB send trace capture", NULL);
+#endif
@@ -0,0 +1,60 @@
+#ifndef __ESB_TRACE_H
+#define __ESB_TRACE_H
+
+#include <zephyr/kernel.h>
+
+/* Capture of the app_esb_send() calls made by the application, for replaying recorded traffic.
+ *
+ * While capture is enabled every call is recorded in a RAM ring with the time since the previous call, the
+ * payload length, whether the payload was accepted and the TX backlog after the call. When the ring is full the
+ * oldest records are overwritten. The capture can be dumped and loaded in a text format, one record per line:
+ *
+ *   delta_us,length,result,backlog
+ *
+ * where result is 0 for an accepted payload and 1 for a payload rejected because the TX queue was full. Only the
+ * first two fields are needed to replay a trace. Lines starting with '#' are comments. The same format is read by
+ * the timeslot simulator, so captures from the field can be used as benchmarks on the host.
+ *
+ * With CONFIG_SHELL enabled the capture is controlled with the 'esb_trace' shell command. Recording costs a single
+ * check of the enabled flag when capture is off.
+ */
+
+#define ESB_TRACE_RECORDS		1024
+#define ESB_TRACE_LINE_MAX		32
+#define ESB_TRACE_HEADER		"# esb_trace v1: delta_us,length,result,backlog"
+
+typedef struct {
+	uint32_t delta_us;			// Since the previous record, 0 for the first one
+	uint8_t length;
+	uint8_t result;				// 0 accepted, 1 rejected
+	uint16_t backlog;			// TX payloads waiting after the call
+} esb_trace_record_t;
+
+/* Called by app_esb_send() with its return value */
+void esb_trace_send(uint32_t length, int result);
+
+/* Start or stop the capture. Starting clears the records of the previous capture. */
+void esb_trace_enable(bool enable);
+
+bool esb_trace_enabled(void);
+
+void esb_trace_clear(void);
+
+/* Number of records in the ring, and the number of older records that were overwritten */
+uint32_t esb_trace_count(uint32_t *overwritten);
+
+/* Get a record, with index 0 being the oldest. Returns -EINVAL if there is no such record. */
+int esb_trace_get(uint32_t index, esb_trace_record_t *record);
+
+/* Append a record, for loading a trace recorded elsewhere. Returns -ENOMEM when the ring is full, or -EBUSY
+ * while capture is running.
+ */
+int esb_trace_put(const esb_trace_record_t *record);
+
+/* Text format of a record, see above. esb_trace_parse() returns -ENODATA for comment and empty lines, and
+ * -EINVAL for lines that aren't a record.
+ */
+int esb_trace_format(const esb_trace_record_t *record, char *buf, size_t size);
+int esb_trace_parse(const char *line, esb_trace_record_t *record);
+
+#endif
@@ -0,0 +1,13 @@
+#include "log_ratelimit.h"
+
+static atomic_t m_suppressed;
+
+uint32_t log_ratelimit_suppressed_get(void)
+{
+	return (uint32_t)atomic_get(&m_suppressed);
+}
+
+void log_ratelimit_suppressed_add(void)
+{
+	atomic_inc(&m_suppressed);
+}
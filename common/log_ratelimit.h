@@ -0,0 +1,77 @@
+#ifndef __LOG_RATELIMIT_H
+#define __LOG_RATELIMIT_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+/* Rate limited logging for the packet paths.
+ *
+ * LOG_RATELIMIT_ERR/WRN/INF/DBG(interval_ms, fmt, ...) log at most one message per interval from each call site.
+ * The messages suppressed in between are counted, and the count is appended to the next message that gets
+ * through, so nothing goes unnoticed. Call sites below the log level of the module cost nothing, and a suppressed
+ * message costs a time check, with no formatting or log buffer use. Can be used from any context, including the
+ * radio interrupt.
+ *
+ * The format strings are kept as string literals, so the messages work with dictionary based logging, see
+ * overlay-dictionary-log.conf in the projects.
+ */
+
+#define LOG_RATELIMIT_DEFAULT_MS	1000
+
+struct log_ratelimit {
+	uint32_t last_ms;
+	uint32_t suppressed;
+	bool logged;
+};
+
+/* Suppressed messages, over all call sites since boot */
+uint32_t log_ratelimit_suppressed_get(void);
+
+void log_ratelimit_suppressed_add(void);
+
+static inline bool log_ratelimit_pass(struct log_ratelimit *rl, uint32_t interval_ms, uint32_t *suppressed)
+{
+	uint32_t now = k_uptime_get_32();
+	uint32_t key = irq_lock();
+	bool pass = !rl->logged || (now - rl->last_ms) >= interval_ms;
+
+	if (pass) {
+		*suppressed = rl->suppressed;
+		rl->suppressed = 0;
+		rl->last_ms = now;
+		rl->logged = true;
+	} else {
+		rl->suppressed++;
+	}
+	irq_unlock(key);
+
+	if (!pass) {
+		log_ratelimit_suppressed_add();
+	}
+	return pass;
+}
+
+#define LOG_RATELIMIT_IMPL(_level, _log_macro, _interval_ms, _fmt, ...)						\
+	do {													\
+		static struct log_ratelimit _rl;								\
+		uint32_t _suppressed;										\
+														\
+		if ((_level) <= __log_level && log_ratelimit_pass(&_rl, (_interval_ms), &_suppressed)) {	\
+			if (_suppressed > 0) {									\
+				_log_macro(_fmt " (%u suppressed)", ##__VA_ARGS__, _suppressed);		\
+			} else {										\
+				_log_macro(_fmt, ##__VA_ARGS__);						\
+			}											\
+		}												\
+	} while (0)
+
+#define LOG_RATELIMIT_ERR(_interval_ms, _fmt, ...) \
+	LOG_RATELIMIT_IMPL(LOG_LEVEL_ERR, LOG_ERR, _interval_ms, _fmt, ##__VA_ARGS__)
+#define LOG_RATELIMIT_WRN(_interval_ms, _fmt, ...) \
+	LOG_RATELIMIT_IMPL(LOG_LEVEL_WRN, LOG_WRN, _interval_ms, _fmt, ##__VA_ARGS__)
+#define LOG_RATELIMIT_INF(_interval_ms, _fmt, ...) \
+	LOG_RATELIMIT_IMPL(LOG_LEVEL_INF, LOG_INF, _interval_ms, _fmt, ##__VA_ARGS__)
+#define LOG_RATELIMIT_DBG(_interval_ms, _fmt, ...) \
+	LOG_RATELIMIT_IMPL(LOG_LEVEL_DBG, LOG_DBG, _interval_ms, _fmt, ##__VA_ARGS__)
+
+#endif
@@ -0,0 +1,219 @@
+#include "timeslot_analytics.h"
+#include "timeslot_handler.h"
+#include <zephyr/irq.h>
+#include <string.h>
+
+#if defined(CONFIG_SHELL)
+#include <zephyr/shell/shell.h>
+#endif
+
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(timeslot_analytics, LOG_LEVEL_INF);
+
+const uint32_t timeslot_analytics_slot_length_bounds_us[TIMESLOT_ANALYTICS_HIST_BUCKETS] = {
+	10000, 20000, 50000, 100000, 200000, 500000, 1000000, UINT32_MAX
+};
+
+const uint32_t timeslot_analytics_gap_bounds_us[TIMESLOT_ANALYTICS_HIST_BUCKETS] = {
+	1000, 2000, 5000, 10000, 20000, 50000, 100000, UINT32_MAX
+};
+
+const uint32_t timeslot_analytics_extension_streak_bounds[TIMESLOT_ANALYTICS_HIST_BUCKETS] = {
+	0, 1, 2, 4, 8, 16, 32, UINT32_MAX
+};
+
+static timeslot_analytics_t m_analytics;
+
+// Kept as 64 bit ticks, 32 bit microseconds overflow after 71 minutes
+static int64_t m_start_ticks;
+static uint32_t m_slot_start_cyc;
+static uint32_t m_gap_start_cyc;
+static uint32_t m_extension_streak;
+static bool m_in_slot;
+static bool m_in_gap;
+static timeslot_loss_reason_t m_gap_reason = TS_LOSS_OTHER;
+
+static void histogram_add(uint32_t *hist, const uint32_t *bounds, uint32_t value)
+{
+	for (int i = 0; i < TIMESLOT_ANALYTICS_HIST_BUCKETS - 1; i++) {
+		if (value <= bounds[i]) {
+			hist[i]++;
+			return;
+		}
+	}
+	hist[TIMESLOT_ANALYTICS_HIST_BUCKETS - 1]++;
+}
+
+void timeslot_analytics_slot_start(void)
+{
+	uint32_t now = k_cycle_get_32();
+
+	if (m_in_gap) {
+		// Gaps can be long while no client has demand
+		uint64_t gap_us = k_cyc_to_us_floor64(now - m_gap_start_cyc);
+
+		histogram_add(m_analytics.gap_hist, timeslot_analytics_gap_bounds_us, (uint32_t)MIN(gap_us, UINT32_MAX));
+		m_analytics.loss_gap_us[m_gap_reason] += gap_us;
+		m_in_gap = false;
+	}
+
+	m_in_slot = true;
+	m_slot_start_cyc = now;
+	m_extension_streak = 0;
+	m_analytics.slots++;
+}
+
+void timeslot_analytics_extension(bool succeeded)
+{
+	if (succeeded) {
+		m_extension_streak++;
+		m_analytics.extensions_succeeded++;
+	}
+}
+
+void timeslot_analytics_slot_end(timeslot_loss_reason_t reason)
+{
+	uint32_t now = k_cycle_get_32();
+	uint32_t slot_us;
+
+	if (!m_in_slot) {
+		return;
+	}
+	m_in_slot = false;
+
+	slot_us = k_cyc_to_us_floor32(now - m_slot_start_cyc);
+	m_analytics.granted_us += slot_us;
+	histogram_add(m_analytics.slot_length_hist, timeslot_analytics_slot_length_bounds_us, slot_us);
+	histogram_add(m_analytics.extension_streak_hist, timeslot_analytics_extension_streak_bounds,
+		      m_extension_streak);
+
+	m_analytics.loss_count[reason]++;
+	m_gap_reason = reason;
+	m_gap_start_cyc = now;
+	m_in_gap = true;
+}
+
+void timeslot_analytics_request_failed(timeslot_loss_reason_t reason)
+{
+	m_analytics.loss_count[reason]++;
+	m_gap_reason = reason;
+	if (!m_in_gap) {
+		m_gap_start_cyc = k_cycle_get_32();
+		m_in_gap = true;
+	}
+}
+
+void timeslot_analytics_get(timeslot_analytics_t *analytics)
+{
+	uint32_t key = irq_lock();
+	uint32_t now = k_cycle_get_32();
+
+	*analytics = m_analytics;
+	analytics->total_us = k_ticks_to_us_floor64(k_uptime_ticks() - m_start_ticks);
+	// Include the running timeslot in the granted time
+	if (m_in_slot) {
+		analytics->granted_us += k_cyc_to_us_floor64(now - m_slot_start_cyc);
+	}
+	irq_unlock(key);
+}
+
+void timeslot_analytics_reset(void)
+{
+	uint32_t key = irq_lock();
+	uint32_t now = k_cycle_get_32();
+
+	memset(&m_analytics, 0, sizeof(m_analytics));
+	m_start_ticks = k_uptime_ticks();
+	if (m_in_slot) {
+		m_slot_start_cyc = now;
+		m_extension_streak = 0;
+	}
+	if (m_in_gap) {
+		m_gap_start_cyc = now;
+	}
+	irq_unlock(key);
+}
+
+static int analytics_init(void)
+{
+	m_start_ticks = k_uptime_ticks();
+	return 0;
+}
+
+SYS_INIT(analytics_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#if defined(CONFIG_SHELL)
+static const char *const loss_reason_names[TS_LOSS_REASON_COUNT] = {
+	"extend_failed", "overstayed", "blocked", "cancelled", "idle", "other"
+};
+
+static void print_histogram(const struct shell *sh, const char *name, const uint32_t *hist,
+			    const uint32_t *bounds)
+{
+	shell_print(sh, "%s:", name);
+	for (int i = 0; i < TIMESLOT_ANALYTICS_HIST_BUCKETS; i++) {
+		if (bounds[i] == UINT32_MAX) {
+			shell_print(sh, "  >%u: %u", bounds[i - 1], hist[i]);
+		} else {
+			shell_print(sh, "  <=%u: %u", bounds[i], hist[i]);
+		}
+	}
+}
+
+static int cmd_timeslot_stats(const struct shell *sh, size_t argc, char **argv)
+{
+	timeslot_analytics_t analytics;
+	timeslot_stats_t stats;
+	uint32_t permille;
+
+	timeslot_analytics_get(&analytics);
+	timeslot_handler_stats_get(&stats);
+
+	permille = analytics.total_us ? (uint32_t)((analytics.granted_us * 1000) / analytics.total_us) : 0;
+	shell_print(sh, "Radio time granted: %llu of %llu us (%u.%u %%)", analytics.granted_us,
+		    analytics.total_us, permille / 10, permille % 10);
+	shell_print(sh, "Timeslots: %u, extensions: %u", analytics.slots, analytics.extensions_succeeded);
+
+	print_histogram(sh, "Timeslot length (us)", analytics.slot_length_hist,
+			timeslot_analytics_slot_length_bounds_us);
+	print_histogram(sh, "Gap between timeslots (us)", analytics.gap_hist,
+			timeslot_analytics_gap_bounds_us);
+	print_histogram(sh, "Extensions per timeslot", analytics.extension_streak_hist,
+			timeslot_analytics_extension_streak_bounds);
+
+	shell_print(sh, "Losses (count, gap us):");
+	for (int i = 0; i < TS_LOSS_REASON_COUNT; i++) {
+		shell_print(sh, "  %s: %u, %llu", loss_reason_names[i], analytics.loss_count[i],
+			    analytics.loss_gap_us[i]);
+	}
+
+	shell_print(sh, "Requests normal/high: %u/%u, escalations: %u (queue %u, age %u, blocked %u), forced normal: %u",
+		    stats.requests_normal, stats.requests_high, stats.escalations, stats.escalations_queue,
+		    stats.escalations_age, stats.escalations_blocked, stats.forced_normal);
+	shell_print(sh, "Slots high prio: %u, high prio time: %llu us, budget used up: %u, drop backs: %u",
+		    stats.slots_started_high, stats.high_prio_time_us, stats.high_capped, stats.high_drop_backs);
+	shell_print(sh, "BLE connection events: %u, missed: %u, client switches: %u",
+		    stats.ble_events, stats.ble_events_missed, stats.client_switches);
+	shell_print(sh, "Re-requests: %u, latency last/max/avg: %u/%u/%u us, coalesced: %u, idle ends: %u",
+		    stats.rerequests, stats.rerequest_latency_last_us, stats.rerequest_latency_max_us,
+		    stats.rerequests ? (uint32_t)(stats.rerequest_latency_total_us / stats.rerequests) : 0,
+		    stats.requests_coalesced, stats.idle_ends);
+	return 0;
+}
+
+static int cmd_timeslot_reset(const struct shell *sh, size_t argc, char **argv)
+{
+	timeslot_analytics_reset();
+	shell_print(sh, "Timeslot analytics reset");
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_timeslot,
+	SHELL_CMD(stats, NULL, "Print timeslot utilization and statistics", cmd_timeslot_stats),
+	SHELL_CMD(reset, NULL, "Reset timeslot analytics", cmd_timeslot_reset),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(timeslot, &sub_timeslot, "Timeslot handler commands", NULL);
+#endif
@@ -0,0 +1,54 @@
+#ifndef __TIMESLOT_ANALYTICS_H
+#define __TIMESLOT_ANALYTICS_H
+
+#include <zephyr/kernel.h>
+
+#define TIMESLOT_ANALYTICS_HIST_BUCKETS 8
+
+/* Reasons why the radio was not available for the timeslot clients.
+ * EXTEND_FAILED and OVERSTAYED end a running timeslot, while BLOCKED and CANCELLED prevent
+ * a requested timeslot from starting. IDLE is a timeslot ended because none of the clients had demand.
+ * The gap until the next timeslot starts is attributed to the last reason seen.
+ */
+typedef enum {
+	TS_LOSS_EXTEND_FAILED,
+	TS_LOSS_OVERSTAYED,
+	TS_LOSS_BLOCKED,
+	TS_LOSS_CANCELLED,
+	TS_LOSS_IDLE,
+	TS_LOSS_OTHER,
+	TS_LOSS_REASON_COUNT
+} timeslot_loss_reason_t;
+
+typedef struct {
+	// Wall time covered by the analytics, and how much of it was spent inside a timeslot
+	uint64_t total_us;
+	uint64_t granted_us;
+	uint32_t slots;
+	uint32_t extensions_succeeded;
+
+	// Histograms, bucket i counts values up to and including the matching bounds entry.
+	// The last bucket counts everything above the second to last bound.
+	uint32_t slot_length_hist[TIMESLOT_ANALYTICS_HIST_BUCKETS];
+	uint32_t gap_hist[TIMESLOT_ANALYTICS_HIST_BUCKETS];
+	uint32_t extension_streak_hist[TIMESLOT_ANALYTICS_HIST_BUCKETS];
+
+	uint32_t loss_count[TS_LOSS_REASON_COUNT];
+	uint64_t loss_gap_us[TS_LOSS_REASON_COUNT];
+} timeslot_analytics_t;
+
+// Bucket bounds for the histograms
+extern const uint32_t timeslot_analytics_slot_length_bounds_us[TIMESLOT_ANALYTICS_HIST_BUCKETS];
+extern const uint32_t timeslot_analytics_gap_bounds_us[TIMESLOT_ANALYTICS_HIST_BUCKETS];
+extern const uint32_t timeslot_analytics_extension_streak_bounds[TIMESLOT_ANALYTICS_HIST_BUCKETS];
+
+/* Recording functions, called by the timeslot handler from the MPSL timeslot callback */
+void timeslot_analytics_slot_start(void);
+void timeslot_analytics_extension(bool succeeded);
+void timeslot_analytics_slot_end(timeslot_loss_reason_t reason);
+void timeslot_analytics_request_failed(timeslot_loss_reason_t reason);
+
+void timeslot_analytics_get(timeslot_analytics_t *analytics);
+void timeslot_analytics_reset(void);
+
+#endif
@@ -1,11 +1,12 @@
 #include <zephyr/kernel.h>
 #include "timeslot_handler.h"
+#include "timeslot_analytics.h"
 #include <zephyr/irq.h>
-#include <zephyr/sys/ring_buffer.h>
 #include <hal/nrf_timer.h>
 
 #include <mpsl_timeslot.h>
 #include <mpsl.h>
+#include <mpsl/mpsl_work.h>
 
 #include <zephyr/logging/log.h>
 
@@ -15,25 +16,81 @@ LOG_MODULE_REGISTER(timeslot, LOG_LEVEL_INF);
 #define TIMESLOT_LENGTH_US           10000
 #define TIMESLOT_EXT_MARGIN_MARGIN	 1000
 #define TIMESLOT_REQ_EARLIEST_MARGIN 100
-#define TIMER_EXPIRY_US_EARLY 		 (TIMESLOT_LENGTH_US - MPSL_TIMESLOT_EXTENSION_MARGIN_MIN_US - TIMESLOT_EXT_MARGIN_MARGIN)
-#define TIMER_EXPIRY_REQ			 (TIMESLOT_LENGTH_US - MPSL_TIMESLOT_EXTENSION_MARGIN_MIN_US - TIMESLOT_REQ_EARLIEST_MARGIN)
+#define TIMER_EXPIRY_US_EARLY(len)	 ((len) - MPSL_TIMESLOT_EXTENSION_MARGIN_MIN_US - TIMESLOT_EXT_MARGIN_MARGIN)
+#define TIMER_EXPIRY_REQ(len)		 ((len) - MPSL_TIMESLOT_EXTENSION_MARGIN_MIN_US - TIMESLOT_REQ_EARLIEST_MARGIN)
+
+// Priority escalation thresholds. Crossing any of these raises the next timeslot request to HIGH priority,
+// which then stays until the backlog is below the release thresholds
+#define ESCALATE_QUEUE_PERCENT       75
+#define ESCALATE_PACKET_AGE_US       50000
+#define ESCALATE_BLOCKED_COUNT       3
+#define RELEASE_QUEUE_PERCENT        25
+#define RELEASE_PACKET_AGE_US        20000
+// HIGH priority timeslots preempt BLE events, and may take at most ESCALATE_HIGH_MAX_PERCENT of the time averaged
+// over ESCALATE_WINDOW_US. When the budget runs out the escalated timeslot is not extended any further, and the
+// requests drop back to NORMAL priority until ESCALATE_HIGH_RESUME_PERCENT of the budget has built up again.
+#define ESCALATE_WINDOW_US           200000
+#define ESCALATE_HIGH_MAX_PERCENT    25
+#define ESCALATE_HIGH_RESUME_PERCENT 50
+#define HIGH_BUDGET_MAX_US           ((ESCALATE_WINDOW_US * ESCALATE_HIGH_MAX_PERCENT) / 100)
 
-#define MPSL_THREAD_PRIO             CONFIG_MPSL_THREAD_COOP_PRIO
-#define STACKSIZE                    CONFIG_MAIN_STACK_SIZE
-
-static timeslot_callback_t m_callback;
 static volatile bool m_in_timeslot = false;
 
-// Declare the RADIO IRQ handler to supress warning
-void RADIO_IRQHandler(void);
+// Registered timeslot clients, and the client currently given the radio
+static sys_slist_t m_clients = SYS_SLIST_STATIC_INIT(&m_clients);
+static struct timeslot_client *m_active_client;
+static uint32_t m_client_start_cyc;
+
+// Requested timeslot length, the longest of the default length and the length needed by any client
+static uint32_t m_default_slot_length_us = TIMESLOT_LENGTH_US;
+static uint32_t m_slot_length_us = TIMESLOT_LENGTH_US;
+// Length of the running timeslot and its extensions, and the end of the timeslot in TIMER0 time
+static uint32_t m_cur_slot_length_us;
+static uint32_t m_slot_end_us;
+static bool m_period_shared;
+
+enum escalation_reason {
+	ESCALATE_NONE,
+	ESCALATE_QUEUE,
+	ESCALATE_AGE,
+	ESCALATE_BLOCKED
+};
+
+static bool m_escalated;
+static bool m_slot_escalated;
+static uint32_t m_blocked_in_a_row;
+static uint32_t m_slot_start_cyc;
+
+// HIGH priority time left in the duty cycle budget, negative when overdrawn by the last escalated timeslot
+static int32_t m_high_budget_us = HIGH_BUDGET_MAX_US;
+static uint32_t m_high_budget_cyc;
+static bool m_high_capped;
+
+static timeslot_stats_t m_stats;
+
+// MPSL API calls requested by the timeslot handler. Pending calls are kept as bits in a single atomic
+// variable, so that repeated requests collapse into one call and scheduling never fails.
+#define REQ_OPEN_SESSION             BIT(0)
+#define REQ_MAKE_REQUEST             BIT(1)
+#define REQ_CLOSE_SESSION            BIT(2)
 
-// Requests and callbacks to be run serialized from an SWI interrupt
-enum mpsl_timeslot_call {
-	REQ_OPEN_SESSION,
-	REQ_MAKE_REQUEST,
-	REQ_CLOSE_SESSION
+static atomic_t m_pending_calls = ATOMIC_INIT(0);
+
+// No timeslots are requested or extended while none of the clients has demand
+enum request_state {
+	REQUEST_STATE_ACTIVE,
+	REQUEST_STATE_ENDING,	// The timeslot was ended for lack of demand, waiting for the session to go idle
+	REQUEST_STATE_IDLE,
 };
 
+static atomic_t m_request_state = ATOMIC_INIT(REQUEST_STATE_ACTIVE);
+
+static mpsl_timeslot_session_id_t m_session_id = 0xFFu;
+
+// Time the last timeslot was lost, used to measure how long it takes to get a new request pending with MPSL
+static volatile uint32_t m_slot_lost_cyc;
+static volatile bool m_slot_lost_pending;
+
 // Timeslot request
 static mpsl_timeslot_request_t timeslot_request_earliest = {
 	.request_type = MPSL_TIMESLOT_REQ_TYPE_EARLIEST,
@@ -45,39 +102,322 @@ static mpsl_timeslot_request_t timeslot_request_earliest = {
 
 static mpsl_timeslot_signal_return_param_t signal_callback_return_param;
 
-// Message queue for requesting MPSL API calls to non-preemptible thread
-K_MSGQ_DEFINE(mpsl_api_msgq, sizeof(enum mpsl_timeslot_call), 10, 4);
+static void mpsl_api_work_handler(struct k_work *work);
+
+static K_WORK_DEFINE(m_mpsl_api_work, mpsl_api_work_handler);
 
-static void schedule_request(enum mpsl_timeslot_call call)
+static void schedule_request(atomic_val_t call)
 {
-	int err;
-	enum mpsl_timeslot_call api_call = call;
-	err = k_msgq_put(&mpsl_api_msgq, &api_call, K_NO_WAIT);
-	if (err) {
-		LOG_ERR("Message sent error: %d", err);
-		k_oops();
+	atomic_val_t pending = atomic_or(&m_pending_calls, call);
+
+	if (pending & call) {
+		// The same call is already pending, no need to do it twice
+		m_stats.requests_coalesced++;
+		return;
+	}
+
+	mpsl_work_submit(&m_mpsl_api_work);
+}
+
+/* Called when a timeslot is lost to BLE, and a new one has to be requested from outside the timeslot callback */
+static void schedule_rerequest(void)
+{
+	if (!m_slot_lost_pending) {
+		m_slot_lost_cyc = k_cycle_get_32();
+		m_slot_lost_pending = true;
+	}
+	schedule_request(REQ_MAKE_REQUEST);
+}
+
+static bool client_demand_any(void)
+{
+	struct timeslot_client *client;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&m_clients, client, node) {
+		if (client->demand) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Request a new timeslot if the handler was idle */
+static void request_resume(void)
+{
+	if (atomic_cas(&m_request_state, REQUEST_STATE_IDLE, REQUEST_STATE_ACTIVE)) {
+		LOG_DBG("Demand, resuming timeslot requests");
+		schedule_request(REQ_MAKE_REQUEST);
+	}
+}
+
+/* Stop requesting timeslots until a client has demand again */
+static void request_pause(void)
+{
+	atomic_set(&m_request_state, REQUEST_STATE_IDLE);
+
+	// A client may have set its demand while the state was still ACTIVE or ENDING
+	if (client_demand_any()) {
+		request_resume();
+	}
+}
+
+/* Called from outside the timeslot callback when the session has no timeslot pending */
+static void request_next(void)
+{
+	if (atomic_get(&m_request_state) == REQUEST_STATE_ACTIVE && client_demand_any()) {
+		schedule_rerequest();
+	} else {
+		request_pause();
+	}
+}
+
+static void rerequest_latency_record(void)
+{
+	uint32_t latency_us;
+
+	if (!m_slot_lost_pending) {
+		return;
+	}
+	m_slot_lost_pending = false;
+
+	latency_us = k_cyc_to_us_ceil32(k_cycle_get_32() - m_slot_lost_cyc);
+	m_stats.rerequests++;
+	m_stats.rerequest_latency_last_us = latency_us;
+	m_stats.rerequest_latency_total_us += latency_us;
+	if (latency_us > m_stats.rerequest_latency_max_us) {
+		m_stats.rerequest_latency_max_us = latency_us;
+	}
+}
+
+/* Refill the HIGH priority budget for the time since the last update, and charge the time spent in an escalated
+ * timeslot. Must be called before the timeslot state changes, and from the timeslot callback or with IRQs locked.
+ */
+static void high_budget_update(void)
+{
+	uint32_t now = k_cycle_get_32();
+	uint32_t elapsed_us = k_cyc_to_us_floor32(now - m_high_budget_cyc);
+	int64_t budget = m_high_budget_us + ((uint64_t)elapsed_us * ESCALATE_HIGH_MAX_PERCENT) / 100;
+
+	if (m_in_timeslot && m_slot_escalated) {
+		budget -= elapsed_us;
+	}
+	m_high_budget_us = (int32_t)MIN(budget, HIGH_BUDGET_MAX_US);
+	m_high_budget_cyc = now;
+
+	if (!m_high_capped && m_high_budget_us <= 0) {
+		m_high_capped = true;
+		m_stats.high_capped++;
+		LOG_DBG("HIGH priority budget used up, dropping back to NORMAL");
+	} else if (m_high_capped && m_high_budget_us >= (HIGH_BUDGET_MAX_US * ESCALATE_HIGH_RESUME_PERCENT) / 100) {
+		m_high_capped = false;
+	}
+}
+
+static enum escalation_reason escalation_reason_get(void)
+{
+	struct timeslot_client *client;
+	// Once escalated the backlog has to drain below the lower release thresholds to go back to NORMAL
+	uint32_t queue_percent = m_escalated ? RELEASE_QUEUE_PERCENT : ESCALATE_QUEUE_PERCENT;
+	uint32_t packet_age_us = m_escalated ? RELEASE_PACKET_AGE_US : ESCALATE_PACKET_AGE_US;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&m_clients, client, node) {
+		uint32_t queued = client->backlog_queued;
+
+		if (queued == 0) {
+			continue;
+		}
+		if ((queued * 100) >= (client->backlog_capacity * queue_percent)) {
+			return ESCALATE_QUEUE;
+		}
+		if (k_cyc_to_us_floor32(k_cycle_get_32() - client->backlog_oldest_cyc) >= packet_age_us) {
+			return ESCALATE_AGE;
+		}
+	}
+
+	if (m_blocked_in_a_row >= ESCALATE_BLOCKED_COUNT) {
+		return ESCALATE_BLOCKED;
+	}
+
+	return ESCALATE_NONE;
+}
+
+/* Update the priority of the timeslot request based on the current backlog, right before it is handed to MPSL */
+static mpsl_timeslot_request_t *timeslot_request_prepare(void)
+{
+	enum escalation_reason reason = escalation_reason_get();
+	bool escalate = (reason != ESCALATE_NONE);
+	bool hfxo_guaranteed = false;
+	struct timeslot_client *client;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&m_clients, client, node) {
+		hfxo_guaranteed |= client->hfxo_guaranteed;
+	}
+	timeslot_request_earliest.params.earliest.hfclk = hfxo_guaranteed ?
+		MPSL_TIMESLOT_HFCLK_CFG_XTAL_GUARANTEED : MPSL_TIMESLOT_HFCLK_CFG_NO_GUARANTEE;
+
+	high_budget_update();
+	if (escalate && m_high_capped) {
+		// Out of HIGH priority budget, let BLE catch up until enough of it has built up again
+		escalate = false;
+		m_stats.forced_normal++;
+	}
+
+	if (escalate && !m_escalated) {
+		m_stats.escalations++;
+		switch (reason) {
+			case ESCALATE_QUEUE:
+				m_stats.escalations_queue++;
+				break;
+			case ESCALATE_AGE:
+				m_stats.escalations_age++;
+				break;
+			case ESCALATE_BLOCKED:
+				m_stats.escalations_blocked++;
+				break;
+			default:
+				break;
+		}
+		LOG_DBG("Escalating timeslot priority, reason %i", reason);
+	}
+	m_escalated = escalate;
+
+	if (escalate) {
+		timeslot_request_earliest.params.earliest.priority = MPSL_TIMESLOT_PRIORITY_HIGH;
+		m_stats.requests_high++;
+	} else {
+		timeslot_request_earliest.params.earliest.priority = MPSL_TIMESLOT_PRIORITY_NORMAL;
+		m_stats.requests_normal++;
+	}
+
+	return &timeslot_request_earliest;
+}
+
+/* Pick the client to be given the next timeslot period. The highest priority with demand wins, and clients
+ * of the same priority share the periods by smooth weighted round robin.
+ */
+static struct timeslot_client *client_select(void)
+{
+	struct timeslot_client *client;
+	struct timeslot_client *selected = NULL;
+	int32_t total_weight = 0;
+	int priority = -1;
+	int contenders = 0;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&m_clients, client, node) {
+		if (client->demand && client->priority > priority) {
+			priority = client->priority;
+		}
+	}
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&m_clients, client, node) {
+		if (!client->demand || client->priority != priority) {
+			continue;
+		}
+		client->current_weight += client->weight;
+		total_weight += client->weight;
+		contenders++;
+		if (selected == NULL || client->current_weight > selected->current_weight) {
+			selected = client;
+		}
+	}
+
+	if (selected) {
+		selected->current_weight -= total_weight;
+	}
+	// If other clients compete for the radio the selected client may lose it at the end of the period
+	m_period_shared = (contenders > 1);
+	return selected;
+}
+
+static void radio_reset(void)
+{
+	// Reset the radio to make sure no configuration remains from BLE, or from the previous client
+	NVIC_ClearPendingIRQ(RADIO_IRQn);
+	NRF_RADIO->POWER = RADIO_POWER_POWER_Disabled << RADIO_POWER_POWER_Pos;
+	NRF_RADIO->POWER = RADIO_POWER_POWER_Enabled << RADIO_POWER_POWER_Pos;
+	NVIC_ClearPendingIRQ(RADIO_IRQn);
+}
+
+static void client_switch(struct timeslot_client *next)
+{
+	uint32_t now = k_cycle_get_32();
+
+	if (next == m_active_client) {
+		return;
+	}
+
+	if (m_active_client) {
+		m_active_client->granted_us += k_cyc_to_us_floor32(now - m_client_start_cyc);
+		m_active_client->on_stop();
+		if (next) {
+			m_stats.client_switches++;
+			radio_reset();
+		}
+	}
+
+	m_active_client = next;
+	m_client_start_cyc = now;
+
+	if (next) {
+		next->on_start();
+	}
+}
+
+/* Called at the start of the timeslot, and every time the timeslot enters an extension */
+static void timeslot_period_start(void)
+{
+	struct timeslot_client *next = client_select();
+
+	if (next) {
+		next->periods++;
 	}
+	client_switch(next);
 }
 
 static void set_timeslot_active_status(bool active)
 {
 	if (active) {
 		if (!m_in_timeslot) {
+			high_budget_update();
 			m_in_timeslot = true;
-			m_callback(APP_TS_STARTED);
+			m_slot_start_cyc = k_cycle_get_32();
+			m_slot_escalated = m_escalated;
+			m_stats.slots_started++;
+			if (m_slot_escalated) {
+				m_stats.slots_started_high++;
+			}
+			m_blocked_in_a_row = 0;
+			timeslot_period_start();
 		}
 	} else {
 		if (m_in_timeslot) {
+			high_budget_update();
 			m_in_timeslot = false;
-			m_callback(APP_TS_STOPPED);
+			if (m_slot_escalated) {
+				m_stats.high_prio_time_us += k_cyc_to_us_floor32(k_cycle_get_32() - m_slot_start_cyc);
+			}
+			client_switch(NULL);
 		}
 	}
 }
 
+/* End the running timeslot because none of the clients has demand. The SESSION_IDLE signal that follows
+ * decides whether a new timeslot is requested.
+ */
+static void timeslot_end_idle(void)
+{
+	m_stats.idle_ends++;
+	timeslot_analytics_slot_end(TS_LOSS_IDLE);
+	set_timeslot_active_status(false);
+	atomic_set(&m_request_state, REQUEST_STATE_ENDING);
+	signal_callback_return_param.callback_action = MPSL_TIMESLOT_SIGNAL_ACTION_END;
+}
+
 static mpsl_timeslot_signal_return_param_t *mpsl_timeslot_callback(mpsl_timeslot_session_id_t session_id, uint32_t signal_type)
 {
 	(void) session_id; // unused parameter
 	static bool timeslot_extension_failed;
+	static timeslot_loss_reason_t timeslot_end_reason;
 	NRF_P0->OUTSET = BIT(28);
 	mpsl_timeslot_signal_return_param_t *p_ret_val = NULL;
 	switch (signal_type) {
@@ -87,22 +427,29 @@ static mpsl_timeslot_signal_return_param_t *mpsl_timeslot_callback(mpsl_timeslot
 			p_ret_val = &signal_callback_return_param;
 
 			timeslot_extension_failed = false;
+			m_cur_slot_length_us = m_slot_length_us;
+			m_slot_end_us = m_cur_slot_length_us;
+			timeslot_analytics_slot_start();
 
-			// Reset the radio to make sure no configuration remains from BLE
-			NVIC_ClearPendingIRQ(RADIO_IRQn);
-			NRF_RADIO->POWER = RADIO_POWER_POWER_Disabled << RADIO_POWER_POWER_Pos;
-			NRF_RADIO->POWER = RADIO_POWER_POWER_Enabled << RADIO_POWER_POWER_Pos;
-			NVIC_ClearPendingIRQ(RADIO_IRQn);
+			radio_reset();
 
 			nrf_timer_bit_width_set(NRF_TIMER0, NRF_TIMER_BIT_WIDTH_32);
 			
-			nrf_timer_cc_set(NRF_TIMER0, NRF_TIMER_CC_CHANNEL0, TIMER_EXPIRY_US_EARLY);
+			nrf_timer_cc_set(NRF_TIMER0, NRF_TIMER_CC_CHANNEL0, TIMER_EXPIRY_US_EARLY(m_cur_slot_length_us));
 			nrf_timer_int_enable(NRF_TIMER0, NRF_TIMER_INT_COMPARE0_MASK);
 
-			nrf_timer_cc_set(NRF_TIMER0, NRF_TIMER_CC_CHANNEL1, TIMER_EXPIRY_REQ);
+			nrf_timer_cc_set(NRF_TIMER0, NRF_TIMER_CC_CHANNEL1, TIMER_EXPIRY_REQ(m_cur_slot_length_us));
 			nrf_timer_int_enable(NRF_TIMER0, NRF_TIMER_INT_COMPARE1_MASK);
 
+			// CC2 marks the end of the current period, where the arbiter may hand the radio to another client
+			nrf_timer_event_clear(NRF_TIMER0, NRF_TIMER_EVENT_COMPARE2);
+			nrf_timer_cc_set(NRF_TIMER0, NRF_TIMER_CC_CHANNEL2, m_cur_slot_length_us);
+			nrf_timer_int_enable(NRF_TIMER0, NRF_TIMER_INT_COMPARE2_MASK);
+
 			set_timeslot_active_status(true);
+			if (m_active_client == NULL) {
+				timeslot_end_idle();
+			}
 			break;
 
 		case MPSL_TIMESLOT_SIGNAL_TIMER0:
@@ -110,47 +457,101 @@ static mpsl_timeslot_signal_return_param_t *mpsl_timeslot_callback(mpsl_timeslot
 				nrf_timer_int_disable(NRF_TIMER0, NRF_TIMER_INT_COMPARE0_MASK);
 				nrf_timer_event_clear(NRF_TIMER0, NRF_TIMER_EVENT_COMPARE0);
 
-				signal_callback_return_param.callback_action = MPSL_TIMESLOT_SIGNAL_ACTION_EXTEND;
-				signal_callback_return_param.params.extend.length_us = TIMESLOT_LENGTH_US;	
+				if (m_slot_escalated) {
+					high_budget_update();
+				}
+				if (!client_demand_any()) {
+					// Don't extend a timeslot nobody needs, CC1 ends it
+					timeslot_extension_failed = true;
+					timeslot_end_reason = TS_LOSS_IDLE;
+					nrf_timer_int_disable(NRF_TIMER0, NRF_TIMER_INT_COMPARE2_MASK);
+					signal_callback_return_param.callback_action = MPSL_TIMESLOT_SIGNAL_ACTION_NONE;
+				} else if (m_slot_escalated && m_high_capped) {
+					// Extensions keep the HIGH priority of the timeslot, so end it instead and request a
+					// NORMAL priority timeslot at CC1
+					m_stats.high_drop_backs++;
+					timeslot_extension_failed = true;
+					timeslot_end_reason = TS_LOSS_OTHER;
+					nrf_timer_int_disable(NRF_TIMER0, NRF_TIMER_INT_COMPARE2_MASK);
+					signal_callback_return_param.callback_action = MPSL_TIMESLOT_SIGNAL_ACTION_NONE;
+				} else {
+					signal_callback_return_param.callback_action = MPSL_TIMESLOT_SIGNAL_ACTION_EXTEND;
+					signal_callback_return_param.params.extend.length_us = m_cur_slot_length_us;
+				}
 			}
 			else if(nrf_timer_event_check(NRF_TIMER0, NRF_TIMER_EVENT_COMPARE1)) {
 				nrf_timer_int_disable(NRF_TIMER0, NRF_TIMER_INT_COMPARE1_MASK);
 				nrf_timer_event_clear(NRF_TIMER0, NRF_TIMER_EVENT_COMPARE1);
 
-				if(timeslot_extension_failed) {
+				if(timeslot_extension_failed && !client_demand_any()) {
+					timeslot_end_idle();
+				} else if(timeslot_extension_failed) {
+					// The client kept the radio until now, stop it before the timeslot ends
+					timeslot_analytics_slot_end(timeslot_end_reason);
+					set_timeslot_active_status(false);
 					signal_callback_return_param.callback_action = MPSL_TIMESLOT_SIGNAL_ACTION_REQUEST;
-					signal_callback_return_param.params.request.p_next = &timeslot_request_earliest;
+					signal_callback_return_param.params.request.p_next = timeslot_request_prepare();
 				} else {
 					signal_callback_return_param.callback_action = MPSL_TIMESLOT_SIGNAL_ACTION_NONE;
 				}
 			}
+			else if(nrf_timer_event_check(NRF_TIMER0, NRF_TIMER_EVENT_COMPARE2)) {
+				nrf_timer_int_disable(NRF_TIMER0, NRF_TIMER_INT_COMPARE2_MASK);
+				nrf_timer_event_clear(NRF_TIMER0, NRF_TIMER_EVENT_COMPARE2);
+
+				signal_callback_return_param.callback_action = MPSL_TIMESLOT_SIGNAL_ACTION_NONE;
+
+				// Arm CC2 for the end of the next period, if the timeslot has been extended
+				uint32_t period_end = nrf_timer_cc_get(NRF_TIMER0, NRF_TIMER_CC_CHANNEL2);
+				if (period_end < m_slot_end_us) {
+					nrf_timer_cc_set(NRF_TIMER0, NRF_TIMER_CC_CHANNEL2, period_end + m_cur_slot_length_us);
+					nrf_timer_int_enable(NRF_TIMER0, NRF_TIMER_INT_COMPARE2_MASK);
+				}
+
+				if (m_in_timeslot) {
+					timeslot_period_start();
+					if (m_active_client == NULL) {
+						timeslot_end_idle();
+					}
+				}
+			}
 			p_ret_val = &signal_callback_return_param;
 			break;
 
 		case MPSL_TIMESLOT_SIGNAL_EXTEND_SUCCEEDED:
 			LOG_DBG("Extend Succeeded");
+			timeslot_analytics_extension(true);
 			signal_callback_return_param.callback_action = MPSL_TIMESLOT_SIGNAL_ACTION_NONE;
 
 			// Set next trigger time to be the current + Timer expiry early
 			uint32_t current_cc = nrf_timer_cc_get(NRF_TIMER0, NRF_TIMER_CC_CHANNEL0);
 			nrf_timer_bit_width_set(NRF_TIMER0, NRF_TIMER_BIT_WIDTH_32);
-			nrf_timer_cc_set(NRF_TIMER0, NRF_TIMER_CC_CHANNEL0, current_cc + TIMESLOT_LENGTH_US);
+			nrf_timer_cc_set(NRF_TIMER0, NRF_TIMER_CC_CHANNEL0, current_cc + m_cur_slot_length_us);
 			nrf_timer_int_enable(NRF_TIMER0, NRF_TIMER_INT_COMPARE0_MASK);
 
 			current_cc = nrf_timer_cc_get(NRF_TIMER0, NRF_TIMER_CC_CHANNEL1);
 			nrf_timer_bit_width_set(NRF_TIMER0, NRF_TIMER_BIT_WIDTH_32);
-			nrf_timer_cc_set(NRF_TIMER0, NRF_TIMER_CC_CHANNEL1, current_cc + TIMESLOT_LENGTH_US);
+			nrf_timer_cc_set(NRF_TIMER0, NRF_TIMER_CC_CHANNEL1, current_cc + m_cur_slot_length_us);
 			nrf_timer_int_enable(NRF_TIMER0, NRF_TIMER_INT_COMPARE1_MASK);
 
+			m_slot_end_us += m_cur_slot_length_us;
+
+			if (m_active_client && m_active_client->on_extended) {
+				m_active_client->on_extended();
+			}
+
 			p_ret_val = &signal_callback_return_param;
 			break;
 
 		case MPSL_TIMESLOT_SIGNAL_EXTEND_FAILED:
 			LOG_DBG("Extend failed");	
+			timeslot_analytics_extension(false);
 			signal_callback_return_param.callback_action = MPSL_TIMESLOT_SIGNAL_ACTION_NONE;
 			timeslot_extension_failed = true;
+			timeslot_end_reason = TS_LOSS_EXTEND_FAILED;
+			nrf_timer_int_disable(NRF_TIMER0, NRF_TIMER_INT_COMPARE2_MASK);
 			p_ret_val = &signal_callback_return_param;
-			set_timeslot_active_status(false);
+			// The timeslot still runs to its end, the client keeps the radio until CC1 requests the next one
 			break;
 
 		case MPSL_TIMESLOT_SIGNAL_RADIO:
@@ -159,7 +560,7 @@ static mpsl_timeslot_signal_return_param_t *mpsl_timeslot_callback(mpsl_timeslot
 			p_ret_val = &signal_callback_return_param;
 
 			// We have to manually call the RADIO IRQ handler when the RADIO signal occurs
-			if(m_in_timeslot) RADIO_IRQHandler();
+			if(m_in_timeslot && m_active_client && m_active_client->on_radio_irq) m_active_client->on_radio_irq();
 			else {
 				NVIC_ClearPendingIRQ(RADIO_IRQn);
 				NVIC_DisableIRQ(RADIO_IRQn);
@@ -168,6 +569,7 @@ static mpsl_timeslot_signal_return_param_t *mpsl_timeslot_callback(mpsl_timeslot
 
 		case MPSL_TIMESLOT_SIGNAL_OVERSTAYED:
 			LOG_WRN("something overstayed!");
+			timeslot_analytics_slot_end(TS_LOSS_OVERSTAYED);
 			signal_callback_return_param.callback_action = MPSL_TIMESLOT_SIGNAL_ACTION_END;
 			p_ret_val = &signal_callback_return_param;
 			set_timeslot_active_status(false);
@@ -175,26 +577,32 @@ static mpsl_timeslot_signal_return_param_t *mpsl_timeslot_callback(mpsl_timeslot
 
 		case MPSL_TIMESLOT_SIGNAL_CANCELLED:
 			LOG_DBG("something cancelled!");
+			m_stats.cancelled++;
+			timeslot_analytics_request_failed(TS_LOSS_CANCELLED);
 			signal_callback_return_param.callback_action = MPSL_TIMESLOT_SIGNAL_ACTION_NONE;
 			p_ret_val = &signal_callback_return_param;
 			set_timeslot_active_status(false);
 			
 			// In this case returning SIGNAL_ACTION_REQUEST causes hardfault. We have to request a new timeslot instead, from thread context. 
-			schedule_request(REQ_MAKE_REQUEST);
+			request_next();
 			break;
 
 		case MPSL_TIMESLOT_SIGNAL_BLOCKED:
 			LOG_INF("something blocked!");
+			m_stats.blocked++;
+			m_blocked_in_a_row++;
+			timeslot_analytics_request_failed(TS_LOSS_BLOCKED);
 			signal_callback_return_param.callback_action = MPSL_TIMESLOT_SIGNAL_ACTION_NONE;
 			p_ret_val = &signal_callback_return_param;
 			set_timeslot_active_status(false);
 
 			// Request a new timeslot in this case
-			schedule_request(REQ_MAKE_REQUEST);
+			request_next();
 			break;
 
 		case MPSL_TIMESLOT_SIGNAL_INVALID_RETURN:
 			LOG_WRN("something gave invalid return");
+			timeslot_analytics_slot_end(TS_LOSS_OTHER);
 			signal_callback_return_param.callback_action = MPSL_TIMESLOT_SIGNAL_ACTION_END;
 			p_ret_val = &signal_callback_return_param;
 			set_timeslot_active_status(false);
@@ -202,9 +610,10 @@ static mpsl_timeslot_signal_return_param_t *mpsl_timeslot_callback(mpsl_timeslot
 
 		case MPSL_TIMESLOT_SIGNAL_SESSION_IDLE:
 			LOG_INF("idle");
+			timeslot_analytics_slot_end(TS_LOSS_OTHER);
 
 			// Request a new timeslot in this case
-			schedule_request(REQ_MAKE_REQUEST);
+			request_next();
 
 			signal_callback_return_param.callback_action = MPSL_TIMESLOT_SIGNAL_ACTION_NONE;
 			p_ret_val = &signal_callback_return_param;
@@ -213,6 +622,7 @@ static mpsl_timeslot_signal_return_param_t *mpsl_timeslot_callback(mpsl_timeslot
 
 		case MPSL_TIMESLOT_SIGNAL_SESSION_CLOSED:
 			LOG_INF("Session closed");
+			timeslot_analytics_slot_end(TS_LOSS_OTHER);
 
 			signal_callback_return_param.callback_action = MPSL_TIMESLOT_SIGNAL_ACTION_NONE;
 			p_ret_val = &signal_callback_return_param;
@@ -228,64 +638,157 @@ static mpsl_timeslot_signal_return_param_t *mpsl_timeslot_callback(mpsl_timeslot
 	return p_ret_val;
 }
 
-/* To ensure thread safe operation, call all MPSL APIs from a non-preemptible
- * thread.
+/* MPSL API calls are not allowed from the timeslot callback itself, and the MPSL API is not reentrant.
+ * All calls are therefore made from the MPSL work queue, which is where MPSL does its own low priority
+ * processing. The BLOCKED, CANCELLED and IDLE signals are delivered from this context, so a new request
+ * is issued right after the signal is handled without waiting for any other thread to be scheduled.
  */
-static void mpsl_nonpreemptible_thread(void)
+static void mpsl_api_work_handler(struct k_work *work)
 {
 	int err;
-	enum mpsl_timeslot_call api_call = 0;
-
-	/* Initialize to invalid session id */
-	mpsl_timeslot_session_id_t session_id = 0xFFu;
-
-	while (1) {
-		if (k_msgq_get(&mpsl_api_msgq, &api_call, K_FOREVER) == 0) {
-			//NRF_P0->OUTSET = BIT(29);
-			switch (api_call) {
-				case REQ_OPEN_SESSION:
-					LOG_DBG("req open");
-					err = mpsl_timeslot_session_open(mpsl_timeslot_callback, &session_id);
-					if (err) {
-						LOG_ERR("Timeslot session open error: %d", err);
-						k_oops();
-					}
-					break;
-				case REQ_MAKE_REQUEST:
-					LOG_DBG("req request");
-					err = mpsl_timeslot_request(session_id, &timeslot_request_earliest);
-					if (err) {
-						LOG_ERR("Timeslot request error: %d", err);
-						k_oops();
-					}
-					break;
-				case REQ_CLOSE_SESSION:
-					LOG_DBG("req close");
-					err = mpsl_timeslot_session_close(session_id);
-					if (err) {
-						LOG_ERR("Timeslot session close error: %d", err);
-						k_oops();
-					}
-					break;
-				default:
-					LOG_ERR("Wrong timeslot API call");
-					k_oops();
-					break;
-			}
-			//NRF_P0->OUTCLR = BIT(29);
+	atomic_val_t calls = atomic_clear(&m_pending_calls);
+
+	if (calls & REQ_OPEN_SESSION) {
+		LOG_DBG("req open");
+		err = mpsl_timeslot_session_open(mpsl_timeslot_callback, &m_session_id);
+		if (err) {
+			LOG_ERR("Timeslot session open error: %d", err);
+			k_oops();
+		}
+	}
+
+	if (calls & REQ_MAKE_REQUEST) {
+		LOG_DBG("req request");
+		err = mpsl_timeslot_request(m_session_id, timeslot_request_prepare());
+		if (err) {
+			LOG_ERR("Timeslot request error: %d", err);
+			k_oops();
+		}
+		rerequest_latency_record();
+	}
+
+	if (calls & REQ_CLOSE_SESSION) {
+		LOG_DBG("req close");
+		err = mpsl_timeslot_session_close(m_session_id);
+		if (err) {
+			LOG_ERR("Timeslot session close error: %d", err);
+			k_oops();
 		}
 	}
 }
 
-void timeslot_handler_init(timeslot_callback_t callback)
+static void slot_length_update(void)
 {
-	m_callback = callback;
+	struct timeslot_client *client;
+	uint32_t length_us = m_default_slot_length_us;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&m_clients, client, node) {
+		length_us = MAX(length_us, client->slot_length_us);
+	}
 
-	schedule_request(REQ_OPEN_SESSION);
+	// Takes effect from the next timeslot, the running timeslot keeps its length
+	m_slot_length_us = length_us;
+	timeslot_request_earliest.params.earliest.length_us = length_us;
+}
 
-	schedule_request(REQ_MAKE_REQUEST);
+int timeslot_handler_client_register(struct timeslot_client *client)
+{
+	bool first_client;
+	uint32_t key;
+
+	if (client == NULL || client->on_start == NULL || client->on_stop == NULL) {
+		return -EINVAL;
+	}
+
+	key = irq_lock();
+	if (sys_slist_find(&m_clients, &client->node, NULL)) {
+		irq_unlock(key);
+		LOG_WRN("Timeslot client %s already registered", client->name);
+		return -EALREADY;
+	}
+
+	if (client->weight == 0) {
+		client->weight = 1;
+	}
+	client->demand = true;
+	client->current_weight = 0;
+	client->backlog_queued = 0;
+
+	first_client = sys_slist_is_empty(&m_clients);
+	sys_slist_append(&m_clients, &client->node);
+	slot_length_update();
+	irq_unlock(key);
+
+	LOG_INF("Timeslot client %s registered, prio %i, weight %i", client->name, client->priority, client->weight);
+
+	if (first_client) {
+		schedule_request(REQ_OPEN_SESSION);
+
+		schedule_request(REQ_MAKE_REQUEST);
+	} else {
+		request_resume();
+	}
+
+	return 0;
 }
 
-K_THREAD_DEFINE(mpsl_nonpreemptible_thread_id, STACKSIZE,
-		mpsl_nonpreemptible_thread, NULL, NULL, NULL,
-		K_PRIO_COOP(MPSL_THREAD_PRIO), 0, 0);
\ No newline at end of file
+void timeslot_handler_client_demand_set(struct timeslot_client *client, bool demand)
+{
+	client->demand = demand;
+	if (demand) {
+		request_resume();
+	}
+}
+
+void timeslot_handler_backlog_update(struct timeslot_client *client, uint32_t queued, uint32_t capacity, uint32_t oldest_cyc)
+{
+	client->backlog_capacity = capacity;
+	client->backlog_oldest_cyc = oldest_cyc;
+	client->backlog_queued = queued;
+}
+
+void timeslot_handler_slot_length_set(uint32_t length_us)
+{
+	uint32_t key = irq_lock();
+	m_default_slot_length_us = length_us;
+	slot_length_update();
+	irq_unlock(key);
+}
+
+uint32_t timeslot_handler_remaining_us(void)
+{
+	uint32_t now;
+	uint32_t end;
+
+	if (!m_in_timeslot) {
+		return 0;
+	}
+
+	// TIMER0 is started by MPSL at the start of the timeslot, capture it to find the current time
+	nrf_timer_task_trigger(NRF_TIMER0, nrf_timer_capture_task_get(NRF_TIMER_CC_CHANNEL3));
+	now = nrf_timer_cc_get(NRF_TIMER0, NRF_TIMER_CC_CHANNEL3);
+
+	// Whether or not the pending extension succeeds the client keeps the radio until CC1 of the last block,
+	// where the next timeslot is requested if the extension failed
+	end = TIMER_EXPIRY_REQ(m_slot_end_us);
+	if (m_period_shared) {
+		end = MIN(end, nrf_timer_cc_get(NRF_TIMER0, NRF_TIMER_CC_CHANNEL2));
+	}
+
+	return (end > now) ? (end - now) : 0;
+}
+
+void timeslot_handler_ble_events_report(uint32_t events, uint32_t missed)
+{
+	uint32_t key = irq_lock();
+	m_stats.ble_events += events;
+	m_stats.ble_events_missed += missed;
+	irq_unlock(key);
+}
+
+void timeslot_handler_stats_get(timeslot_stats_t *stats)
+{
+	uint32_t key = irq_lock();
+	*stats = m_stats;
+	irq_unlock(key);
+}
@@ -1,9 +1,105 @@
 #ifndef __TIMESLOT_HANDLER_H
 #define __TIMESLOT_HANDLER_H
 
-typedef enum {APP_TS_STARTED, APP_TS_STOPPED} timeslot_callback_type_t;
-typedef void (*timeslot_callback_t)(timeslot_callback_type_t type);
+#include <zephyr/kernel.h>
+#include <zephyr/sys/slist.h>
 
-void timeslot_handler_init(timeslot_callback_t callback);
+/* A radio protocol sharing the MPSL timeslot session with other protocols.
+ * The granted timeslot time is split into periods of one timeslot length (the initial slot and every extension),
+ * and the arbiter gives each period to one of the clients with demand. Among clients of the same priority
+ * the periods are shared according to the client weights.
+ */
+struct timeslot_client {
+	const char *name;
+	// Clients with a higher priority get the radio first whenever they have demand
+	uint8_t priority;
+	// Relative share of the timeslot periods compared to other clients of the same priority
+	uint32_t weight;
+	// Minimum timeslot length needed by the client, 0 to use the default length
+	uint32_t slot_length_us;
+	// Set if the client needs MPSL to have the HF crystal oscillator running at the start of each timeslot
+	bool hfxo_guaranteed;
 
-#endif
\ No newline at end of file
+	// Called from the MPSL timeslot callback when the client is given the radio, or loses it
+	void (*on_start)(void);
+	void (*on_stop)(void);
+	// Called on the RADIO signal while the client has the radio
+	void (*on_radio_irq)(void);
+	// Optional, called when the running timeslot has been extended while the client has the radio
+	void (*on_extended)(void);
+
+	// Internal arbiter state, should not be touched by the client
+	sys_snode_t node;
+	volatile bool demand;
+	int32_t current_weight;
+	volatile uint32_t backlog_queued;
+	volatile uint32_t backlog_capacity;
+	volatile uint32_t backlog_oldest_cyc;
+	uint32_t periods;
+	uint64_t granted_us;
+};
+
+typedef struct {
+	uint32_t slots_started;
+	uint32_t slots_started_high;	// Timeslots granted while the request was escalated to HIGH priority
+	uint32_t requests_normal;
+	uint32_t requests_high;
+	uint32_t escalations;			// Number of NORMAL -> HIGH transitions
+	uint32_t escalations_queue;		// Escalations triggered by TX queue occupancy
+	uint32_t escalations_age;		// Escalations triggered by the age of the oldest TX packet
+	uint32_t escalations_blocked;	// Escalations triggered by consecutive BLOCKED signals
+	uint32_t forced_normal;			// Requests kept at NORMAL priority by the HIGH duty cycle cap despite a backlog
+	uint32_t high_capped;			// Times the HIGH priority budget ran out
+	uint32_t high_drop_backs;		// Escalated timeslots ended early, instead of extended, when the budget ran out
+	uint32_t blocked;
+	uint32_t cancelled;
+	uint32_t client_switches;		// Times the radio was handed from one client to another within a timeslot
+	uint32_t requests_coalesced;	// MPSL API calls dropped because the same call was already pending
+	uint32_t rerequests;			// New requests issued after a timeslot was lost to BLOCKED, CANCELLED or IDLE
+	uint32_t idle_ends;				// Timeslots ended early because none of the clients had demand
+	uint32_t rerequest_latency_last_us;	// Time from losing a timeslot until the new request was pending with MPSL
+	uint32_t rerequest_latency_max_us;
+	uint64_t rerequest_latency_total_us;
+	uint64_t high_prio_time_us;		// Radio time taken from BLE while running HIGH priority timeslots
+	// BLE connection events, and how many of them did not take place, as reported by the BLE side
+	uint32_t ble_events;
+	uint32_t ble_events_missed;
+} timeslot_stats_t;
+
+/* Register a client with the timeslot arbiter. The timeslot session is opened when the first client registers.
+ * The client struct must remain valid for the lifetime of the application.
+ */
+int timeslot_handler_client_register(struct timeslot_client *client);
+
+/* Signal whether or not the client currently needs radio time. Clients have demand by default.
+ * When no client has demand the running timeslot is ended, and no new timeslot is requested until a client
+ * sets its demand again. Can be called from any context.
+ */
+void timeslot_handler_client_demand_set(struct timeslot_client *client, bool demand);
+
+/* Report the current TX backlog of a client to the timeslot handler, allowing it to escalate the priority
+ * of the next timeslot request when the queue is filling up or packets are getting old.
+ * oldest_cyc is the k_cycle_get_32() timestamp of the oldest queued packet, and is ignored when queued is 0.
+ * Can be called from any context.
+ */
+void timeslot_handler_backlog_update(struct timeslot_client *client, uint32_t queued, uint32_t capacity, uint32_t oldest_cyc);
+
+/* Set the default timeslot length. The requested length is the longest of this and the lengths needed
+ * by the registered clients. Takes effect from the next timeslot request.
+ */
+void timeslot_handler_slot_length_set(uint32_t length_us);
+
+/* Time left before the active client may lose the radio, either because the timeslot ends or because
+ * another client is given the next period. Returns 0 outside of a timeslot.
+ */
+uint32_t timeslot_handler_remaining_us(void);
+
+/* Report BLE connection events to the timeslot handler, for the statistics on how much escalated timeslots cost
+ * BLE. missed is the number of events that should have taken place but didn't, such as events preempted by HIGH
+ * priority timeslots. Can be called from any context.
+ */
+void timeslot_handler_ble_events_report(uint32_t events, uint32_t missed);
+
+void timeslot_handler_stats_get(timeslot_stats_t *stats);
+
+#endif
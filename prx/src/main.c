@@ -18,8 +18,11 @@ MODIFIED SAMPLE TO INCLUDE EXTENSIONS ++
 #include <zephyr/drivers/gpio.h> 
 
 #include "app_bt_lbs.h"
+#include "app_bt_bridge.h"
 
 #include "app_esb.h"
+#include "app_traffic.h"
+#include "log_ratelimit.h"
 
 LOG_MODULE_REGISTER(main, LOG_LEVEL_INF);
 
@@ -27,23 +30,34 @@ void on_esb_callback(app_esb_event_t *event)
 {
 	static uint32_t last_counter = 0;
 	static uint32_t counter;
+
+	// Benchmark traffic is counted by app_traffic, and not logged per packet
+	if (app_traffic_on_esb_event(event)) {
+		return;
+	}
+
+	// Pass ESB traffic on to a phone connected to the bridge service
+	app_bt_bridge_on_esb_event(event);
+
 	switch(event->evt_type) {
 		case APP_ESB_EVT_TX_SUCCESS:
-			LOG_INF("ESB TX success");
+			LOG_RATELIMIT_INF(LOG_RATELIMIT_DEFAULT_MS, "ESB TX success");
 			break;
 		case APP_ESB_EVT_TX_FAIL:
-			LOG_INF("ESB TX failed");
+			LOG_RATELIMIT_INF(LOG_RATELIMIT_DEFAULT_MS, "ESB TX failed");
 			break;
 		case APP_ESB_EVT_RX:
 			memcpy((uint8_t*)&counter, event->buf, sizeof(counter));
 			if(counter != (last_counter + 1)) {
-				LOG_WRN("Packet content error! Counter: %i, last counter %i", counter, last_counter);
+				LOG_RATELIMIT_WRN(LOG_RATELIMIT_DEFAULT_MS, "Packet content error! Counter: %i, last counter %i",
+						  counter, last_counter);
 			}
-			LOG_INF("ESB RX: 0x%.2X-0x%.2X-0x%.2X-0x%.2X", event->buf[0], event->buf[1], event->buf[2], event->buf[3]);
+			LOG_RATELIMIT_INF(LOG_RATELIMIT_DEFAULT_MS, "ESB RX: 0x%.2X-0x%.2X-0x%.2X-0x%.2X", event->buf[0],
+					  event->buf[1], event->buf[2], event->buf[3]);
 			last_counter = counter;
 			break;
 		default:
-			LOG_ERR("Unknown APP ESB event!");
+			LOG_RATELIMIT_ERR(LOG_RATELIMIT_DEFAULT_MS, "Unknown APP ESB event!");
 			break;
 	}
 }
@@ -66,6 +80,12 @@ int main(void)
 		return err;
 	}
 
+	err = app_traffic_init(APP_ESB_MODE_PRX);
+	if (err) {
+		LOG_ERR("app_traffic init failed (err %d)", err);
+		return err;
+	}
+
 	while (1) {
 		k_sleep(K_MSEC(2000));
 	}
@@ -20,25 +20,37 @@ MODIFIED SAMPLE TO INCLUDE EXTENSIONS ++
 #include <dk_buttons_and_leds.h>
 
 #include "app_bt_lbs.h"
+#include "app_bt_bridge.h"
 
 #include "app_esb.h"
+#include "app_traffic.h"
+#include "log_ratelimit.h"
 
 LOG_MODULE_REGISTER(main, LOG_LEVEL_INF);
 
 void on_esb_callback(app_esb_event_t *event)
 {
+	// Benchmark traffic is counted by app_traffic, and not logged per packet
+	if (app_traffic_on_esb_event(event)) {
+		return;
+	}
+
+	// Pass ESB traffic on to a phone connected to the bridge service
+	app_bt_bridge_on_esb_event(event);
+
 	switch(event->evt_type) {
 		case APP_ESB_EVT_TX_SUCCESS:
-			LOG_INF("ESB TX success");
+			LOG_RATELIMIT_INF(LOG_RATELIMIT_DEFAULT_MS, "ESB TX success");
 			break;
 		case APP_ESB_EVT_TX_FAIL:
-			LOG_INF("ESB TX failed");
+			LOG_RATELIMIT_INF(LOG_RATELIMIT_DEFAULT_MS, "ESB TX failed");
 			break;
 		case APP_ESB_EVT_RX:
-			LOG_INF("ESB RX: 0x%.2x-0x%.2x-0x%.2x-0x%.2x", event->buf[0], event->buf[1], event->buf[2], event->buf[3]);
+			LOG_RATELIMIT_INF(LOG_RATELIMIT_DEFAULT_MS, "ESB RX: 0x%.2x-0x%.2x-0x%.2x-0x%.2x", event->buf[0],
+					  event->buf[1], event->buf[2], event->buf[3]);
 			break;
 		default:
-			LOG_ERR("Unknown APP ESB event!");
+			LOG_RATELIMIT_ERR(LOG_RATELIMIT_DEFAULT_MS, "Unknown APP ESB event!");
 			break;
 	}
 }
@@ -61,10 +73,21 @@ int main(void)
 		return err;
 	}
 
+	err = app_traffic_init(APP_ESB_MODE_PTX);
+	if (err) {
+		LOG_ERR("app_traffic init failed (err %d)", err);
+		return err;
+	}
+
 	static app_esb_data_t my_data;
 	my_data.len = 8;
 	int tx_counter = 0;
 	while (1) {
+		// The counter packets are held back during benchmark runs
+		if (app_traffic_tx_running()) {
+			k_sleep(K_MSEC(1500));
+			continue;
+		}
 		memcpy(my_data.data, (uint8_t*)&tx_counter, 4);
 		err = app_esb_send(&my_data);
 		if (err < 0) {
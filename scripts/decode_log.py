@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2019 Nordic Semiconductor
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+"""Decode dictionary based logs from the ptx, prx and app_netcore projects.
+
+The projects built with overlay-dictionary-log.conf send the log messages as hex encoded binary records. This
+script rebuilds the messages from the log_dictionary.json of the build, read either from a serial port or from a
+file captured earlier, using the dictionary log parser that comes with Zephyr.
+
+  scripts/decode_log.py ptx/build --port /dev/ttyACM0
+  scripts/decode_log.py ptx/build --file capture.txt
+"""
+
+import argparse
+import binascii
+import os
+import sys
+
+
+def find_database(build_dir):
+    for candidate in (os.path.join(build_dir, "zephyr", "log_dictionary.json"),
+                      os.path.join(build_dir, "log_dictionary.json")):
+        if os.path.isfile(candidate):
+            return candidate
+    sys.exit(f"No log_dictionary.json in {build_dir}, was it built with overlay-dictionary-log.conf?")
+
+
+def load_parser(database_path):
+    zephyr_base = os.environ.get("ZEPHYR_BASE")
+    if zephyr_base is None:
+        sys.exit("ZEPHYR_BASE is not set")
+    sys.path.insert(0, os.path.join(zephyr_base, "scripts", "logging", "dictionary"))
+
+    import dictionary_parser
+    from dictionary_parser.log_database import LogDatabase
+
+    database = LogDatabase.read_json_database(database_path)
+    if database is None:
+        sys.exit(f"Could not read {database_path}")
+    return dictionary_parser.get_parser(database)
+
+
+def hex_to_bytes(line):
+    # Lines that aren't hex, like the boot banner printed before the log is up, are skipped
+    line = line.strip()
+    try:
+        return binascii.unhexlify(line)
+    except (binascii.Error, ValueError):
+        return b""
+
+
+def decode_file(parser, path):
+    with open(path, "r", errors="replace") as f:
+        data = b"".join(hex_to_bytes(line) for line in f)
+    parser.parse_log_data(data)
+
+
+def decode_serial(parser, port, baudrate):
+    import serial
+
+    with serial.Serial(port, baudrate) as ser:
+        while True:
+            line = ser.readline().decode("ascii", errors="replace")
+            data = hex_to_bytes(line)
+            if data:
+                parser.parse_log_data(data)
+
+
+def main():
+    arg_parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    arg_parser.add_argument("build_dir", help="Build directory of the image that produced the log")
+    source = arg_parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--port", help="Serial port to read the log from")
+    source.add_argument("--file", help="File with a captured log")
+    arg_parser.add_argument("--baudrate", type=int, default=115200)
+    args = arg_parser.parse_args()
+
+    parser = load_parser(find_database(args.build_dir))
+    try:
+        if args.file:
+            decode_file(parser, args.file)
+        else:
+            decode_serial(parser, args.port, args.baudrate)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
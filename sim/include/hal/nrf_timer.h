@@ -0,0 +1,90 @@
+/* Simulated subset of the nrfx TIMER HAL. The timer value is driven by the MPSL model, see sim_mpsl.c. */
+#ifndef __SIM_HAL_NRF_TIMER_H
+#define __SIM_HAL_NRF_TIMER_H
+
+#include <stdbool.h>
+#include "sim_nrf.h"
+
+typedef enum {
+	NRF_TIMER_CC_CHANNEL0,
+	NRF_TIMER_CC_CHANNEL1,
+	NRF_TIMER_CC_CHANNEL2,
+	NRF_TIMER_CC_CHANNEL3,
+	NRF_TIMER_CC_CHANNEL4,
+	NRF_TIMER_CC_CHANNEL5,
+} nrf_timer_cc_channel_t;
+
+typedef enum {
+	NRF_TIMER_EVENT_COMPARE0 = (1 << 0),
+	NRF_TIMER_EVENT_COMPARE1 = (1 << 1),
+	NRF_TIMER_EVENT_COMPARE2 = (1 << 2),
+	NRF_TIMER_EVENT_COMPARE3 = (1 << 3),
+} nrf_timer_event_t;
+
+typedef enum {
+	NRF_TIMER_INT_COMPARE0_MASK = (1 << 0),
+	NRF_TIMER_INT_COMPARE1_MASK = (1 << 1),
+	NRF_TIMER_INT_COMPARE2_MASK = (1 << 2),
+	NRF_TIMER_INT_COMPARE3_MASK = (1 << 3),
+} nrf_timer_int_mask_t;
+
+typedef enum {
+	NRF_TIMER_BIT_WIDTH_32 = 3,
+} nrf_timer_bit_width_t;
+
+typedef uint32_t nrf_timer_task_t;
+
+#define SIM_TIMER_TASK_CAPTURE(ch)	(0x100 + (ch))
+
+/* Current value of the timer, provided by the MPSL model */
+uint32_t sim_timer_value(NRF_TIMER_Type *p_reg);
+
+static inline void nrf_timer_bit_width_set(NRF_TIMER_Type *p_reg, nrf_timer_bit_width_t width)
+{
+	(void)p_reg;
+	(void)width;
+}
+
+static inline void nrf_timer_cc_set(NRF_TIMER_Type *p_reg, nrf_timer_cc_channel_t ch, uint32_t value)
+{
+	p_reg->cc[ch] = value;
+}
+
+static inline uint32_t nrf_timer_cc_get(NRF_TIMER_Type const *p_reg, nrf_timer_cc_channel_t ch)
+{
+	return p_reg->cc[ch];
+}
+
+static inline void nrf_timer_int_enable(NRF_TIMER_Type *p_reg, uint32_t mask)
+{
+	p_reg->int_mask |= mask;
+}
+
+static inline void nrf_timer_int_disable(NRF_TIMER_Type *p_reg, uint32_t mask)
+{
+	p_reg->int_mask &= ~mask;
+}
+
+static inline bool nrf_timer_event_check(NRF_TIMER_Type const *p_reg, nrf_timer_event_t event)
+{
+	return (p_reg->events & event) != 0;
+}
+
+static inline void nrf_timer_event_clear(NRF_TIMER_Type *p_reg, nrf_timer_event_t event)
+{
+	p_reg->events &= ~event;
+}
+
+static inline nrf_timer_task_t nrf_timer_capture_task_get(nrf_timer_cc_channel_t ch)
+{
+	return SIM_TIMER_TASK_CAPTURE(ch);
+}
+
+static inline void nrf_timer_task_trigger(NRF_TIMER_Type *p_reg, nrf_timer_task_t task)
+{
+	if (task >= SIM_TIMER_TASK_CAPTURE(0) && task < SIM_TIMER_TASK_CAPTURE(NRF_TIMER_CC_COUNT)) {
+		p_reg->cc[task - SIM_TIMER_TASK_CAPTURE(0)] = sim_timer_value(p_reg);
+	}
+}
+
+#endif
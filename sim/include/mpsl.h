@@ -0,0 +1,6 @@
+#ifndef __SIM_MPSL_H
+#define __SIM_MPSL_H
+
+#include <stdint.h>
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef __SIM_MPSL_WORK_H
+#define __SIM_MPSL_WORK_H
+
+#include <zephyr/kernel.h>
+
+/* The MPSL work queue is modelled by the simulated system work queue */
+static inline void mpsl_work_submit(struct k_work *work)
+{
+	k_work_submit(work);
+}
+
+#endif
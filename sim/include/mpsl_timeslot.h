@@ -0,0 +1,90 @@
+/* Simulated subset of the MPSL timeslot API, following the nrfxlib mpsl_timeslot.h definitions */
+#ifndef __SIM_MPSL_TIMESLOT_H
+#define __SIM_MPSL_TIMESLOT_H
+
+#include <stdint.h>
+
+#define MPSL_TIMESLOT_EXTENSION_MARGIN_MIN_US	200
+
+typedef uint8_t mpsl_timeslot_session_id_t;
+
+enum MPSL_TIMESLOT_SIGNAL {
+	MPSL_TIMESLOT_SIGNAL_START = 0,
+	MPSL_TIMESLOT_SIGNAL_TIMER0 = 1,
+	MPSL_TIMESLOT_SIGNAL_RADIO = 2,
+	MPSL_TIMESLOT_SIGNAL_EXTEND_FAILED = 3,
+	MPSL_TIMESLOT_SIGNAL_EXTEND_SUCCEEDED = 4,
+	MPSL_TIMESLOT_SIGNAL_BLOCKED = 5,
+	MPSL_TIMESLOT_SIGNAL_CANCELLED = 6,
+	MPSL_TIMESLOT_SIGNAL_SESSION_IDLE = 7,
+	MPSL_TIMESLOT_SIGNAL_INVALID_RETURN = 8,
+	MPSL_TIMESLOT_SIGNAL_SESSION_CLOSED = 9,
+	MPSL_TIMESLOT_SIGNAL_OVERSTAYED = 10,
+};
+
+enum MPSL_TIMESLOT_SIGNAL_ACTION {
+	MPSL_TIMESLOT_SIGNAL_ACTION_NONE = 0,
+	MPSL_TIMESLOT_SIGNAL_ACTION_EXTEND = 1,
+	MPSL_TIMESLOT_SIGNAL_ACTION_END = 2,
+	MPSL_TIMESLOT_SIGNAL_ACTION_REQUEST = 3,
+};
+
+enum MPSL_TIMESLOT_HFCLK_CFG {
+	MPSL_TIMESLOT_HFCLK_CFG_XTAL_GUARANTEED = 0,
+	MPSL_TIMESLOT_HFCLK_CFG_NO_GUARANTEE = 1,
+};
+
+enum MPSL_TIMESLOT_PRIORITY {
+	MPSL_TIMESLOT_PRIORITY_HIGH = 0,
+	MPSL_TIMESLOT_PRIORITY_NORMAL = 1,
+};
+
+enum MPSL_TIMESLOT_REQUEST_TYPE {
+	MPSL_TIMESLOT_REQ_TYPE_EARLIEST = 0,
+	MPSL_TIMESLOT_REQ_TYPE_NORMAL = 1,
+};
+
+typedef struct {
+	uint8_t hfclk;
+	uint8_t priority;
+	uint32_t length_us;
+	uint32_t timeout_us;
+} mpsl_timeslot_request_earliest_t;
+
+typedef struct {
+	uint8_t hfclk;
+	uint8_t priority;
+	uint32_t distance_us;
+	uint32_t length_us;
+} mpsl_timeslot_request_normal_t;
+
+typedef struct {
+	uint8_t request_type;
+	union {
+		mpsl_timeslot_request_earliest_t earliest;
+		mpsl_timeslot_request_normal_t normal;
+	} params;
+} mpsl_timeslot_request_t;
+
+typedef struct {
+	uint8_t callback_action;
+	union {
+		struct {
+			mpsl_timeslot_request_t *p_next;
+		} request;
+		struct {
+			uint32_t length_us;
+		} extend;
+	} params;
+} mpsl_timeslot_signal_return_param_t;
+
+typedef mpsl_timeslot_signal_return_param_t *(*mpsl_timeslot_callback_t)(
+	mpsl_timeslot_session_id_t session_id, uint32_t signal);
+
+int32_t mpsl_timeslot_session_open(mpsl_timeslot_callback_t mpsl_timeslot_signal_callback,
+				   mpsl_timeslot_session_id_t *p_session_id);
+int32_t mpsl_timeslot_session_close(mpsl_timeslot_session_id_t session_id);
+int32_t mpsl_timeslot_request(mpsl_timeslot_session_id_t session_id,
+			      mpsl_timeslot_request_t const *p_request);
+
+#endif
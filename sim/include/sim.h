@@ -0,0 +1,56 @@
+/* Internal interfaces between the parts of the timeslot simulator */
+#ifndef __SIM_H
+#define __SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef void (*sim_event_fn_t)(void *arg);
+
+struct sim_event {
+	uint64_t time;
+	sim_event_fn_t fn;
+	void *arg;
+	bool queued;
+	struct sim_event *next;
+};
+
+/* Discrete event scheduler, sim_kernel.c */
+void sim_event_schedule(struct sim_event *evt, uint64_t time, sim_event_fn_t fn, void *arg);
+void sim_event_cancel(struct sim_event *evt);
+void sim_run_until(uint64_t end_us);
+uint32_t sim_random(void);
+void sim_random_seed(uint32_t seed);
+extern int sim_log_level;
+extern uint32_t sim_hfxo_ramp_up_us;
+
+/* BLE and MPSL model, sim_mpsl.c */
+struct sim_ble_config {
+	bool advertising;
+	uint32_t adv_interval_us;
+	uint32_t adv_event_us;
+	bool connected;
+	uint32_t conn_interval_us;
+	uint32_t conn_event_us;
+	// Events of one BLE role a HIGH priority timeslot may skip in a row before the role is protected
+	uint32_t max_skips;
+	// Probability, in percent, that a scheduled timeslot is cancelled by higher priority BLE activity
+	uint32_t cancel_percent;
+};
+
+struct sim_ble_stats {
+	uint64_t events;
+	uint64_t skipped;
+	uint64_t airtime_us;
+};
+
+void sim_mpsl_configure(const struct sim_ble_config *config);
+void sim_mpsl_ble_stats_get(struct sim_ble_stats *stats);
+/* Deliver the RADIO interrupt to the timeslot session, if a timeslot is running */
+void sim_mpsl_radio_irq(void);
+bool sim_mpsl_in_timeslot(void);
+
+/* ESB radio model, sim_esb.c */
+void sim_esb_configure(uint32_t packet_error_percent);
+
+#endif
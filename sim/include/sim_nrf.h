@@ -0,0 +1,70 @@
+/* Simulated nRF peripherals. Only the registers touched by the timeslot handler and app_esb are modelled. */
+#ifndef __SIM_NRF_H
+#define __SIM_NRF_H
+
+#include <stdint.h>
+
+typedef enum {
+	RADIO_IRQn = 1,
+	TIMER0_IRQn = 8,
+} IRQn_Type;
+
+typedef struct {
+	volatile uint32_t OUT;
+	volatile uint32_t OUTSET;
+	volatile uint32_t OUTCLR;
+	volatile uint32_t DIRSET;
+} NRF_GPIO_Type;
+
+typedef struct {
+	volatile uint32_t TASKS_DISABLE;
+	volatile uint32_t EVENTS_DISABLED;
+	volatile uint32_t SHORTS;
+	volatile uint32_t INTENCLR;
+	volatile uint32_t POWER;
+} NRF_RADIO_Type;
+
+#define NRF_TIMER_CC_COUNT 6
+
+typedef struct {
+	volatile uint32_t TASKS_STOP;
+	uint32_t cc[NRF_TIMER_CC_COUNT];
+	uint32_t int_mask;
+	uint32_t events;
+	// Compare value (plus one) each channel last fired for, so a channel fires once per compare value
+	uint64_t fired_at[NRF_TIMER_CC_COUNT];
+} NRF_TIMER_Type;
+
+extern NRF_GPIO_Type sim_gpio_p0;
+extern NRF_TIMER_Type sim_timer0;
+extern NRF_TIMER_Type sim_timer2;
+
+/* The radio is accessed through a function, so that a DISABLE task completes as soon as it is triggered */
+NRF_RADIO_Type *sim_radio_regs(void);
+
+#define NRF_P0		(&sim_gpio_p0)
+#define NRF_RADIO	(sim_radio_regs())
+#define NRF_TIMER0	(&sim_timer0)
+#define NRF_TIMER2	(&sim_timer2)
+
+#define RADIO_POWER_POWER_Pos		(0UL)
+#define RADIO_POWER_POWER_Disabled	(0UL)
+#define RADIO_POWER_POWER_Enabled	(1UL)
+
+static inline void NVIC_ClearPendingIRQ(IRQn_Type irq)
+{
+	(void)irq;
+}
+
+static inline void NVIC_DisableIRQ(IRQn_Type irq)
+{
+	(void)irq;
+}
+
+static inline void NVIC_SetPriority(IRQn_Type irq, uint32_t prio)
+{
+	(void)irq;
+	(void)prio;
+}
+
+#endif
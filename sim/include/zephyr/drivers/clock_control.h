@@ -0,0 +1,49 @@
+/* Simulated on-off manager for the HF clock. Requests complete after the HFXO ramp up time. */
+#ifndef __SIM_ZEPHYR_DRIVERS_CLOCK_CONTROL_H
+#define __SIM_ZEPHYR_DRIVERS_CLOCK_CONTROL_H
+
+#include <zephyr/kernel.h>
+
+struct onoff_manager;
+struct onoff_client;
+
+typedef void (*onoff_client_callback)(struct onoff_manager *mgr, struct onoff_client *cli, uint32_t state, int res);
+
+struct sys_notify {
+	onoff_client_callback callback;
+	bool spinwait;
+	bool done;
+	int result;
+};
+
+struct onoff_client {
+	struct sys_notify notify;
+};
+
+struct onoff_manager {
+	uint32_t refs;
+};
+
+static inline void sys_notify_init_spinwait(struct sys_notify *notify)
+{
+	*notify = (struct sys_notify){ .spinwait = true };
+}
+
+static inline void sys_notify_init_callback(struct sys_notify *notify, onoff_client_callback handler)
+{
+	*notify = (struct sys_notify){ .callback = handler };
+}
+
+static inline int sys_notify_fetch_result(const struct sys_notify *notify, int *result)
+{
+	if (!notify->done) {
+		return -EAGAIN;
+	}
+	*result = notify->result;
+	return 0;
+}
+
+int onoff_request(struct onoff_manager *mgr, struct onoff_client *cli);
+int onoff_cancel_or_release(struct onoff_manager *mgr, struct onoff_client *cli);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef __SIM_NRF_CLOCK_CONTROL_H
+#define __SIM_NRF_CLOCK_CONTROL_H
+
+#include <zephyr/drivers/clock_control.h>
+
+enum clock_control_nrf_type {
+	CLOCK_CONTROL_NRF_TYPE_HFCLK,
+};
+
+#define CLOCK_CONTROL_NRF_SUBSYS_HF CLOCK_CONTROL_NRF_TYPE_HFCLK
+
+struct onoff_manager *z_nrf_clock_control_get_onoff(int sys);
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef __SIM_ZEPHYR_IRQ_H
+#define __SIM_ZEPHYR_IRQ_H
+
+#include <zephyr/kernel.h>
+
+#endif
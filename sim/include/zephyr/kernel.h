@@ -0,0 +1,173 @@
+/* Host simulation stand-in for the parts of the Zephyr kernel API used by the timeslot handler and app_esb.
+ * Time is virtual and counted in microseconds, with one kernel cycle per microsecond.
+ */
+#ifndef __SIM_ZEPHYR_KERNEL_H
+#define __SIM_ZEPHYR_KERNEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include <zephyr/sys/slist.h>
+#include "sim_nrf.h"
+
+#define BIT(n)					(1UL << (n))
+#define ARRAY_SIZE(a)			(sizeof(a) / sizeof((a)[0]))
+#define MIN(a, b)				(((a) < (b)) ? (a) : (b))
+#define MAX(a, b)				(((a) > (b)) ? (a) : (b))
+#define DIV_ROUND_UP(n, d)		(((n) + (d) - 1) / (d))
+#define CONTAINER_OF(ptr, type, field) ((type *)(((char *)(ptr)) - offsetof(type, field)))
+
+#define CONFIG_APPLICATION_INIT_PRIORITY 90
+#define CONFIG_ESB_MAX_PAYLOAD_LENGTH	 32
+
+/* Time */
+uint64_t sim_now_us(void);
+
+static inline uint32_t k_cycle_get_32(void)
+{
+	return (uint32_t)sim_now_us();
+}
+
+static inline uint32_t k_cyc_to_us_floor32(uint32_t cyc)
+{
+	return cyc;
+}
+
+static inline uint32_t k_cyc_to_us_ceil32(uint32_t cyc)
+{
+	return cyc;
+}
+
+static inline uint64_t k_cyc_to_us_floor64(uint32_t cyc)
+{
+	return cyc;
+}
+
+/* One tick per microsecond */
+static inline int64_t k_uptime_ticks(void)
+{
+	return (int64_t)sim_now_us();
+}
+
+static inline uint64_t k_ticks_to_us_floor64(uint64_t ticks)
+{
+	return ticks;
+}
+
+static inline uint32_t k_uptime_get_32(void)
+{
+	return (uint32_t)(sim_now_us() / 1000);
+}
+
+typedef struct {
+	int64_t ticks;
+} k_timeout_t;
+
+#define K_NO_WAIT	((k_timeout_t){0})
+#define K_FOREVER	((k_timeout_t){-1})
+
+/* The simulation is single threaded, interrupts are dispatched from the event loop only */
+static inline uint32_t irq_lock(void)
+{
+	return 0;
+}
+
+static inline void irq_unlock(uint32_t key)
+{
+	(void)key;
+}
+
+static inline void irq_disable(unsigned int irq)
+{
+	(void)irq;
+}
+
+#define k_oops() abort()
+
+/* Atomics */
+typedef long atomic_t;
+typedef long atomic_val_t;
+#define ATOMIC_INIT(i) (i)
+
+static inline atomic_val_t atomic_or(atomic_t *target, atomic_val_t value)
+{
+	atomic_val_t old = *target;
+	*target |= value;
+	return old;
+}
+
+static inline atomic_val_t atomic_clear(atomic_t *target)
+{
+	atomic_val_t old = *target;
+	*target = 0;
+	return old;
+}
+
+static inline atomic_val_t atomic_get(const atomic_t *target)
+{
+	return *target;
+}
+
+static inline atomic_val_t atomic_set(atomic_t *target, atomic_val_t value)
+{
+	atomic_val_t old = *target;
+	*target = value;
+	return old;
+}
+
+static inline bool atomic_cas(atomic_t *target, atomic_val_t old_value, atomic_val_t new_value)
+{
+	if (*target != old_value) {
+		return false;
+	}
+	*target = new_value;
+	return true;
+}
+
+/* Message queues */
+struct k_msgq {
+	char *buffer;
+	size_t item_size;
+	uint32_t max_items;
+	uint32_t read_idx;
+	uint32_t used;
+};
+
+#define K_MSGQ_DEFINE(name, q_item_size, q_max_items, q_align)				\
+	static char name##_buffer[(q_item_size) * (q_max_items)];			\
+	struct k_msgq name = {								\
+		.buffer = name##_buffer,						\
+		.item_size = (q_item_size),						\
+		.max_items = (q_max_items),						\
+	}
+
+int k_msgq_put(struct k_msgq *msgq, const void *data, k_timeout_t timeout);
+int k_msgq_get(struct k_msgq *msgq, void *data, k_timeout_t timeout);
+int k_msgq_peek(struct k_msgq *msgq, void *data);
+uint32_t k_msgq_num_used_get(struct k_msgq *msgq);
+
+/* Work items, run from the simulation event loop */
+struct k_work;
+typedef void (*k_work_handler_t)(struct k_work *work);
+
+struct k_work {
+	k_work_handler_t handler;
+	bool pending;
+};
+
+#define K_WORK_DEFINE(work, work_handler) struct k_work work = { .handler = (work_handler) }
+
+int k_work_submit(struct k_work *work);
+
+/* SYS_INIT functions are run when the simulated system starts */
+#define SYS_INIT(init_fn, level, prio)							\
+	static void __attribute__((constructor)) sim_sys_init_##init_fn(void)	\
+	{										\
+		(void)init_fn();							\
+	}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef __SIM_ZEPHYR_LOGGING_LOG_H
+#define __SIM_ZEPHYR_LOGGING_LOG_H
+
+#define LOG_LEVEL_NONE	0
+#define LOG_LEVEL_ERR	1
+#define LOG_LEVEL_WRN	2
+#define LOG_LEVEL_INF	3
+#define LOG_LEVEL_DBG	4
+
+/* Log output is controlled globally by the simulator, rather than per module */
+void sim_log(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#define LOG_MODULE_REGISTER(name, level)
+#define LOG_ERR(...)	sim_log(LOG_LEVEL_ERR, __VA_ARGS__)
+#define LOG_WRN(...)	sim_log(LOG_LEVEL_WRN, __VA_ARGS__)
+#define LOG_INF(...)	sim_log(LOG_LEVEL_INF, __VA_ARGS__)
+#define LOG_DBG(...)	sim_log(LOG_LEVEL_DBG, __VA_ARGS__)
+
+#endif
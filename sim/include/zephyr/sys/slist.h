@@ -0,0 +1,61 @@
+/* Minimal single linked list, matching the subset of the Zephyr sys_slist API used by the application */
+#ifndef __SIM_ZEPHYR_SYS_SLIST_H
+#define __SIM_ZEPHYR_SYS_SLIST_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef struct _snode {
+	struct _snode *next;
+} sys_snode_t;
+
+typedef struct {
+	sys_snode_t *head;
+	sys_snode_t *tail;
+} sys_slist_t;
+
+#define SYS_SLIST_STATIC_INIT(ptr_to_list) {NULL, NULL}
+
+static inline bool sys_slist_is_empty(sys_slist_t *list)
+{
+	return list->head == NULL;
+}
+
+static inline void sys_slist_append(sys_slist_t *list, sys_snode_t *node)
+{
+	node->next = NULL;
+	if (list->tail) {
+		list->tail->next = node;
+	} else {
+		list->head = node;
+	}
+	list->tail = node;
+}
+
+static inline bool sys_slist_find(sys_slist_t *list, sys_snode_t *node, sys_snode_t **prev)
+{
+	sys_snode_t *last = NULL;
+
+	for (sys_snode_t *it = list->head; it != NULL; it = it->next) {
+		if (it == node) {
+			if (prev) {
+				*prev = last;
+			}
+			return true;
+		}
+		last = it;
+	}
+	if (prev) {
+		*prev = last;
+	}
+	return false;
+}
+
+#define SYS_SLIST_CONTAINER(node, cn, n) \
+	((node) ? (__typeof__(cn))((char *)(node) - offsetof(__typeof__(*(cn)), n)) : NULL)
+
+#define SYS_SLIST_FOR_EACH_CONTAINER(list, cn, n)					\
+	for (cn = SYS_SLIST_CONTAINER((list)->head, cn, n); cn != NULL;		\
+	     cn = SYS_SLIST_CONTAINER((cn)->n.next, cn, n))
+
+#endif
@@ -0,0 +1,183 @@
+/* Model of the ESB PTX radio. Each attempt takes the on air time of the packet and the ACK including radio
+ * ramp up, and is lost with a configurable probability. The result is delivered through the RADIO signal of the
+ * timeslot, in the same way the real ESB radio interrupt is forwarded by the timeslot handler.
+ * PRX is not modelled, the receiver is assumed to be listening in every timeslot.
+ */
+#include <zephyr/kernel.h>
+#include <esb.h>
+#include "sim.h"
+
+#define RADIO_RAMP_UP_US	130
+#define ESB_ADDR_LENGTH		5
+#define ESB_CRC_LENGTH		2
+#define ESB_PCF_BITS		9
+#define ESB_TX_FIFO_SIZE	8
+
+static struct esb_config m_config;
+static bool m_initialized;
+static uint32_t m_packet_error_percent;
+
+static struct esb_payload m_tx_fifo[ESB_TX_FIFO_SIZE];
+static uint32_t m_tx_fifo_count;
+
+static bool m_tx_busy;
+static bool m_tx_result_pending;
+static bool m_attempt_success;
+static uint32_t m_attempts;
+static uint64_t m_attempt_start;
+static struct sim_event m_attempt_event;
+
+void sim_esb_configure(uint32_t packet_error_percent)
+{
+	m_packet_error_percent = packet_error_percent;
+}
+
+static uint32_t packet_airtime_us(uint32_t payload_length)
+{
+	uint32_t bits_per_ms = (m_config.bitrate == ESB_BITRATE_1MBPS) ? 1000 : 2000;
+	uint32_t preamble_length = (m_config.bitrate == ESB_BITRATE_1MBPS) ? 1 : 2;
+	uint32_t bits = (preamble_length + ESB_ADDR_LENGTH + payload_length + ESB_CRC_LENGTH) * 8 + ESB_PCF_BITS;
+
+	return DIV_ROUND_UP(bits * 1000, bits_per_ms);
+}
+
+static void attempt_done(void *arg)
+{
+	m_tx_result_pending = true;
+	sim_mpsl_radio_irq();
+}
+
+static void attempt_start(void)
+{
+	uint32_t duration_us = RADIO_RAMP_UP_US + packet_airtime_us(m_tx_fifo[0].length) + RADIO_RAMP_UP_US;
+
+	m_attempts++;
+	m_attempt_start = sim_now_us();
+	m_attempt_success = (sim_random() % 100) >= m_packet_error_percent;
+	if (m_attempt_success) {
+		duration_us += packet_airtime_us(0);
+	} else {
+		// Wait for the ACK until the RX timeout
+		duration_us += packet_airtime_us(0) + 60;
+	}
+	sim_event_schedule(&m_attempt_event, m_attempt_start + duration_us, attempt_done, NULL);
+}
+
+static void retransmit(void *arg)
+{
+	attempt_start();
+}
+
+void RADIO_IRQHandler(void)
+{
+	struct esb_evt event = {0};
+
+	if (!m_tx_result_pending) {
+		return;
+	}
+	m_tx_result_pending = false;
+
+	if (m_attempt_success) {
+		m_tx_fifo_count--;
+		memmove(&m_tx_fifo[0], &m_tx_fifo[1], m_tx_fifo_count * sizeof(m_tx_fifo[0]));
+		m_tx_busy = false;
+		event.evt_id = ESB_EVENT_TX_SUCCESS;
+	} else if (m_attempts <= m_config.retransmit_count) {
+		uint64_t attempt_us = sim_now_us() - m_attempt_start;
+
+		sim_event_schedule(&m_attempt_event, m_attempt_start + MAX(attempt_us, m_config.retransmit_delay),
+				   retransmit, NULL);
+		return;
+	} else {
+		m_tx_busy = false;
+		event.evt_id = ESB_EVENT_TX_FAILED;
+	}
+	event.tx_attempts = m_attempts;
+	m_config.event_handler(&event);
+}
+
+int esb_init(const struct esb_config *config)
+{
+	m_config = *config;
+	m_initialized = true;
+	m_tx_fifo_count = 0;
+	m_tx_busy = false;
+	m_tx_result_pending = false;
+	return 0;
+}
+
+int esb_suspend(void)
+{
+	sim_event_cancel(&m_attempt_event);
+	m_tx_busy = false;
+	m_tx_result_pending = false;
+	return 0;
+}
+
+void esb_disable(void)
+{
+	esb_suspend();
+	m_initialized = false;
+}
+
+int esb_write_payload(const struct esb_payload *payload)
+{
+	if (!m_initialized) {
+		return -EACCES;
+	}
+	if (m_tx_fifo_count == ESB_TX_FIFO_SIZE) {
+		return -ENOMEM;
+	}
+	m_tx_fifo[m_tx_fifo_count++] = *payload;
+	return 0;
+}
+
+int esb_read_rx_payload(struct esb_payload *payload)
+{
+	return -ENODATA;
+}
+
+int esb_start_tx(void)
+{
+	if (!m_initialized || m_tx_busy) {
+		return -EBUSY;
+	}
+	if (m_tx_fifo_count == 0) {
+		return -ENODATA;
+	}
+	m_tx_busy = true;
+	m_attempts = 0;
+	attempt_start();
+	return 0;
+}
+
+int esb_start_rx(void)
+{
+	return 0;
+}
+
+int esb_stop_rx(void)
+{
+	return 0;
+}
+
+int esb_flush_tx(void)
+{
+	m_tx_fifo_count = 0;
+	return 0;
+}
+
+int esb_set_base_address_0(const uint8_t *addr)
+{
+	return 0;
+}
+
+int esb_set_base_address_1(const uint8_t *addr)
+{
+	return 0;
+}
+
+int esb_set_prefixes(const uint8_t *prefixes, uint8_t num_pipes)
+{
+	return 0;
+}
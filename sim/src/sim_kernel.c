@@ -0,0 +1,238 @@
+/* Virtual time, event scheduling and the kernel objects used by the application code */
+#include <stdio.h>
+#include <stdarg.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/drivers/clock_control/nrf_clock_control.h>
+#include "sim.h"
+
+// Time from a work item being submitted until the work queue thread runs it
+#define WORK_LATENCY_US		30
+#define WORK_QUEUE_SIZE		16
+
+int sim_log_level = LOG_LEVEL_WRN;
+uint32_t sim_hfxo_ramp_up_us = 1000;
+
+NRF_GPIO_Type sim_gpio_p0;
+
+static uint64_t m_now_us;
+static struct sim_event *m_events;
+static uint32_t m_random_state = 1;
+
+uint64_t sim_now_us(void)
+{
+	return m_now_us;
+}
+
+void sim_log(int level, const char *fmt, ...)
+{
+	va_list args;
+
+	if (level > sim_log_level) {
+		return;
+	}
+
+	fprintf(stderr, "[%10llu us] ", (unsigned long long)m_now_us);
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fprintf(stderr, "\n");
+}
+
+void sim_random_seed(uint32_t seed)
+{
+	m_random_state = seed ? seed : 1;
+}
+
+/* xorshift32, deterministic for a given seed */
+uint32_t sim_random(void)
+{
+	m_random_state ^= m_random_state << 13;
+	m_random_state ^= m_random_state >> 17;
+	m_random_state ^= m_random_state << 5;
+	return m_random_state;
+}
+
+void sim_event_cancel(struct sim_event *evt)
+{
+	struct sim_event **pp;
+
+	if (!evt->queued) {
+		return;
+	}
+	for (pp = &m_events; *pp; pp = &(*pp)->next) {
+		if (*pp == evt) {
+			*pp = evt->next;
+			break;
+		}
+	}
+	evt->queued = false;
+}
+
+void sim_event_schedule(struct sim_event *evt, uint64_t time, sim_event_fn_t fn, void *arg)
+{
+	struct sim_event **pp;
+
+	sim_event_cancel(evt);
+
+	evt->time = (time < m_now_us) ? m_now_us : time;
+	evt->fn = fn;
+	evt->arg = arg;
+	evt->queued = true;
+
+	// Events at the same time run in the order they were scheduled
+	for (pp = &m_events; *pp && (*pp)->time <= evt->time; pp = &(*pp)->next) {
+	}
+	evt->next = *pp;
+	*pp = evt;
+}
+
+void sim_run_until(uint64_t end_us)
+{
+	while (m_events && m_events->time <= end_us) {
+		struct sim_event *evt = m_events;
+
+		m_events = evt->next;
+		evt->queued = false;
+		m_now_us = evt->time;
+		evt->fn(evt->arg);
+	}
+	m_now_us = end_us;
+}
+
+/* Message queues */
+int k_msgq_put(struct k_msgq *msgq, const void *data, k_timeout_t timeout)
+{
+	uint32_t write_idx;
+
+	if (msgq->used == msgq->max_items) {
+		return -ENOMSG;
+	}
+	write_idx = (msgq->read_idx + msgq->used) % msgq->max_items;
+	memcpy(msgq->buffer + write_idx * msgq->item_size, data, msgq->item_size);
+	msgq->used++;
+	return 0;
+}
+
+int k_msgq_get(struct k_msgq *msgq, void *data, k_timeout_t timeout)
+{
+	if (msgq->used == 0) {
+		return -ENOMSG;
+	}
+	memcpy(data, msgq->buffer + msgq->read_idx * msgq->item_size, msgq->item_size);
+	msgq->read_idx = (msgq->read_idx + 1) % msgq->max_items;
+	msgq->used--;
+	return 0;
+}
+
+int k_msgq_peek(struct k_msgq *msgq, void *data)
+{
+	if (msgq->used == 0) {
+		return -ENOMSG;
+	}
+	memcpy(data, msgq->buffer + msgq->read_idx * msgq->item_size, msgq->item_size);
+	return 0;
+}
+
+uint32_t k_msgq_num_used_get(struct k_msgq *msgq)
+{
+	return msgq->used;
+}
+
+/* Work queue */
+static struct k_work *m_work_queue[WORK_QUEUE_SIZE];
+static uint32_t m_work_count;
+static struct sim_event m_work_event;
+
+static void work_queue_run(void *arg)
+{
+	while (m_work_count > 0) {
+		struct k_work *work = m_work_queue[0];
+
+		m_work_count--;
+		memmove(&m_work_queue[0], &m_work_queue[1], m_work_count * sizeof(m_work_queue[0]));
+		work->pending = false;
+		work->handler(work);
+	}
+}
+
+int k_work_submit(struct k_work *work)
+{
+	if (work->pending) {
+		return 0;
+	}
+	if (m_work_count == WORK_QUEUE_SIZE) {
+		abort();
+	}
+	work->pending = true;
+	m_work_queue[m_work_count++] = work;
+	if (!m_work_event.queued) {
+		sim_event_schedule(&m_work_event, m_now_us + WORK_LATENCY_US, work_queue_run, NULL);
+	}
+	return 1;
+}
+
+/* HF clock, the crystal is running sim_hfxo_ramp_up_us after the first request */
+static struct onoff_manager m_hf_mgr;
+static struct sim_event m_hfxo_event;
+static bool m_hfxo_running;
+static struct onoff_client *m_hfxo_waiting[4];
+static uint32_t m_hfxo_waiting_count;
+
+static void hfxo_notify(struct onoff_client *cli)
+{
+	cli->notify.done = true;
+	cli->notify.result = 0;
+	if (cli->notify.callback) {
+		cli->notify.callback(&m_hf_mgr, cli, 1, 0);
+	}
+}
+
+static void hfxo_started(void *arg)
+{
+	m_hfxo_running = true;
+	for (uint32_t i = 0; i < m_hfxo_waiting_count; i++) {
+		hfxo_notify(m_hfxo_waiting[i]);
+	}
+	m_hfxo_waiting_count = 0;
+}
+
+struct onoff_manager *z_nrf_clock_control_get_onoff(int sys)
+{
+	return &m_hf_mgr;
+}
+
+int onoff_request(struct onoff_manager *mgr, struct onoff_client *cli)
+{
+	mgr->refs++;
+
+	// Spinwaiting clients are only used at init, where the ramp up is not of interest
+	if (m_hfxo_running || cli->notify.spinwait) {
+		m_hfxo_running = true;
+		hfxo_notify(cli);
+		return 0;
+	}
+
+	if (m_hfxo_waiting_count < ARRAY_SIZE(m_hfxo_waiting)) {
+		m_hfxo_waiting[m_hfxo_waiting_count++] = cli;
+	}
+	if (!m_hfxo_event.queued) {
+		sim_event_schedule(&m_hfxo_event, m_now_us + sim_hfxo_ramp_up_us, hfxo_started, NULL);
+	}
+	return 0;
+}
+
+int onoff_cancel_or_release(struct onoff_manager *mgr, struct onoff_client *cli)
+{
+	for (uint32_t i = 0; i < m_hfxo_waiting_count; i++) {
+		if (m_hfxo_waiting[i] == cli) {
+			m_hfxo_waiting[i] = m_hfxo_waiting[--m_hfxo_waiting_count];
+			break;
+		}
+	}
+	if (mgr->refs > 0 && --mgr->refs == 0) {
+		m_hfxo_running = false;
+		sim_event_cancel(&m_hfxo_event);
+	}
+	return 0;
+}
@@ -0,0 +1,436 @@
+/* Timeslot simulator
+ *
+ * Runs the timeslot handler and app_esb from common/ against the MPSL, BLE and ESB models, and prints one CSV
+ * row of ESB throughput, latency and radio sharing results for every combination of timeslot length and BLE
+ * connection interval. Every combination runs in its own process, so that it starts from a clean state.
+ *
+ * The traffic is either generated at a fixed rate, or replayed from a trace of app_esb_send() calls captured on a
+ * device with esb_trace.c, which is looped for the length of the run.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "app_esb.h"
+#include "timeslot_handler.h"
+#include "timeslot_analytics.h"
+#include "esb_trace.h"
+#include <zephyr/logging/log.h>
+#include "sim.h"
+
+#define MAX_SWEEP_VALUES	16
+#define LATENCY_FIFO_SIZE	64
+
+struct sim_params {
+	uint32_t slot_lengths_us[MAX_SWEEP_VALUES];
+	uint32_t slot_length_count;
+	uint32_t conn_intervals_us[MAX_SWEEP_VALUES];
+	uint32_t conn_interval_count;
+	struct sim_ble_config ble;
+	uint32_t duration_ms;
+	uint32_t rate_pps;
+	uint32_t payload_length;
+	uint32_t packet_error_percent;
+	uint32_t seed;
+	const char *trace_path;
+	bool check_admission;
+};
+
+static struct sim_params m_params = {
+	.slot_lengths_us = {2500, 5000, 10000, 20000},
+	.slot_length_count = 4,
+	.conn_intervals_us = {7500, 15000, 30000, 50000},
+	.conn_interval_count = 4,
+	.ble = {
+		.advertising = false,
+		.adv_interval_us = 100000,
+		.adv_event_us = 1500,
+		.connected = true,
+		.conn_event_us = 2500,
+		.max_skips = 2,
+		.cancel_percent = 1,
+	},
+	.duration_ms = 10000,
+	.rate_pps = 0,
+	.payload_length = 32,
+	.packet_error_percent = 2,
+	.seed = 1,
+};
+
+static struct {
+	uint64_t offered;
+	uint64_t delivered;
+	uint64_t dropped;
+	uint64_t delivered_bytes;
+	uint64_t backlog_total;
+	uint32_t backlog_max;
+	uint32_t fifo_enqueued_us[LATENCY_FIFO_SIZE];
+	uint8_t fifo_length[LATENCY_FIFO_SIZE];
+	uint32_t fifo_head;
+	uint32_t fifo_count;
+	uint32_t *latencies_us;
+	uint64_t latency_count;
+	uint64_t latency_capacity;
+	struct sim_event send_event;
+} m_traffic;
+
+static struct {
+	esb_trace_record_t *records;
+	uint32_t count;
+	uint32_t next;
+} m_trace;
+
+static void latency_add(uint32_t latency_us)
+{
+	if (m_traffic.latency_count == m_traffic.latency_capacity) {
+		m_traffic.latency_capacity = m_traffic.latency_capacity ? m_traffic.latency_capacity * 2 : 4096;
+		m_traffic.latencies_us = realloc(m_traffic.latencies_us,
+						 m_traffic.latency_capacity * sizeof(uint32_t));
+		if (m_traffic.latencies_us == NULL) {
+			abort();
+		}
+	}
+	m_traffic.latencies_us[m_traffic.latency_count++] = latency_us;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+	uint32_t va = *(const uint32_t *)a;
+	uint32_t vb = *(const uint32_t *)b;
+
+	return (va > vb) - (va < vb);
+}
+
+static uint32_t percentile(uint32_t percent)
+{
+	if (m_traffic.latency_count == 0) {
+		return 0;
+	}
+	return m_traffic.latencies_us[((m_traffic.latency_count - 1) * percent) / 100];
+}
+
+static void send_packet(void *arg);
+
+static bool packet_send(uint32_t length)
+{
+	app_esb_data_t packet = {.len = length};
+	uint64_t seq = m_traffic.offered;
+	uint32_t backlog;
+
+	memcpy(packet.data, &seq, MIN(sizeof(seq), sizeof(packet.data)));
+	m_traffic.offered++;
+	if (app_esb_send(&packet) != 0) {
+		m_traffic.offered--;
+		return false;
+	}
+	m_traffic.fifo_enqueued_us[(m_traffic.fifo_head + m_traffic.fifo_count) % LATENCY_FIFO_SIZE] = k_cycle_get_32();
+	m_traffic.fifo_length[(m_traffic.fifo_head + m_traffic.fifo_count) % LATENCY_FIFO_SIZE] = length;
+	m_traffic.fifo_count++;
+
+	backlog = app_esb_tx_backlog_get();
+	m_traffic.backlog_total += backlog;
+	m_traffic.backlog_max = MAX(m_traffic.backlog_max, backlog);
+	return true;
+}
+
+/* Traffic generator, runs in thread context */
+static void send_packet(void *arg)
+{
+	if (m_trace.count > 0) {
+		const esb_trace_record_t *record = &m_trace.records[m_trace.next];
+
+		// Calls rejected with the TX queue full are counted as dropped, and not retried
+		if (!packet_send(record->length)) {
+			m_traffic.offered++;
+			m_traffic.dropped++;
+		}
+		m_trace.next = (m_trace.next + 1) % m_trace.count;
+		sim_event_schedule(&m_traffic.send_event, sim_now_us() + m_trace.records[m_trace.next].delta_us,
+				   send_packet, NULL);
+		return;
+	}
+
+	if (m_params.rate_pps == 0) {
+		// Saturated, keep the TX queue full
+		while (packet_send(m_params.payload_length)) {
+		}
+		return;
+	}
+
+	if (!packet_send(m_params.payload_length)) {
+		m_traffic.offered++;
+		m_traffic.dropped++;
+	}
+	sim_event_schedule(&m_traffic.send_event, sim_now_us() + 1000000 / m_params.rate_pps, send_packet, NULL);
+}
+
+static void app_esb_callback(app_esb_event_t *event)
+{
+	if (event->evt_type != APP_ESB_EVT_TX_SUCCESS || m_traffic.fifo_count == 0) {
+		return;
+	}
+
+	latency_add(k_cycle_get_32() - m_traffic.fifo_enqueued_us[m_traffic.fifo_head]);
+	m_traffic.delivered_bytes += m_traffic.fifo_length[m_traffic.fifo_head];
+	m_traffic.fifo_head = (m_traffic.fifo_head + 1) % LATENCY_FIFO_SIZE;
+	m_traffic.fifo_count--;
+	m_traffic.delivered++;
+
+	if (m_params.rate_pps == 0 && m_trace.count == 0) {
+		// Refill the queue from thread context, not from the ESB callback
+		sim_event_schedule(&m_traffic.send_event, sim_now_us() + 1, send_packet, NULL);
+	}
+}
+
+static int run_point(uint32_t slot_length_us, uint32_t conn_interval_us)
+{
+	struct sim_ble_config ble = m_params.ble;
+	timeslot_analytics_t analytics;
+	timeslot_stats_t ts_stats;
+	app_esb_stats_t esb_stats;
+	struct sim_ble_stats ble_stats;
+	uint64_t duration_us = (uint64_t)m_params.duration_ms * 1000;
+	int err;
+
+	sim_random_seed(m_params.seed);
+	ble.conn_interval_us = conn_interval_us;
+	sim_mpsl_configure(&ble);
+	sim_esb_configure(m_params.packet_error_percent);
+
+	timeslot_handler_slot_length_set(slot_length_us);
+	err = app_esb_init(APP_ESB_MODE_PTX, app_esb_callback);
+	if (err) {
+		fprintf(stderr, "app_esb_init failed: %d\n", err);
+		return err;
+	}
+
+	sim_event_schedule(&m_traffic.send_event, 1000, send_packet, NULL);
+	sim_run_until(duration_us);
+
+	timeslot_analytics_get(&analytics);
+	timeslot_handler_stats_get(&ts_stats);
+	app_esb_stats_get(&esb_stats);
+	sim_mpsl_ble_stats_get(&ble_stats);
+	qsort(m_traffic.latencies_us, m_traffic.latency_count, sizeof(uint32_t), compare_u32);
+
+	printf("%u,%u,%llu,%llu,%.1f,%u,%u,%u,%u,%llu,%.1f,%u,%u,%u,%u,%u,%u,%llu,%llu,%.1f,%u\n",
+	       slot_length_us, ble.connected ? conn_interval_us : 0,
+	       (unsigned long long)(m_traffic.offered * 1000 / m_params.duration_ms),
+	       (unsigned long long)(m_traffic.delivered * 1000 / m_params.duration_ms),
+	       (double)(m_traffic.delivered_bytes * 8) / m_params.duration_ms,
+	       percentile(50), percentile(90), percentile(99),
+	       m_traffic.latency_count ? m_traffic.latencies_us[m_traffic.latency_count - 1] : 0,
+	       (unsigned long long)m_traffic.dropped,
+	       analytics.total_us ? (double)analytics.granted_us * 100 / analytics.total_us : 0.0,
+	       analytics.slots, ts_stats.blocked, ts_stats.cancelled,
+	       analytics.loss_count[TS_LOSS_EXTEND_FAILED], esb_stats.tx_deferred, esb_stats.tx_aborted_slot_end,
+	       (unsigned long long)ble_stats.events, (unsigned long long)ble_stats.skipped,
+	       (m_traffic.offered > m_traffic.dropped) ?
+		       (double)m_traffic.backlog_total / (m_traffic.offered - m_traffic.dropped) : 0.0,
+	       m_traffic.backlog_max);
+	fflush(stdout);
+
+	// Transactions that can't finish before the radio is lost should be held back, not started and aborted
+	if (m_params.check_admission &&
+	    (esb_stats.tx_deferred == 0 || esb_stats.tx_aborted_slot_end * 100 > analytics.slots)) {
+		fprintf(stderr, "TX admission check failed: %u deferred, %u aborted in %u timeslots\n",
+			esb_stats.tx_deferred, esb_stats.tx_aborted_slot_end, analytics.slots);
+		return 1;
+	}
+	return 0;
+}
+
+static uint32_t parse_list(const char *arg, uint32_t *values)
+{
+	char *copy = strdup(arg);
+	char *saveptr;
+	uint32_t count = 0;
+
+	for (char *tok = strtok_r(copy, ",", &saveptr); tok && count < MAX_SWEEP_VALUES;
+	     tok = strtok_r(NULL, ",", &saveptr)) {
+		values[count++] = strtoul(tok, NULL, 0);
+	}
+	free(copy);
+	return count;
+}
+
+/* Read a trace in the esb_trace text format */
+static int trace_load(const char *path)
+{
+	esb_trace_record_t record;
+	uint32_t capacity = 0;
+	char line[256];
+	uint32_t line_number = 0;
+	FILE *file = fopen(path, "r");
+	int err;
+
+	if (file == NULL) {
+		perror(path);
+		return -ENOENT;
+	}
+	while (fgets(line, sizeof(line), file) != NULL) {
+		line_number++;
+		err = esb_trace_parse(line, &record);
+		if (err == -ENODATA) {
+			continue;
+		}
+		if (err) {
+			fprintf(stderr, "%s:%u: not a trace record\n", path, line_number);
+			fclose(file);
+			return err;
+		}
+		if (m_trace.count == capacity) {
+			capacity = capacity ? capacity * 2 : 1024;
+			m_trace.records = realloc(m_trace.records, capacity * sizeof(esb_trace_record_t));
+			if (m_trace.records == NULL) {
+				abort();
+			}
+		}
+		m_trace.records[m_trace.count++] = record;
+	}
+	fclose(file);
+
+	if (m_trace.count == 0) {
+		fprintf(stderr, "%s: no trace records\n", path);
+		return -ENODATA;
+	}
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [options]\n"
+	       "  --slot-lengths LIST    Timeslot lengths to sweep, in us (default 2500,5000,10000,20000)\n"
+	       "  --conn-intervals LIST  BLE connection intervals to sweep, in us (default 7500,15000,30000,50000)\n"
+	       "  --conn-event US        BLE connection event length (default 2500)\n"
+	       "  --max-skips N          BLE events of one role a HIGH priority timeslot may skip in a row (default 2)\n"
+	       "  --no-connection        No BLE connection\n"
+	       "  --adv-interval US      Add BLE advertising with the given interval\n"
+	       "  --cancel PERCENT       Probability of a scheduled timeslot being cancelled (default 1)\n"
+	       "  --rate PPS             ESB packets per second, 0 to keep the TX queue full (default 0)\n"
+	       "  --payload BYTES        ESB payload length (default 32)\n"
+	       "  --trace FILE           Replay an esb_trace capture instead of --rate and --payload\n"
+	       "  --per PERCENT          ESB packet error rate per attempt (default 2)\n"
+	       "  --duration MS          Simulated time per run (default 10000)\n"
+	       "  --seed N               Random seed (default 1)\n"
+	       "  --check-admission      Fail unless TX is held back at the end of timeslots, and aborted in\n"
+	       "                         fewer than 1%% of them\n"
+	       "  --verbose              Print the application log to stderr\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option options[] = {
+		{"slot-lengths", required_argument, NULL, 's'},
+		{"conn-intervals", required_argument, NULL, 'c'},
+		{"conn-event", required_argument, NULL, 'e'},
+		{"max-skips", required_argument, NULL, 'k'},
+		{"no-connection", no_argument, NULL, 'n'},
+		{"adv-interval", required_argument, NULL, 'a'},
+		{"cancel", required_argument, NULL, 'x'},
+		{"rate", required_argument, NULL, 'r'},
+		{"payload", required_argument, NULL, 'p'},
+		{"trace", required_argument, NULL, 't'},
+		{"per", required_argument, NULL, 'l'},
+		{"duration", required_argument, NULL, 'd'},
+		{"seed", required_argument, NULL, 'S'},
+		{"check-admission", no_argument, NULL, 'A'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"help", no_argument, NULL, 'h'},
+		{0}
+	};
+	int opt;
+
+	while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+		switch (opt) {
+			case 's':
+				m_params.slot_length_count = parse_list(optarg, m_params.slot_lengths_us);
+				break;
+			case 'c':
+				m_params.conn_interval_count = parse_list(optarg, m_params.conn_intervals_us);
+				break;
+			case 'e':
+				m_params.ble.conn_event_us = strtoul(optarg, NULL, 0);
+				break;
+			case 'k':
+				m_params.ble.max_skips = strtoul(optarg, NULL, 0);
+				break;
+			case 'n':
+				m_params.ble.connected = false;
+				m_params.conn_interval_count = 1;
+				break;
+			case 'a':
+				m_params.ble.advertising = true;
+				m_params.ble.adv_interval_us = strtoul(optarg, NULL, 0);
+				break;
+			case 'x':
+				m_params.ble.cancel_percent = strtoul(optarg, NULL, 0);
+				break;
+			case 'r':
+				m_params.rate_pps = strtoul(optarg, NULL, 0);
+				break;
+			case 'p':
+				m_params.payload_length = MIN(strtoul(optarg, NULL, 0), sizeof(((app_esb_data_t *)0)->data));
+				break;
+			case 't':
+				m_params.trace_path = optarg;
+				break;
+			case 'l':
+				m_params.packet_error_percent = strtoul(optarg, NULL, 0);
+				break;
+			case 'd':
+				m_params.duration_ms = strtoul(optarg, NULL, 0);
+				break;
+			case 'S':
+				m_params.seed = strtoul(optarg, NULL, 0);
+				break;
+			case 'A':
+				m_params.check_admission = true;
+				break;
+			case 'v':
+				sim_log_level = LOG_LEVEL_DBG;
+				break;
+			default:
+				usage(argv[0]);
+				return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (m_params.duration_ms == 0 || m_params.slot_length_count == 0 || m_params.conn_interval_count == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (m_params.trace_path != NULL && trace_load(m_params.trace_path) != 0) {
+		return 1;
+	}
+
+	printf("slot_length_us,conn_interval_us,offered_pps,delivered_pps,throughput_kbps,"
+	       "latency_p50_us,latency_p90_us,latency_p99_us,latency_max_us,dropped,granted_percent,"
+	       "slots,blocked,cancelled,extend_failed,tx_deferred,tx_aborted,ble_events,ble_skipped,backlog_avg,backlog_max\n");
+	fflush(stdout);
+
+	for (uint32_t s = 0; s < m_params.slot_length_count; s++) {
+		for (uint32_t c = 0; c < m_params.conn_interval_count; c++) {
+			int status;
+			pid_t pid = fork();
+
+			if (pid < 0) {
+				perror("fork");
+				return 1;
+			}
+			if (pid == 0) {
+				exit(run_point(m_params.slot_lengths_us[s], m_params.conn_intervals_us[c]) ? 1 : 0);
+			}
+			if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+				fprintf(stderr, "Run with timeslot length %u us, connection interval %u us failed\n",
+					m_params.slot_lengths_us[s], m_params.conn_intervals_us[c]);
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,406 @@
+/* Model of the MPSL timeslot scheduler sharing the radio with a BLE link.
+ *
+ * BLE activity is a periodic advertiser (with the random advDelay of up to 10 ms) and/or a connection with a
+ * fixed event length. Timeslots are placed in the first gap that fits the requested length:
+ * - NORMAL priority timeslots and extensions never overlap a BLE event
+ * - HIGH priority timeslots and extensions preempt BLE events, until max_skips events of the same role
+ *   have been skipped in a row. The link layer then protects the role, as it raises the priority of
+ *   roles that keep losing the radio.
+ * Requests that can not be placed within the timeout get the BLOCKED signal. Independently of this a
+ * scheduled timeslot is cancelled with a configurable probability, modelling BLE activity that is not
+ * part of the schedule such as scanning or flash operations.
+ */
+#include <stdio.h>
+#include <zephyr/kernel.h>
+#include <mpsl_timeslot.h>
+#include <hal/nrf_timer.h>
+#include "sim.h"
+
+// Time MPSL needs from a request until the earliest possible start of the timeslot
+#define MPSL_REQUEST_OVERHEAD_US	150
+// Delay of the signals MPSL delivers from its low priority context (BLOCKED, CANCELLED, IDLE)
+#define MPSL_LOW_PRIO_LATENCY_US	20
+#define ADV_DELAY_MAX_US			10000
+#define ADV_OFFSET_US				3000
+#define CONN_OFFSET_US				1000
+
+NRF_TIMER_Type sim_timer0;
+NRF_TIMER_Type sim_timer2;
+static NRF_RADIO_Type m_radio;
+
+enum slot_state {
+	STATE_IDLE,
+	STATE_REQUESTED,
+	STATE_IN_SLOT,
+};
+
+struct ble_activity {
+	bool enabled;
+	bool advertising;
+	uint32_t offset_us;
+	uint32_t interval_us;
+	uint32_t duration_us;
+	uint64_t index;
+	uint32_t skips_in_a_row;
+	struct sim_event event;
+};
+
+static struct sim_ble_config m_config;
+static struct ble_activity m_adv;
+static struct ble_activity m_conn;
+static struct sim_ble_stats m_ble_stats;
+static uint32_t m_adv_delay_salt;
+
+static mpsl_timeslot_callback_t m_callback;
+static bool m_session_open;
+static enum slot_state m_state = STATE_IDLE;
+static uint8_t m_priority;
+static uint64_t m_slot_start;
+static uint64_t m_slot_end;
+
+static struct sim_event m_start_event;
+static struct sim_event m_end_event;
+static struct sim_event m_timer_event;
+static struct sim_event m_low_prio_event;
+static uint32_t m_low_prio_signal;
+
+static void signal_send(uint32_t signal);
+
+NRF_RADIO_Type *sim_radio_regs(void)
+{
+	// The radio disables instantly
+	if (m_radio.TASKS_DISABLE) {
+		m_radio.TASKS_DISABLE = 0;
+		m_radio.EVENTS_DISABLED = 1;
+	}
+	return &m_radio;
+}
+
+uint32_t sim_timer_value(NRF_TIMER_Type *p_reg)
+{
+	if (p_reg == &sim_timer0 && m_state == STATE_IN_SLOT) {
+		return (uint32_t)(sim_now_us() - m_slot_start);
+	}
+	return 0;
+}
+
+/* BLE schedule */
+
+static uint64_t activity_start(const struct ble_activity *act, uint64_t index)
+{
+	uint64_t start = act->offset_us + index * act->interval_us;
+
+	if (act->advertising) {
+		// Pseudo random but reproducible advDelay, so that the scheduler can look ahead
+		uint32_t hash = (uint32_t)(index * 2654435761u) ^ m_adv_delay_salt;
+
+		hash ^= hash >> 16;
+		hash *= 0x45d9f3b;
+		hash ^= hash >> 16;
+		start += hash % ADV_DELAY_MAX_US;
+	}
+	return start;
+}
+
+/* Check if [start, end) can be given to a timeslot of the given priority.
+ * Returns false and the end of the first conflicting BLE event if not.
+ */
+static bool ble_fits(uint64_t start, uint64_t end, uint8_t priority, uint64_t *conflict_end)
+{
+	struct ble_activity *acts[] = {&m_adv, &m_conn};
+	bool fits = true;
+
+	*conflict_end = 0;
+	for (int a = 0; a < ARRAY_SIZE(acts); a++) {
+		struct ble_activity *act = acts[a];
+		uint32_t skips = act->skips_in_a_row;
+		uint64_t first = 0;
+
+		if (!act->enabled) {
+			continue;
+		}
+		if (start > act->offset_us + act->duration_us + ADV_DELAY_MAX_US) {
+			first = (start - act->offset_us - act->duration_us - ADV_DELAY_MAX_US) / act->interval_us;
+		}
+		for (uint64_t i = first; ; i++) {
+			uint64_t evt_start = activity_start(act, i);
+			uint64_t evt_end = evt_start + act->duration_us;
+
+			if (evt_start >= end) {
+				break;
+			}
+			if (evt_end <= start) {
+				continue;
+			}
+			if (priority == MPSL_TIMESLOT_PRIORITY_HIGH) {
+				// Events that already started have been counted as skipped
+				if (evt_start < sim_now_us()) {
+					continue;
+				}
+				if (skips < m_config.max_skips) {
+					skips++;
+					continue;
+				}
+			}
+			fits = false;
+			if (evt_end > *conflict_end) {
+				*conflict_end = evt_end;
+			}
+			break;
+		}
+	}
+	return fits;
+}
+
+static void ble_event(void *arg)
+{
+	struct ble_activity *act = arg;
+
+	m_ble_stats.events++;
+	if (m_state == STATE_IN_SLOT) {
+		m_ble_stats.skipped++;
+		act->skips_in_a_row++;
+	} else {
+		m_ble_stats.airtime_us += act->duration_us;
+		act->skips_in_a_row = 0;
+	}
+
+	act->index++;
+	sim_event_schedule(&act->event, activity_start(act, act->index), ble_event, act);
+}
+
+static void activity_setup(struct ble_activity *act, bool enabled, bool advertising, uint32_t offset_us,
+			   uint32_t interval_us, uint32_t duration_us)
+{
+	*act = (struct ble_activity){
+		.enabled = enabled && interval_us > 0,
+		.advertising = advertising,
+		.offset_us = offset_us,
+		.interval_us = interval_us,
+		.duration_us = duration_us,
+	};
+	if (act->enabled) {
+		sim_event_schedule(&act->event, activity_start(act, 0), ble_event, act);
+	}
+}
+
+void sim_mpsl_configure(const struct sim_ble_config *config)
+{
+	m_config = *config;
+	m_adv_delay_salt = sim_random();
+	activity_setup(&m_adv, config->advertising, true, ADV_OFFSET_US, config->adv_interval_us,
+		       config->adv_event_us);
+	activity_setup(&m_conn, config->connected, false, CONN_OFFSET_US, config->conn_interval_us,
+		       config->conn_event_us);
+}
+
+void sim_mpsl_ble_stats_get(struct sim_ble_stats *stats)
+{
+	*stats = m_ble_stats;
+}
+
+bool sim_mpsl_in_timeslot(void)
+{
+	return m_state == STATE_IN_SLOT;
+}
+
+/* Timeslot */
+
+static void timer_fire(void *arg)
+{
+	int ch = (int)(intptr_t)arg;
+
+	sim_timer0.events |= BIT(ch);
+	sim_timer0.fired_at[ch] = (uint64_t)sim_timer0.cc[ch] + 1;
+	signal_send(MPSL_TIMESLOT_SIGNAL_TIMER0);
+}
+
+/* Schedule the next TIMER0 compare interrupt after the timeslot callback has changed the timer setup */
+static void timer_schedule(void)
+{
+	uint64_t now = sim_now_us();
+	uint64_t next = UINT64_MAX;
+	int next_ch = -1;
+
+	sim_event_cancel(&m_timer_event);
+	if (m_state != STATE_IN_SLOT) {
+		return;
+	}
+
+	for (int ch = 0; ch < NRF_TIMER_CC_COUNT; ch++) {
+		uint64_t fire;
+
+		if (!(sim_timer0.int_mask & BIT(ch)) || sim_timer0.fired_at[ch] == (uint64_t)sim_timer0.cc[ch] + 1) {
+			continue;
+		}
+		fire = m_slot_start + sim_timer0.cc[ch];
+		if (fire >= now && fire < next) {
+			next = fire;
+			next_ch = ch;
+		}
+	}
+
+	if (next_ch >= 0 && next < m_slot_end) {
+		sim_event_schedule(&m_timer_event, next, timer_fire, (void *)(intptr_t)next_ch);
+	}
+}
+
+static void low_prio_signal_deliver(void *arg)
+{
+	m_callback(0, m_low_prio_signal);
+}
+
+static void low_prio_signal_send(uint32_t signal)
+{
+	m_low_prio_signal = signal;
+	sim_event_schedule(&m_low_prio_event, sim_now_us() + MPSL_LOW_PRIO_LATENCY_US, low_prio_signal_deliver, NULL);
+}
+
+static void slot_finish(void)
+{
+	m_state = STATE_IDLE;
+	sim_event_cancel(&m_end_event);
+	sim_event_cancel(&m_timer_event);
+}
+
+static void slot_end_reached(void *arg)
+{
+	slot_finish();
+	low_prio_signal_send(MPSL_TIMESLOT_SIGNAL_SESSION_IDLE);
+}
+
+static void slot_start(void *arg)
+{
+	m_state = STATE_IN_SLOT;
+	m_slot_start = sim_now_us();
+	memset(&sim_timer0, 0, sizeof(sim_timer0));
+	sim_event_schedule(&m_end_event, m_slot_end, slot_end_reached, NULL);
+	signal_send(MPSL_TIMESLOT_SIGNAL_START);
+}
+
+static void slot_cancelled(void *arg)
+{
+	m_state = STATE_IDLE;
+	low_prio_signal_send(MPSL_TIMESLOT_SIGNAL_CANCELLED);
+}
+
+static int request_schedule(const mpsl_timeslot_request_t *request)
+{
+	const mpsl_timeslot_request_earliest_t *params = &request->params.earliest;
+	uint64_t earliest = sim_now_us() + MPSL_REQUEST_OVERHEAD_US;
+	uint64_t start = earliest;
+	uint64_t conflict_end;
+
+	if (request->request_type != MPSL_TIMESLOT_REQ_TYPE_EARLIEST) {
+		fprintf(stderr, "Only earliest timeslot requests are modelled\n");
+		return -EINVAL;
+	}
+	if (m_state != STATE_IDLE) {
+		return -EINVAL;
+	}
+
+	m_priority = params->priority;
+	while (!ble_fits(start, start + params->length_us, m_priority, &conflict_end)) {
+		start = conflict_end;
+		if (start - earliest > params->timeout_us) {
+			low_prio_signal_send(MPSL_TIMESLOT_SIGNAL_BLOCKED);
+			return 0;
+		}
+	}
+
+	m_state = STATE_REQUESTED;
+	m_slot_end = start + params->length_us;
+	if ((sim_random() % 100) < m_config.cancel_percent) {
+		sim_event_schedule(&m_start_event, start, slot_cancelled, NULL);
+	} else {
+		sim_event_schedule(&m_start_event, start, slot_start, NULL);
+	}
+	return 0;
+}
+
+static void extend(uint32_t length_us)
+{
+	uint64_t conflict_end;
+
+	if (ble_fits(m_slot_end, m_slot_end + length_us, m_priority, &conflict_end)) {
+		m_slot_end += length_us;
+		sim_event_schedule(&m_end_event, m_slot_end, slot_end_reached, NULL);
+		signal_send(MPSL_TIMESLOT_SIGNAL_EXTEND_SUCCEEDED);
+	} else {
+		signal_send(MPSL_TIMESLOT_SIGNAL_EXTEND_FAILED);
+	}
+}
+
+/* Deliver a signal from inside the timeslot, and carry out the returned action */
+static void signal_send(uint32_t signal)
+{
+	mpsl_timeslot_signal_return_param_t *ret = m_callback(0, signal);
+
+	if (ret == NULL) {
+		fprintf(stderr, "Timeslot callback returned NULL for signal %u\n", signal);
+		abort();
+	}
+
+	switch (ret->callback_action) {
+		case MPSL_TIMESLOT_SIGNAL_ACTION_NONE:
+			break;
+		case MPSL_TIMESLOT_SIGNAL_ACTION_EXTEND:
+			if (signal != MPSL_TIMESLOT_SIGNAL_TIMER0 && signal != MPSL_TIMESLOT_SIGNAL_RADIO) {
+				signal_send(MPSL_TIMESLOT_SIGNAL_INVALID_RETURN);
+				return;
+			}
+			extend(ret->params.extend.length_us);
+			break;
+		case MPSL_TIMESLOT_SIGNAL_ACTION_END:
+			slot_finish();
+			low_prio_signal_send(MPSL_TIMESLOT_SIGNAL_SESSION_IDLE);
+			return;
+		case MPSL_TIMESLOT_SIGNAL_ACTION_REQUEST:
+			slot_finish();
+			if (request_schedule(ret->params.request.p_next) != 0) {
+				fprintf(stderr, "Invalid timeslot request returned from the callback\n");
+				abort();
+			}
+			return;
+	}
+	timer_schedule();
+}
+
+void sim_mpsl_radio_irq(void)
+{
+	if (m_state == STATE_IN_SLOT) {
+		signal_send(MPSL_TIMESLOT_SIGNAL_RADIO);
+	}
+}
+
+int32_t mpsl_timeslot_session_open(mpsl_timeslot_callback_t mpsl_timeslot_signal_callback,
+				   mpsl_timeslot_session_id_t *p_session_id)
+{
+	if (m_session_open) {
+		return -ENOMEM;
+	}
+	m_session_open = true;
+	m_callback = mpsl_timeslot_signal_callback;
+	*p_session_id = 0;
+	return 0;
+}
+
+int32_t mpsl_timeslot_session_close(mpsl_timeslot_session_id_t session_id)
+{
+	if (!m_session_open) {
+		return -EINVAL;
+	}
+	sim_event_cancel(&m_start_event);
+	slot_finish();
+	m_session_open = false;
+	m_callback(session_id, MPSL_TIMESLOT_SIGNAL_SESSION_CLOSED);
+	return 0;
+}
+
+int32_t mpsl_timeslot_request(mpsl_timeslot_session_id_t session_id, mpsl_timeslot_request_t const *p_request)
+{
+	if (!m_session_open) {
+		return -EINVAL;
+	}
+	return request_schedule(p_request);
+}